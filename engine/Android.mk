@@ -122,6 +122,7 @@ LOCAL_SRC_FILES := \
            common/pm_trace.c \
            common/random.c \
            common/sys_con.c \
+           common/sys_thread.c \
            common/system.c \
            common/titles.c \
            common/world.c \
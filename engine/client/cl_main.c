@@ -914,17 +914,23 @@ void CL_SendConnectPacket( void )
 
 	if( adr.type != NA_LOOPBACK )
 	{
-		qboolean huff = Cvar_VariableInteger( "cl_enable_compress" );
+		int huff = Cvar_VariableInteger( "cl_enable_compress" );
+		int splithuff = Cvar_VariableInteger( "cl_enable_splitcompress" );
+
 		if( huff )
 			extensions |= NET_EXT_HUFF;
 
 		if( Cvar_VariableInteger( "cl_enable_split" ) )
 		{
 			extensions |= NET_EXT_SPLIT;
-			if( !huff && Cvar_VariableInteger( "cl_enable_splitcompress" ) )
+			if( !huff && splithuff )
 				extensions |= NET_EXT_SPLITHUFF;
 		}
 
+		// old servers ignore it and use adaptive tree
+		if( huff == 2 || ( !huff && splithuff == 2 ))
+			extensions |= NET_EXT_HUFFSTATIC;
+
 		if( !m_ignore->integer )
 			input_devices |= INPUT_DEVICE_MOUSE;
 
@@ -1848,7 +1854,7 @@ void CL_ConnectionlessPacket( netadr_t from, sizebuf_t *msg )
 		}
 
 		Netchan_Setup( NS_CLIENT, &cls.netchan, from, net_qport->integer );
-		cls.splitcompress = false;
+		cls.splitcompress = NET_COMPRESS_NONE;
 
 		if( extensions & NET_EXT_SPLIT )
 		{
@@ -1865,15 +1871,15 @@ void CL_ConnectionlessPacket( netadr_t from, sizebuf_t *msg )
 			if( extensions & NET_EXT_SPLITHUFF )
 			{
 				MsgDev( D_INFO, "^2NET_EXT_SPLITHUFF enabled^7\n");
-				cls.splitcompress = true;
+				cls.splitcompress = ( extensions & NET_EXT_HUFFSTATIC ) ? NET_COMPRESS_STATIC : NET_COMPRESS_HUFF;
 			}
 		}
 
 		if( extensions & NET_EXT_HUFF )
 		{
-			MsgDev( D_INFO, "^2NET_EXT_HUFF enabled\n" );
+			MsgDev( D_INFO, "^2NET_EXT_HUFF enabled%s\n", ( extensions & NET_EXT_HUFFSTATIC ) ? " (static)" : "" );
 
-			cls.netchan.compress = true;
+			cls.netchan.compress = ( extensions & NET_EXT_HUFFSTATIC ) ? NET_COMPRESS_STATIC : NET_COMPRESS_HUFF;
 		}
 
 		BF_WriteByte( &cls.netchan.message, clc_stringcmd );
@@ -2350,9 +2356,9 @@ void CL_InitLocal( void )
 	Cvar_Get( "cl_background", "0", CVAR_READ_ONLY, "indicates that background map is running" );
 	Cvar_Get( "cl_msglevel", "0", CVAR_USERINFO|CVAR_ARCHIVE, "message filter for server notifications" );
 
-	Cvar_Get( "cl_enable_compress", "0", CVAR_ARCHIVE, "request huffman compression from server" );
+	Cvar_Get( "cl_enable_compress", "0", CVAR_ARCHIVE, "request huffman compression from server, 2 - static code" );
 	Cvar_Get( "cl_enable_split", "1", CVAR_ARCHIVE, "request packet split from server" );
-	Cvar_Get( "cl_enable_splitcompress", "0", CVAR_ARCHIVE, "request compressing all splitpackets" );
+	Cvar_Get( "cl_enable_splitcompress", "0", CVAR_ARCHIVE, "request compressing all splitpackets, 2 - static code" );
 
 	Cvar_Get( "cl_maxoutpacket", "0", CVAR_ARCHIVE, "max outcoming packet size (equal cl_maxpacket if 0)" );
 
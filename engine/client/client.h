@@ -528,7 +528,7 @@ typedef struct
 	file_t		*demofile;
 	file_t		*demoheader;		// contain demo startup info in case we record a demo on this level
 	qboolean keybind_changed;
-	qboolean splitcompress;			// enabled only on server->client netchan
+	int splitcompress;			// NET_COMPRESS_*, enabled only on server->client netchan
 	qboolean need_save_config;
 	qboolean internetservers_wait;	// internetservers is waiting for dns request
 	qboolean internetservers_pending;	// internetservers is waiting for dns request
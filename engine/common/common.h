@@ -566,6 +566,9 @@ qboolean NET_CompareAdr( const netadr_t a, const netadr_t b );
 qboolean NET_CompareBaseAdr( const netadr_t a, const netadr_t b );
 qboolean NET_GetPacket( netsrc_t sock, netadr_t *from, byte *data, size_t *length );
 void NET_SendPacket( netsrc_t sock, size_t length, const void *data, netadr_t to );
+qboolean NET_Sleep( int usec );
+void NET_BeginSendBatch( void );
+void NET_EndSendBatch( void );
 
 xash_force_inline qboolean NET_IsLocalAddress( netadr_t adr )
 {
@@ -60,6 +60,7 @@ convar_t	*host_cheats;
 convar_t	*host_maxfps;
 convar_t	*host_framerate;
 convar_t	*host_sleeptime;
+convar_t	*host_sched;
 convar_t	*host_xashds_hacks;
 convar_t	*sys_timescale;
 convar_t	*con_gamemaps;
@@ -74,6 +75,24 @@ int g_developer = DEFAULT_DEV;
 
 static int num_decals;
 
+// dedicated server frame scheduler
+typedef enum
+{
+	SCHED_WAKE_DEADLINE = 0,	// slept until the next tick was due
+	SCHED_WAKE_PACKET,		// woke up early to read incoming packets
+	SCHED_WAKE_OVERRUN,		// previous frame took longer than a tick
+	SCHED_WAKE_COUNT
+} sched_wake_t;
+
+static struct
+{
+	double	deadline;		// wall time when the next server tick is due
+	double	jitter_sum;
+	double	jitter_max;
+	int	ticks;
+	int	wakes[SCHED_WAKE_COUNT];
+} host_schedstate;
+
 void Sys_PrintUsage( void )
 {
 #define O(x,y) "   "x"  "y"\n"
@@ -259,25 +278,16 @@ Host_AbortCurrentFrame
 aborts the current host frame and goes on with the next one
 ================
 */
-void Host_Frame( float time );
+void Host_Frame( void );
 void Host_RunFrame()
 {
-	static double	oldtime, newtime;
-
-	if( !oldtime )
-		oldtime = Sys_DoubleTime();
-
 #if XASH_INPUT == INPUT_SDL
 	SDLash_RunEvents();
 #elif XASH_INPUT == INPUT_ANDROID
 	Android_RunEvents();
 #endif
 
-	newtime = Sys_DoubleTime ();
-
-	Host_Frame( newtime - oldtime );
-
-	oldtime = newtime;
+	Host_Frame();
 }
 
 void Host_FrameLoop()
@@ -659,6 +669,97 @@ void Host_GetConsoleCommands( void )
 	}
 }
 
+/*
+===================
+Host_SchedTick
+
+called when a frame is accepted, measures how late
+it was and sets the deadline for the next one
+===================
+*/
+static void Host_SchedTick( float fps )
+{
+	double	now = Sys_DoubleTime();
+
+	if( host_schedstate.deadline > 0.0 )
+	{
+		double	jitter = fabs( now - host_schedstate.deadline );
+
+		host_schedstate.jitter_sum += jitter;
+		host_schedstate.jitter_max = max( host_schedstate.jitter_max, jitter );
+		host_schedstate.ticks++;
+	}
+
+	// fps_max 0 means unlimited, fall back to plain sleeptime
+	if( fps > 0.0f ) host_schedstate.deadline = now + 1.0 / fps;
+	else host_schedstate.deadline = 0.0;
+}
+
+/*
+===================
+Host_SchedSleep
+
+wait for the next server tick, but process incoming
+packets as soon as they arrive so usercmds are not
+delayed until the next frame
+===================
+*/
+static void Host_SchedSleep( void )
+{
+	double	remaining;
+	qboolean	slept = false;
+
+	while(( remaining = host_schedstate.deadline - Sys_DoubleTime( )) > 0.0 )
+	{
+		slept = true;
+
+		if( !NET_Sleep( (int)( remaining * 1000000.0 ) + 1 ))
+		{
+			host_schedstate.wakes[SCHED_WAKE_DEADLINE]++;
+			return;
+		}
+
+		host_schedstate.wakes[SCHED_WAKE_PACKET]++;
+		SV_ReadPackets();
+	}
+
+	if( !slept ) host_schedstate.wakes[SCHED_WAKE_OVERRUN]++;
+}
+
+/*
+===================
+Host_SchedStats_f
+===================
+*/
+static void Host_SchedStats_f( void )
+{
+	int	i, total = 0;
+
+	if( Cmd_Argc() > 1 && !Q_stricmp( Cmd_Argv( 1 ), "reset" ))
+	{
+		host_schedstate.jitter_sum = host_schedstate.jitter_max = 0.0;
+		host_schedstate.ticks = 0;
+		for( i = 0; i < SCHED_WAKE_COUNT; i++ )
+			host_schedstate.wakes[i] = 0;
+		return;
+	}
+
+	for( i = 0; i < SCHED_WAKE_COUNT; i++ )
+		total += host_schedstate.wakes[i];
+
+	Msg( "====================\n" );
+	Msg( "server frame scheduler statistics\n" );
+	Msg( "====================\n" );
+	Msg( "scheduler: %s\n", host_sched->integer ? "event-driven" : "sleeptime" );
+	Msg( "ticks: %i\n", host_schedstate.ticks );
+	Msg( "average jitter: %.3f ms\n", host_schedstate.ticks ? host_schedstate.jitter_sum * 1000.0 / host_schedstate.ticks : 0.0 );
+	Msg( "maximum jitter: %.3f ms\n", host_schedstate.jitter_max * 1000.0 );
+	Msg( "wakeups: %i\n", total );
+	Msg( "  deadline: %i\n", host_schedstate.wakes[SCHED_WAKE_DEADLINE] );
+	Msg( "  packet: %i\n", host_schedstate.wakes[SCHED_WAKE_PACKET] );
+	Msg( "  overrun: %i\n", host_schedstate.wakes[SCHED_WAKE_OVERRUN] );
+}
+
 /*
 ===================
 Host_FilterTime
@@ -701,6 +802,9 @@ qboolean Host_FilterTime( float time )
 	host.realframetime = bound( MIN_FRAMETIME, host.frametime, MAX_FRAMETIME );
 	oldtime = host.realtime;
 
+	if( Host_IsDedicated( ))
+		Host_SchedTick( fps );
+
 	if( host_framerate->value > 0 && ( Host_IsLocalGame()))
 	{
 		fps = host_framerate->value * scale;
@@ -732,9 +836,10 @@ void Host_Autosleep( void )
 
 	if( Host_IsDedicated() )
 	{
-		// let the dedicated server some sleep
-		Sys_Sleep( sleeptime );
-
+		// wake up on the next tick or incoming packet
+		if( host_sched->integer && host_schedstate.deadline > 0.0 )
+			Host_SchedSleep();
+		else Sys_Sleep( sleeptime ); // let the dedicated server some sleep
 	}
 	else
 	{
@@ -761,15 +866,29 @@ void Host_Autosleep( void )
 Host_Frame
 =================
 */
-void Host_Frame( float time )
+void Host_Frame( void )
 {
+	static double	oldtime;
+	double		newtime;
+	float		time;
+
 #ifndef NO_SJLJ
 	if( setjmp( host.abortframe ))
+	{
+		// don't leave datagrams queued
+		NET_EndSendBatch();
 		return;
+	}
 #endif
 
 	Host_Autosleep();
 
+	// measure after sleep, scheduler wakes up right at the frame deadline
+	newtime = Sys_DoubleTime();
+	if( !oldtime ) oldtime = newtime;
+	time = newtime - oldtime;
+	oldtime = newtime;
+
 	// decide the simulation time
 	if( !Host_FilterTime( time ))
 		return;
@@ -1276,6 +1395,7 @@ int EXPORT Host_Main( int argc, const char **argv, const char *progname, int bCh
 	host_cheats = Cvar_Get( "sv_cheats", "0", CVAR_LATCH, "allow usage of cheat commands and variables" );
 	host_maxfps = Cvar_Get( "fps_max", "72", CVAR_ARCHIVE, "host fps upper limit" );
 	host_sleeptime = Cvar_Get( "sleeptime", DEFAULT_SLEEPTIME, CVAR_ARCHIVE|CVAR_LOCALONLY, "higher value means lower accuracy" );
+	host_sched = Cvar_Get( "host_sched", "1", CVAR_ARCHIVE, "dedicated server waits for incoming packets or the next tick instead of sleeptime" );
 	host_framerate = Cvar_Get( "host_framerate", "0", CVAR_LOCALONLY, "locks frame timing to this value in seconds" );
 	host_serverstate = Cvar_Get( "host_serverstate", "0", CVAR_INIT, "displays current server state" );
 	host_gameloaded = Cvar_Get( "host_gameloaded", "0", CVAR_INIT, "indicates a loaded game library" );
@@ -1366,6 +1486,7 @@ int EXPORT Host_Main( int argc, const char **argv, const char *progname, int bCh
 	{
 		Cmd_AddCommand( "quit", Sys_Quit, "quit the game" );
 		Cmd_AddCommand( "exit", Sys_Quit, "quit the game" );
+		Cmd_AddCommand( "host_sched_stats", Host_SchedStats_f, "show server frame scheduler statistics" );
 
 		Cbuf_AddText( "exec config.cfg\n" );
 
@@ -1477,6 +1598,7 @@ void EXPORT Host_Shutdown( void )
 	}
 #endif
 
+	Sys_ShutdownJobs();
 	Mod_Shutdown();
 	NET_Shutdown();
 	HTTP_Shutdown();
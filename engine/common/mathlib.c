@@ -567,6 +567,75 @@ void AngleQuaternion( const vec3_t angles, vec4_t q, qboolean studio )
 	q[3] = cr * cp * cy + sr * sp * sy; // W
 }
 
+/*
+====================
+AngleQuaternionArray
+
+same as studio AngleQuaternion but for arrays of angles
+split by component, four of them share one sincos
+====================
+*/
+void AngleQuaternionArray( const float *x, const float *y, const float *z, vec4_t *q, int count )
+{
+	float	sr, sp, sy, cr, cp, cy;
+	int	i = 0;
+
+#if defined( XASH_VECTORIZE_SINCOS ) && ( defined( __ARM_NEON__ ) || defined( __NEON__ ))
+	v4sf	half = vdupq_n_f32( 0.5f );
+	v4sf	vsr, vsp, vsy, vcr, vcp, vcy;
+	float32x4x4_t	out;
+
+	for( ; i + 4 <= count; i += 4 )
+	{
+		sincos_ps( vmulq_f32( vld1q_f32( x + i ), half ), &vsr, &vcr );
+		sincos_ps( vmulq_f32( vld1q_f32( y + i ), half ), &vsp, &vcp );
+		sincos_ps( vmulq_f32( vld1q_f32( z + i ), half ), &vsy, &vcy );
+
+		out.val[0] = vsubq_f32( vmulq_f32( vmulq_f32( vsr, vcp ), vcy ), vmulq_f32( vmulq_f32( vcr, vsp ), vsy ));
+		out.val[1] = vaddq_f32( vmulq_f32( vmulq_f32( vcr, vsp ), vcy ), vmulq_f32( vmulq_f32( vsr, vcp ), vsy ));
+		out.val[2] = vsubq_f32( vmulq_f32( vmulq_f32( vcr, vcp ), vsy ), vmulq_f32( vmulq_f32( vsr, vsp ), vcy ));
+		out.val[3] = vaddq_f32( vmulq_f32( vmulq_f32( vcr, vcp ), vcy ), vmulq_f32( vmulq_f32( vsr, vsp ), vsy ));
+
+		// interleave back to x y z w
+		vst4q_f32( q[i], out );
+	}
+#elif defined( XASH_VECTORIZE_SINCOS )
+	v4sf	half = _mm_set1_ps( 0.5f );
+	v4sf	vsr, vsp, vsy, vcr, vcp, vcy;
+	v4sf	qx, qy, qz, qw;
+
+	for( ; i + 4 <= count; i += 4 )
+	{
+		sincos_ps( _mm_mul_ps( _mm_loadu_ps( x + i ), half ), &vsr, &vcr );
+		sincos_ps( _mm_mul_ps( _mm_loadu_ps( y + i ), half ), &vsp, &vcp );
+		sincos_ps( _mm_mul_ps( _mm_loadu_ps( z + i ), half ), &vsy, &vcy );
+
+		qx = _mm_sub_ps( _mm_mul_ps( _mm_mul_ps( vsr, vcp ), vcy ), _mm_mul_ps( _mm_mul_ps( vcr, vsp ), vsy ));
+		qy = _mm_add_ps( _mm_mul_ps( _mm_mul_ps( vcr, vsp ), vcy ), _mm_mul_ps( _mm_mul_ps( vsr, vcp ), vsy ));
+		qz = _mm_sub_ps( _mm_mul_ps( _mm_mul_ps( vcr, vcp ), vsy ), _mm_mul_ps( _mm_mul_ps( vsr, vsp ), vcy ));
+		qw = _mm_add_ps( _mm_mul_ps( _mm_mul_ps( vcr, vcp ), vcy ), _mm_mul_ps( _mm_mul_ps( vsr, vsp ), vsy ));
+
+		// interleave back to x y z w
+		_MM_TRANSPOSE4_PS( qx, qy, qz, qw );
+		_mm_storeu_ps( q[i+0], qx );
+		_mm_storeu_ps( q[i+1], qy );
+		_mm_storeu_ps( q[i+2], qz );
+		_mm_storeu_ps( q[i+3], qw );
+	}
+#endif
+	for( ; i < count; i++ )
+	{
+		SinCos( z[i] * 0.5f, &sy, &cy );
+		SinCos( y[i] * 0.5f, &sp, &cp );
+		SinCos( x[i] * 0.5f, &sr, &cr );
+
+		q[i][0] = sr * cp * cy - cr * sp * sy; // X
+		q[i][1] = cr * sp * cy + sr * cp * sy; // Y
+		q[i][2] = cr * cp * sy - sr * sp * cy; // Z
+		q[i][3] = cr * cp * cy + sr * sp * sy; // W
+	}
+}
+
 /*
 ====================
 QuaternionSlerp
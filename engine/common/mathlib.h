@@ -168,6 +168,7 @@ qboolean BoundsAndSphereIntersect( const vec3_t mins, const vec3_t maxs, const v
 float RadiusFromBounds( const vec3_t mins, const vec3_t maxs );
 
 void AngleQuaternion( const vec3_t angles, vec4_t q, qboolean studio );
+void AngleQuaternionArray( const float *x, const float *y, const float *z, vec4_t *q, int count );
 void QuaternionSlerp( const vec4_t p, vec4_t q, float t, vec4_t qt );
 void QuaternionAngle( const vec4_t q, vec3_t angles );
 float RemapVal( float val, float A, float B, float C, float D );
@@ -47,6 +47,16 @@ GNU General Public License for more details.
 #define MODEL_HAS_ORIGIN		BIT( 1 )
 #define MODEL_LIQUID		BIT( 2 )	// model has only point hull
 
+// clipnode with its plane, hull traces touch one cache line per node
+typedef struct
+{
+	vec3_t		normal;
+	float		dist;
+	int		type;
+	int		children[2];
+	int		pad;		// keep 32 bytes
+} mclipnode_t;
+
 typedef struct wadlist_s
 {
 	char		wadnames[256][32];
@@ -90,12 +100,16 @@ typedef struct
 	vec3_t		mins;		// real accuracy world bounds
 	vec3_t		maxs;
 	vec3_t		size;
+
+	const dclipnode_t	*clipnodes[2];	// hull 0 and hulls 1-3 of worldmodel
+	mclipnode_t	*packednodes[2];	// same nodes with planes
 } world_static_t;
 
 extern world_static_t	world;
 extern byte		*com_studiocache;
 extern model_t		*loadmodel;
 extern convar_t		*mod_studiocache;
+extern convar_t		*mod_studiocache_size;
 extern int		bmodel_version;	// only actual during loading
 
 //
@@ -128,6 +142,7 @@ int Mod_BoxLeafnums( const vec3_t mins, const vec3_t maxs, short *list, int list
 qboolean Mod_BoxVisible( const vec3_t mins, const vec3_t maxs, const byte *visbits );
 void Mod_BuildSurfacePolygons( msurface_t *surf, mextrasurf_t *info );
 void Mod_AmbientLevels( const vec3_t p, byte *pvolumes );
+mclipnode_t *Mod_PackedClipnodes( const hull_t *hull );
 byte *Mod_CompressVis( const byte *in, size_t *size );
 byte *Mod_DecompressVis( const byte *in );
 modtype_t Mod_GetType( int handle );
@@ -140,6 +155,10 @@ struct wadlist_s *Mod_WadList( void );
 void Mod_InitStudioAPI( void );
 void Mod_InitStudioHull( void );
 void Mod_ResetStudioAPI( void );
+void Mod_ClearStudioCache( void );
+void Mod_FreeStudioCache( void );
+void Mod_StudioCacheStats_f( void );
+void Mod_StudioBoneBench_f( void );
 qboolean Mod_GetStudioBounds( const char *name, vec3_t mins, vec3_t maxs );
 void Mod_StudioGetAttachment( const edict_t *e, int iAttachment, float *org, float *ang );
 void Mod_GetBonePosition( const edict_t *e, int iBone, float *org, float *ang );
@@ -21,42 +21,65 @@ GNU General Public License for more details.
 
 typedef int (*STUDIOAPI)( int, sv_blending_interface_t**, server_studio_api_t*,  float (*transform)[3][4], float (*bones)[MAXSTUDIOBONES][3][4] );
 
-typedef struct mstudiocache_s
+typedef struct
 {
+	model_t	*model;
 	float	frame;
 	int	sequence;
 	vec3_t	angles;
 	vec3_t	origin;
 	vec3_t	size;
-	byte	controler[4];
+	byte	controller[4];
 	byte	blending[2];
-	model_t	*model;
-	uint32_t	current_hull;
-	uint32_t	current_plane;
-	uint32_t	numhitboxes;
+	byte	skipshield;
+	byte	pad;
+} studiokey_t;
+
+typedef struct mstudiocache_s
+{
+	studiokey_t	key;
+	uint		hash;
+	int		hashnext;		// next entry in bucket
+	int		prev, next;	// LRU links, head is most recently used
+	int		framecount;	// last frame it was used, live entries are not evicted
+	mplane_t		*planes;		// numhitboxes * 6
+	uint32_t		*hitgroup;
+	int		numhitboxes;
+	int		maxhitboxes;	// allocated size
 } mstudiocache_t;
 
-#define STUDIO_CACHESIZE		16
-#define STUDIO_CACHEMASK		(STUDIO_CACHESIZE - 1)
+#define STUDIO_CACHESIZE		1024	// max entries
+#define STUDIO_CACHEHASH		1024	// must be power of two
+#define STUDIO_HITBOXSIZE		( sizeof( mplane_t ) * 6 + sizeof( uint32_t ))
+
+static struct
+{
+	mstudiocache_t	entries[STUDIO_CACHESIZE];
+	int		buckets[STUDIO_CACHEHASH];
+	int		head, tail;	// LRU list
+	int		freelist;		// chained through hashnext
+	size_t		bytes;		// allocated hitbox memory
+	qboolean		initialized;
+
+	// stats
+	uint		hits;
+	uint		misses;
+	uint		evictions;
+	uint		skipped;		// not stored because every entry was live
+	uint		framehits;	// hits in framecount
+	int		framecount;
+} cache_studio;
 
 // trace global variables
 static sv_blending_interface_t	*pBlendAPI = NULL;
 static studiohdr_t			*mod_studiohdr;
 static matrix3x4			studio_transform;
-static hull_t			cache_hull[MAXSTUDIOBONES];
 static hull_t			studio_hull[MAXSTUDIOBONES];
 static matrix3x4			studio_bones[MAXSTUDIOBONES];
 static uint32_t			studio_hull_hitgroup[MAXSTUDIOBONES];
-static uint32_t			cache_hull_hitgroup[MAXSTUDIOBONES];
-static mstudiocache_t		cache_studio[STUDIO_CACHESIZE];
 static dclipnode_t			studio_clipnodes[6];
+static qboolean			mod_scalarbones;		// studio_bonebench only
 static mplane_t			studio_planes[768];
-static mplane_t			cache_planes[768];
-
-// current cache state
-static int			cache_current;
-static int			cache_current_hull;
-static int			cache_current_plane;
 
 /*
 ====================
@@ -100,51 +123,275 @@ void Mod_InitStudioHull( void )
 /*
 ====================
 ClearStudioCache
+
+models were freed, so model pointers can be reused
 ====================
 */
 void Mod_ClearStudioCache( void )
 {
-	Q_memset( cache_studio, 0, sizeof( cache_studio ));
-	cache_current_hull = cache_current_plane = 0;
+	mstudiocache_t	*pCache;
+	int		i;
+
+	for( i = 0; i < STUDIO_CACHEHASH; i++ )
+		cache_studio.buckets[i] = -1;
+
+	for( i = 0; i < STUDIO_CACHESIZE; i++ )
+	{
+		pCache = &cache_studio.entries[i];
+		pCache->hashnext = ( i < STUDIO_CACHESIZE - 1 ) ? i + 1 : -1;
+		pCache->prev = pCache->next = -1;
+		if( pCache->planes ) Mem_Free( pCache->planes );
+		pCache->planes = NULL;
+		pCache->hitgroup = NULL;
+		pCache->maxhitboxes = 0;
+		pCache->numhitboxes = 0;
+	}
+
+	cache_studio.head = cache_studio.tail = -1;
+	cache_studio.freelist = 0;
+	cache_studio.bytes = 0;
+	cache_studio.initialized = true;
+}
+
+/*
+====================
+FreeStudioCache
+====================
+*/
+void Mod_FreeStudioCache( void )
+{
+	int	i;
+
+	for( i = 0; i < STUDIO_CACHESIZE; i++ )
+	{
+		if( cache_studio.entries[i].planes )
+			Mem_Free( cache_studio.entries[i].planes );
+	}
+
+	Q_memset( &cache_studio, 0, sizeof( cache_studio ));
+}
+
+/*
+====================
+StudioCacheUnlink
+
+removes entry from LRU list
+====================
+*/
+static void Mod_StudioCacheUnlink( int index )
+{
+	mstudiocache_t	*pCache = &cache_studio.entries[index];
+
+	if( pCache->prev != -1 ) cache_studio.entries[pCache->prev].next = pCache->next;
+	else cache_studio.head = pCache->next;
+
+	if( pCache->next != -1 ) cache_studio.entries[pCache->next].prev = pCache->prev;
+	else cache_studio.tail = pCache->prev;
+
+	pCache->prev = pCache->next = -1;
+}
+
+/*
+====================
+StudioCacheTouch
+
+moves entry to the head of LRU list
+====================
+*/
+static void Mod_StudioCacheTouch( int index )
+{
+	mstudiocache_t	*pCache = &cache_studio.entries[index];
+
+	if( cache_studio.head != index )
+	{
+		Mod_StudioCacheUnlink( index );
+
+		pCache->next = cache_studio.head;
+		if( cache_studio.head != -1 )
+			cache_studio.entries[cache_studio.head].prev = index;
+		else cache_studio.tail = index;
+		cache_studio.head = index;
+	}
+
+	pCache->framecount = host.framecount;
+}
+
+/*
+====================
+StudioCacheEvict
+
+drops least recently used entry, returns its index
+====================
+*/
+static int Mod_StudioCacheEvict( void )
+{
+	mstudiocache_t	*pCache;
+	int		index, *link;
+
+	index = cache_studio.tail;
+	if( index == -1 ) return -1;
+
+	pCache = &cache_studio.entries[index];
+	Mod_StudioCacheUnlink( index );
+
+	for( link = &cache_studio.buckets[pCache->hash & (STUDIO_CACHEHASH - 1)]; *link != -1; link = &cache_studio.entries[*link].hashnext )
+	{
+		if( *link == index )
+		{
+			*link = pCache->hashnext;
+			break;
+		}
+	}
+
+	pCache->numhitboxes = 0;
+	cache_studio.evictions++;
 
-	cache_current = 0;
+	return index;
+}
+
+/*
+====================
+StudioCacheTailLive
+
+least recently used entry was used in this frame, so
+every entry is. evicting it would make the frame drop
+entries it still needs, better don't store the new one
+====================
+*/
+static qboolean Mod_StudioCacheTailLive( void )
+{
+	if( cache_studio.tail == -1 )
+		return false;
+
+	return ( cache_studio.entries[cache_studio.tail].framecount == host.framecount );
+}
+
+/*
+====================
+StudioCacheKey
+====================
+*/
+static uint Mod_StudioCacheKey( studiokey_t *key, model_t *model, float frame, int sequence, vec3_t angles, vec3_t origin, vec3_t size, byte *pcontroller, byte *pblending, qboolean skipshield )
+{
+	const byte	*data = (const byte *)key;
+	uint		hash = 2166136261U;
+	size_t		i;
+
+	// clear the padding so key can be compared with memcmp
+	Q_memset( key, 0, sizeof( *key ));
+
+	key->model = model;
+	key->frame = frame;
+	key->sequence = sequence;
+	VectorCopy( angles, key->angles );
+	VectorCopy( origin, key->origin );
+	VectorCopy( size, key->size );
+	Q_memcpy( key->controller, pcontroller, 4 );
+	Q_memcpy( key->blending, pblending, 2 );
+	key->skipshield = skipshield;
+
+	for( i = 0; i < sizeof( *key ); i++ )
+		hash = ( hash ^ data[i] ) * 16777619U;
+
+	return hash;
 }
 
 /*
 ====================
 AddToStudioCache
+
+stores hitbox planes of current studio_hull. total hitbox
+memory is kept under r_studiocache_size by dropping entries
+which were not used in this frame
 ====================
 */
-void Mod_AddToStudioCache( float frame, int sequence, vec3_t angles, vec3_t origin, vec3_t size, byte *pcontroller, byte *pblending, model_t *model, hull_t *hull, int numhitboxes )
+void Mod_AddToStudioCache( const studiokey_t *key, uint hash, int numhitboxes )
 {
-	mstudiocache_t *pCache;
+	mstudiocache_t	*pCache;
+	size_t		budget;
+	int		index;
+
+	if( numhitboxes <= 0 || numhitboxes > MAXSTUDIOBONES )
+		return;
 
-	if( numhitboxes + cache_current_hull >= MAXSTUDIOBONES )
+	if( !cache_studio.initialized )
 		Mod_ClearStudioCache();
 
-	cache_current++;
-	pCache = &cache_studio[cache_current & STUDIO_CACHEMASK];
+	if( cache_studio.freelist != -1 )
+	{
+		index = cache_studio.freelist;
+		cache_studio.freelist = cache_studio.entries[index].hashnext;
+	}
+	else if( !Mod_StudioCacheTailLive( ))
+	{
+		index = Mod_StudioCacheEvict();
+	}
+	else
+	{
+		cache_studio.skipped++;
+		return;
+	}
 
-	pCache->frame = frame;
-	pCache->sequence = sequence;
-	VectorCopy( angles, pCache->angles );
-	VectorCopy( origin, pCache->origin );
-	VectorCopy( size, pCache->size );
+	pCache = &cache_studio.entries[index];
 
-	Q_memcpy( pCache->controler, pcontroller, 4 );
-	Q_memcpy( pCache->blending, pblending, 2 );
+	if( pCache->maxhitboxes < numhitboxes )
+	{
+		budget = (size_t)max( mod_studiocache_size->integer, 1 ) * 1024;
+
+		if( pCache->planes )
+		{
+			Mem_Free( pCache->planes );
+			cache_studio.bytes -= pCache->maxhitboxes * STUDIO_HITBOXSIZE;
+			pCache->planes = NULL;
+			pCache->maxhitboxes = 0;
+		}
+
+		// make room for the new hitboxes
+		while( cache_studio.bytes + numhitboxes * STUDIO_HITBOXSIZE > budget && cache_studio.tail != -1 )
+		{
+			mstudiocache_t	*pOld;
+
+			if( Mod_StudioCacheTailLive( ))
+			{
+				// give the entry back, hitboxes don't fit in this frame
+				pCache->hashnext = cache_studio.freelist;
+				cache_studio.freelist = index;
+				cache_studio.skipped++;
+				return;
+			}
 
-	pCache->model = model;
-	pCache->current_hull = cache_current_hull;
-	pCache->current_plane = cache_current_plane;
+			pOld = &cache_studio.entries[Mod_StudioCacheEvict()];
 
-	Q_memcpy( &cache_hull[cache_current_hull], hull, numhitboxes * sizeof( hull_t ));
-	Q_memcpy( &cache_planes[cache_current_plane], studio_planes, numhitboxes * sizeof( mplane_t ) * 6 );
-	Q_memcpy( &cache_hull_hitgroup[cache_current_hull], studio_hull_hitgroup, numhitboxes * sizeof( uint32_t ));
+			if( pOld->planes )
+			{
+				Mem_Free( pOld->planes );
+				cache_studio.bytes -= pOld->maxhitboxes * STUDIO_HITBOXSIZE;
+				pOld->planes = NULL;
+				pOld->maxhitboxes = 0;
+			}
 
-	cache_current_hull += numhitboxes;
-	cache_current_plane += numhitboxes * 6;
+			pOld->hashnext = cache_studio.freelist;
+			cache_studio.freelist = pOld - cache_studio.entries;
+		}
+
+		// planes and hitgroups share one block
+		pCache->planes = Z_Malloc( numhitboxes * STUDIO_HITBOXSIZE );
+		pCache->hitgroup = (uint32_t *)(pCache->planes + numhitboxes * 6);
+		pCache->maxhitboxes = numhitboxes;
+		cache_studio.bytes += numhitboxes * STUDIO_HITBOXSIZE;
+	}
+
+	pCache->key = *key;
+	pCache->hash = hash;
 	pCache->numhitboxes = numhitboxes;
+
+	Q_memcpy( pCache->planes, studio_planes, numhitboxes * sizeof( mplane_t ) * 6 );
+	Q_memcpy( pCache->hitgroup, studio_hull_hitgroup, numhitboxes * sizeof( uint32_t ));
+
+	pCache->hashnext = cache_studio.buckets[hash & (STUDIO_CACHEHASH - 1)];
+	cache_studio.buckets[hash & (STUDIO_CACHEHASH - 1)] = index;
+
+	Mod_StudioCacheTouch( index );
 }
 
 /*
@@ -152,25 +399,69 @@ void Mod_AddToStudioCache( float frame, int sequence, vec3_t angles, vec3_t orig
 CheckStudioCache
 ====================
 */
-mstudiocache_t *Mod_CheckStudioCache( model_t *model, float frame, int sequence, vec3_t angles, vec3_t origin, vec3_t size, byte *pcontroller, byte *pblending )
+mstudiocache_t *Mod_CheckStudioCache( const studiokey_t *key, uint hash )
 {
 	mstudiocache_t	*pCache;
-	int		i;
+	int		index;
 
-	for( i = 0; i < STUDIO_CACHESIZE; i++ )
+	if( !cache_studio.initialized )
+		return NULL;
+
+	if( cache_studio.framecount != host.framecount )
 	{
-		pCache = &cache_studio[(cache_current - i) & STUDIO_CACHEMASK];
+		cache_studio.framecount = host.framecount;
+		cache_studio.framehits = 0;
+	}
 
-		if( pCache->model == model && pCache->frame == frame && pCache->sequence == sequence &&
-		VectorCompare( angles, pCache->angles ) && VectorCompare( origin, pCache->origin ) && VectorCompare( size, pCache->size ) &&
-		!Q_memcmp( pCache->controler, pcontroller, 4 ) && !Q_memcmp( pCache->blending, pblending, 2 ))
+	for( index = cache_studio.buckets[hash & (STUDIO_CACHEHASH - 1)]; index != -1; index = pCache->hashnext )
+	{
+		pCache = &cache_studio.entries[index];
+
+		if( pCache->hash == hash && !Q_memcmp( &pCache->key, key, sizeof( *key )))
 		{
+			Mod_StudioCacheTouch( index );
+			cache_studio.framehits++;
+			cache_studio.hits++;
 			return pCache;
 		}
 	}
+
+	cache_studio.misses++;
+
 	return NULL;
 }
 
+/*
+====================
+StudioCacheStats_f
+====================
+*/
+void Mod_StudioCacheStats_f( void )
+{
+	uint	lookups = cache_studio.hits + cache_studio.misses;
+	int	i, used = 0, live = 0;
+
+	if( Cmd_Argc() > 1 && !Q_stricmp( Cmd_Argv( 1 ), "reset" ))
+	{
+		cache_studio.hits = cache_studio.misses = 0;
+		cache_studio.evictions = cache_studio.skipped = 0;
+		return;
+	}
+
+	for( i = cache_studio.head; i != -1; i = cache_studio.entries[i].next )
+	{
+		used++;
+		if( cache_studio.entries[i].framecount == host.framecount )
+			live++;
+	}
+
+	Msg( "studio cache: %i of %i entries, %i used this frame\n", used, STUDIO_CACHESIZE, live );
+	Msg( "memory: %i of %i kb\n", (int)( cache_studio.bytes / 1024 ), mod_studiocache_size->integer );
+	Msg( "hits: %u (%u this frame), misses: %u, evictions: %u\n", cache_studio.hits, cache_studio.framecount == host.framecount ? cache_studio.framehits : 0, cache_studio.misses, cache_studio.evictions );
+	Msg( "skipped: %u, cache was full with entries used in the same frame\n", cache_studio.skipped );
+	if( lookups ) Msg( "hit rate: %.1f%%\n", cache_studio.hits * 100.0 / lookups );
+}
+
 /*
 ===============================================================================
 
@@ -206,6 +497,8 @@ hull_t *Mod_HullForStudio( model_t *model, float frame, int sequence, vec3_t ang
 	vec3_t		angles2;
 	mstudiocache_t	*bonecache;
 	mstudiobbox_t	*phitbox;
+	studiokey_t	key;
+	uint		hash = 0;
 	int		i, j;
 	qboolean bSkipShield = 0;
 
@@ -218,13 +511,14 @@ hull_t *Mod_HullForStudio( model_t *model, float frame, int sequence, vec3_t ang
 
 	if( mod_studiocache->integer )
 	{
-		bonecache = Mod_CheckStudioCache( model, frame, sequence, angles, origin, size, pcontroller, pblending );
+		hash = Mod_StudioCacheKey( &key, model, frame, sequence, angles, origin, size, pcontroller, pblending, bSkipShield );
+		bonecache = Mod_CheckStudioCache( &key, hash );
 
 		if( bonecache != NULL )
 		{
-			Q_memcpy( studio_planes, &cache_planes[bonecache->current_plane], bonecache->numhitboxes * sizeof( mplane_t ) * 6 );
-			Q_memcpy( studio_hull_hitgroup, &cache_hull_hitgroup[bonecache->current_hull], bonecache->numhitboxes * sizeof( uint32_t ));
-			Q_memcpy( studio_hull, &cache_hull[bonecache->current_hull], bonecache->numhitboxes * sizeof( hull_t ));
+			// studio_hull itself never changes, only the planes
+			Q_memcpy( studio_planes, bonecache->planes, bonecache->numhitboxes * sizeof( mplane_t ) * 6 );
+			Q_memcpy( studio_hull_hitgroup, bonecache->hitgroup, bonecache->numhitboxes * sizeof( uint32_t ));
 
 			*numhitboxes = bonecache->numhitboxes;
 			return studio_hull;
@@ -268,7 +562,7 @@ hull_t *Mod_HullForStudio( model_t *model, float frame, int sequence, vec3_t ang
 
 	if( mod_studiocache->integer )
 	{
-		Mod_AddToStudioCache( frame, sequence, angles, origin, size, pcontroller, pblending, model, studio_hull, *numhitboxes );
+		Mod_AddToStudioCache( &key, hash, *numhitboxes );
 	}
 
 	return studio_hull;
@@ -335,15 +629,14 @@ static void Mod_StudioCalcBoneAdj( float *adj, const byte *pcontroller )
 
 /*
 ====================
-StudioCalcBoneQuaterion
+StudioCalcBoneAngles
 
+decodes bone angles of this and next frame
 ====================
 */
-static void Mod_StudioCalcBoneQuaterion( int frame, float s, mstudiobone_t *pbone, mstudioanim_t *panim, float *adj, float *q )
+static void Mod_StudioCalcBoneAngles( int frame, mstudiobone_t *pbone, mstudioanim_t *panim, float *adj, vec3_t angle1, vec3_t angle2 )
 {
 	int		j, k;
-	vec4_t		q1, q2;
-	vec3_t		angle1, angle2;
 	mstudioanimvalue_t	*panimvalue;
 
 	for( j = 0; j < 3; j++ )
@@ -407,6 +700,20 @@ static void Mod_StudioCalcBoneQuaterion( int frame, float s, mstudiobone_t *pbon
 			angle2[j] += adj[pbone->bonecontroller[j+3]];
 		}
 	}
+}
+
+/*
+====================
+StudioCalcBoneQuaterion
+
+====================
+*/
+static void Mod_StudioCalcBoneQuaterion( int frame, float s, mstudiobone_t *pbone, mstudioanim_t *panim, float *adj, float *q )
+{
+	vec4_t		q1, q2;
+	vec3_t		angle1, angle2;
+
+	Mod_StudioCalcBoneAngles( frame, pbone, panim, adj, angle1, angle2 );
 
 	if( !VectorCompare( angle1, angle2 ))
 	{
@@ -420,6 +727,52 @@ static void Mod_StudioCalcBoneQuaterion( int frame, float s, mstudiobone_t *pbon
 	}
 }
 
+/*
+====================
+StudioCalcBoneQuaterions
+
+same as StudioCalcBoneQuaterion for all used bones.
+angles are gathered by component, so AngleQuaternionArray
+converts four bones at once
+====================
+*/
+static void Mod_StudioCalcBoneQuaterions( int boneused[], int numbones, int frame, float s, mstudiobone_t *pbone, mstudioanim_t *panim, float *adj, vec4_t *q )
+{
+	static float	angle1[3][MAXSTUDIOBONES];
+	static float	angle2[3][MAXSTUDIOBONES];
+	static vec4_t	q1[MAXSTUDIOBONES];
+	static vec4_t	q2[MAXSTUDIOBONES];
+	int		i, j, k, count;
+	vec3_t		a1, a2;
+	int		lerped[MAXSTUDIOBONES];
+
+	// lerped bones are packed behind the first numbones angles
+	for( j = count = 0; j < numbones; j++ )
+	{
+		i = boneused[j];
+		Mod_StudioCalcBoneAngles( frame, &pbone[i], &panim[i], adj, a1, a2 );
+
+		for( k = 0; k < 3; k++ )
+			angle1[k][j] = a1[k];
+
+		if( !VectorCompare( a1, a2 ))
+		{
+			for( k = 0; k < 3; k++ )
+				angle2[k][count] = a2[k];
+			lerped[count++] = j;
+		}
+	}
+
+	AngleQuaternionArray( angle1[0], angle1[1], angle1[2], q1, numbones );
+	AngleQuaternionArray( angle2[0], angle2[1], angle2[2], q2, count );
+
+	for( j = 0; j < numbones; j++ )
+		Vector4Copy( q1[j], q[boneused[j]] );
+
+	for( j = 0; j < count; j++ )
+		QuaternionSlerp( q1[lerped[j]], q2[j], s, q[boneused[lerped[j]]] );
+}
+
 /*
 ====================
 StudioCalcBonePosition
@@ -517,10 +870,14 @@ static void Mod_StudioCalcRotations( int boneused[], int numbones, const byte *p
 
 	Mod_StudioCalcBoneAdj( adj, pcontroller );
 
+	if( !mod_scalarbones )
+		Mod_StudioCalcBoneQuaterions( boneused, numbones, frame, s, pbone, panim, adj, q );
+
 	for( j = numbones - 1; j >= 0; j-- )
 	{
 		i = boneused[j];
-		Mod_StudioCalcBoneQuaterion( frame, s, &pbone[i], &panim[i], adj, q[i] );
+		if( mod_scalarbones )
+			Mod_StudioCalcBoneQuaterion( frame, s, &pbone[i], &panim[i], adj, q[i] );
 		Mod_StudioCalcBonePosition( frame, s, &pbone[i], &panim[i], adj, pos[i] );
 	}
 
@@ -1007,6 +1364,119 @@ static void SV_StudioSetupBones( model_t *pModel,	float frame, int sequence, con
 	}
 }
 
+#define STUDIO_BENCH_FRAMES	8	// poses per sequence
+
+/*
+====================
+StudioBoneBench
+
+sets up all bones for every sequence of the model,
+returns biggest difference against bones stored
+in ref, or fills ref when store is set. ref holds
+numseq * STUDIO_BENCH_FRAMES * numbones matrices
+====================
+*/
+static float Mod_StudioBoneBench( model_t *mod, matrix3x4 *ref, qboolean store )
+{
+	byte	controller[4] = { 128, 128, 128, 128 };
+	byte	blending[2] = { 128, 128 };
+	float	frame, diff, maxdiff = 0.0f;
+	int	seq, i, j, k, n = 0;
+
+	for( seq = 0; seq < mod_studiohdr->numseq; seq++ )
+	{
+		for( frame = 0.0f; frame < 256.0f; frame += 256.0f / STUDIO_BENCH_FRAMES )
+		{
+			SV_StudioSetupBones( mod, frame, seq, vec3_origin, vec3_origin, controller, blending, -1, NULL );
+
+			for( i = 0; i < mod_studiohdr->numbones; i++, n++ )
+			{
+				if( store )
+				{
+					Matrix3x4_Copy( ref[n], studio_bones[i] );
+					continue;
+				}
+
+				for( j = 0; j < 3; j++ )
+				{
+					for( k = 0; k < 4; k++ )
+					{
+						diff = fabs( ref[n][j][k] - studio_bones[i][j][k] );
+						maxdiff = max( maxdiff, diff );
+					}
+				}
+			}
+		}
+	}
+
+	return maxdiff;
+}
+
+/*
+====================
+StudioBoneBench_f
+
+times bone setup of loaded studio models with
+scalar and batched quaternions, usage: studio_bonebench [passes]
+====================
+*/
+void Mod_StudioBoneBench_f( void )
+{
+	double	start, scalar = 0.0, batched = 0.0;
+	int	i, pass, passes = 10;
+	int	nummodels = 0, numbones = 0;
+	float	maxdiff = 0.0f;
+	matrix3x4	*ref;
+	model_t	*mod;
+
+	if( Cmd_Argc() > 1 )
+		passes = max( Q_atoi( Cmd_Argv( 1 )), 1 );
+
+	for( i = 0; i < MAX_MODELS; i++ )
+	{
+		mod = Mod_Handle( i );
+
+		if( !mod || mod->type != mod_studio )
+			continue;
+
+		mod_studiohdr = Mod_Extradata( mod );
+		if( !mod_studiohdr || !mod_studiohdr->numbones )
+			continue;
+
+		// reference bones for every pose of this model
+		ref = Z_Malloc( sizeof( matrix3x4 ) * mod_studiohdr->numbones * mod_studiohdr->numseq * STUDIO_BENCH_FRAMES );
+
+		// warm up, also loads sequence groups
+		mod_scalarbones = true;
+		Mod_StudioBoneBench( mod, ref, true );
+
+		start = Sys_DoubleTime();
+		for( pass = 0; pass < passes; pass++ )
+			Mod_StudioBoneBench( mod, ref, false );
+		scalar += Sys_DoubleTime() - start;
+
+		mod_scalarbones = false;
+		start = Sys_DoubleTime();
+		for( pass = 0; pass < passes; pass++ )
+			maxdiff = max( maxdiff, Mod_StudioBoneBench( mod, ref, false ));
+		batched += Sys_DoubleTime() - start;
+
+		numbones += mod_studiohdr->numbones * mod_studiohdr->numseq * STUDIO_BENCH_FRAMES;
+		nummodels++;
+		Mem_Free( ref );
+	}
+
+	if( !nummodels )
+	{
+		Msg( "studio_bonebench: no studio models loaded\n" );
+		return;
+	}
+
+	Msg( "%i models, %i bones per pass, %i passes\n", nummodels, numbones, passes );
+	Msg( "scalar: %.3f ms, batched: %.3f ms (%.2fx)\n", scalar * 1000.0, batched * 1000.0, batched > 0.0 ? scalar / batched : 0.0 );
+	Msg( "max matrix difference: %g\n", maxdiff );
+}
+
 /*
 ====================
 StudioGetAttachment
@@ -36,6 +36,7 @@ static byte	visdata[MAX_MAP_LEAFS/8];	// intermediate buffer
 int		bmodel_version;		// global stuff to detect bsp version
 char		modelname[64];		// short model name (without path and ext)
 convar_t		*mod_studiocache;
+convar_t		*mod_studiocache_size;
 convar_t		*mod_allow_materials;
 convar_t		*r_wadtextures;
 static wadlist_t	wadlist;
@@ -518,6 +519,7 @@ static void Mod_FreeModel( model_t *mod )
 		break;
 	case mod_studio:
 		Mod_UnloadStudioModel( mod );
+		Mod_ClearStudioCache();
 		break;
 	case mod_brush:
 		Mod_UnloadBrushModel( mod );
@@ -539,6 +541,7 @@ void Mod_Init( void )
 {
 	com_studiocache = Mem_AllocPool( "Studio Cache" );
 	mod_studiocache = Cvar_Get( "r_studiocache", "1", CVAR_ARCHIVE, "enables studio cache for speedup tracing hitboxes" );
+	mod_studiocache_size = Cvar_Get( "r_studiocache_size", "1024", CVAR_ARCHIVE, "memory limit for cached hitboxes in kilobytes" );
 	r_wadtextures = Cvar_Get( "r_wadtextures", "1", CVAR_ARCHIVE, "completely ignore textures in the wad-files if disabled" );
 
 	if( !Host_IsDedicated() )
@@ -547,6 +550,8 @@ void Mod_Init( void )
 
 	Cmd_AddCommand( "mapstats", Mod_PrintBSPFileSizes_f, "show stats for currently loaded map" );
 	Cmd_AddCommand( "modellist", Mod_Modellist_f, "display loaded models list" );
+	Cmd_AddCommand( "studio_bonebench", Mod_StudioBoneBench_f, "time bone setup of loaded studio models, scalar against batched" );
+	Cmd_AddCommand( "studio_cache_stats", Mod_StudioCacheStats_f, "show hitbox cache hits, misses and evictions, 'reset' to clear" );
 
 	Mod_ResetStudioAPI ();
 	Mod_InitStudioHull ();
@@ -582,6 +587,7 @@ void Mod_ClearUserData( void )
 void Mod_Shutdown( void )
 {
 	Mod_ClearAll( false );
+	Mod_FreeStudioCache();
 	Mem_FreePool( &com_studiocache );
 }
 
@@ -2427,6 +2433,70 @@ static void Mod_LoadClipnodes( const dlump_t *l )
 	}
 }
 
+/*
+=================
+Mod_PackHull
+=================
+*/
+static mclipnode_t *Mod_PackHull( const hull_t *hull, int count )
+{
+	mclipnode_t	*out, *packed;
+	dclipnode_t	*in;
+	mplane_t		*plane;
+	int		i;
+
+	packed = out = Mem_Alloc( loadmodel->mempool, count * sizeof( *out ));
+
+	for( i = 0, in = hull->clipnodes; i < count; i++, in++, out++ )
+	{
+		plane = hull->planes + in->planenum;
+		VectorCopy( plane->normal, out->normal );
+		out->dist = plane->dist;
+		out->type = plane->type;
+		out->children[0] = in->children[0];
+		out->children[1] = in->children[1];
+	}
+
+	return packed;
+}
+
+/*
+=================
+Mod_PackClipnodes
+
+copy world clipnodes with their planes for World_HullTrace,
+submodels share them so firstclipnode stays valid
+=================
+*/
+static void Mod_PackClipnodes( void )
+{
+	world.clipnodes[0] = loadmodel->hulls[0].clipnodes;
+	world.packednodes[0] = Mod_PackHull( &loadmodel->hulls[0], loadmodel->numnodes );
+	world.clipnodes[1] = loadmodel->clipnodes;
+	world.packednodes[1] = Mod_PackHull( &loadmodel->hulls[1], loadmodel->numclipnodes );
+}
+
+/*
+=================
+Mod_PackedClipnodes
+
+returns NULL for hulls that are not made of world clipnodes
+=================
+*/
+mclipnode_t *Mod_PackedClipnodes( const hull_t *hull )
+{
+	if( !hull->clipnodes )
+		return NULL;
+
+	if( hull->clipnodes == world.clipnodes[0] )
+		return world.packednodes[0];
+
+	if( hull->clipnodes == world.clipnodes[1] )
+		return world.packednodes[1];
+
+	return NULL;
+}
+
 /*
 =================
 Mod_FindModelOrigin
@@ -2684,6 +2754,13 @@ void Mod_UnloadBrushModel( model_t *mod )
 			GL_FreeTexture( tx->fb_texturenum );	// luma texture
 		}
 #endif
+		// packed clipnodes live in the world mempool
+		if( mod->clipnodes == world.clipnodes[1] )
+		{
+			Q_memset( world.clipnodes, 0, sizeof( world.clipnodes ));
+			Q_memset( world.packednodes, 0, sizeof( world.packednodes ));
+		}
+
 		Mem_FreePool( &mod->mempool );
 	}
 
@@ -2780,6 +2857,9 @@ static void Mod_LoadBrushModel( model_t *mod, const void *buffer, qboolean *load
 	Mod_LoadSubmodels( &header->lumps[LUMP_MODELS] );
 
 	Mod_MakeHull0 ();
+
+	if( world.loading )
+		Mod_PackClipnodes ();
 	
 	loadmodel->numframes = 2;	// regular and alternate animation
 	ents = loadmodel->entities;
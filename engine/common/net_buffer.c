@@ -24,6 +24,62 @@ GNU General Public License for more details.
 static uint32_t	BitWriteMasks[32][33];
 static uint32_t	ExtraMasks[32];
 
+#ifndef XASH_BIG_ENDIAN
+// bits are stored lsb first, so on little endian hosts
+// any 64-bit window of the buffer is one plain load
+#define BF_WORD_IO
+#endif
+
+static qboolean	bf_wordio = true;	// net_bitbench turns it off to compare
+
+#ifdef BF_WORD_IO
+/*
+=======================
+BF_WriteWordBits
+
+writes up to 57 bits with single 64-bit read-modify-write,
+caller makes sure there are 8 bytes behind current byte
+=======================
+*/
+static inline void BF_WriteWordBits( sizebuf_t *bf, uint64_t curData, int numbits )
+{
+	byte	*p = bf->pData + ( bf->iCurBit >> 3 );
+	int	shift = bf->iCurBit & 7;
+	uint64_t	mask, data;
+
+	mask = ((((uint64_t)1 ) << numbits ) - 1 ) << shift;
+
+	memcpy( &data, p, sizeof( data ));
+	data = ( data & ~mask ) | (( curData << shift ) & mask );
+	memcpy( p, &data, sizeof( data ));
+
+	bf->iCurBit += numbits;
+}
+
+/*
+=======================
+BF_ReadWordBits
+
+same as BF_WriteWordBits for reading
+=======================
+*/
+static inline uint64_t BF_ReadWordBits( sizebuf_t *bf, int numbits )
+{
+	uint64_t	data;
+
+	memcpy( &data, bf->pData + ( bf->iCurBit >> 3 ), sizeof( data ));
+	data >>= bf->iCurBit & 7;
+	bf->iCurBit += numbits;
+
+	return data & ((((uint64_t)1 ) << numbits ) - 1 );
+}
+
+static inline qboolean BF_HasWord( sizebuf_t *bf )
+{
+	return bf_wordio && (( bf->iCurBit >> 3 ) + 8 ) <= BF_GetMaxBytes( bf );
+}
+#endif
+
 short BF_BigShort( short swap )
 {
 #ifndef XASH_BIG_ENDIAN
@@ -150,15 +206,22 @@ void BF_WriteUBitLongExt( sizebuf_t *bf, uint32_t curData, int numbits, qboolean
 		uint32_t	iCurBitMasked;
 		int	nBitsWritten;
 		uint32_t data;
-
+#ifdef BF_WORD_IO
+		if( BF_HasWord( bf ))
+		{
+			BF_WriteWordBits( bf, curData, numbits );
+			return;
+		}
+#endif
 		Assert(( iDWord * 4 + sizeof( int )) <= (uint32_t)BF_GetMaxBytes( bf ));
 
 		iCurBitMasked = iCurBit & 31;
 
 		data = LittleLong(((uint32_t *)bf->pData)[iDWord]);
 
+		// don't let bits above numbits leak into the buffer
 		data &= BitWriteMasks[iCurBitMasked][nBitsLeft];
-		data |= curData << iCurBitMasked;
+		data |= ( curData << iCurBitMasked ) & ~BitWriteMasks[iCurBitMasked][nBitsLeft];
 
 		((uint32_t *)bf->pData)[iDWord] = LittleLong(data);
 
@@ -174,7 +237,7 @@ void BF_WriteUBitLongExt( sizebuf_t *bf, uint32_t curData, int numbits, qboolean
 			iCurBitMasked = iCurBit & 31;
 			data = LittleLong(((uint32_t *)bf->pData)[iDWord+1]);
 			data &= BitWriteMasks[iCurBitMasked][nBitsLeft];
-			data |= curData << iCurBitMasked;
+			data |= ( curData << iCurBitMasked ) & ~BitWriteMasks[iCurBitMasked][nBitsLeft];
 			((uint32_t *)bf->pData)[iDWord+1] = LittleLong( data );
 		}
 		bf->iCurBit += numbits;
@@ -218,6 +281,32 @@ qboolean BF_WriteBits( sizebuf_t *bf, const void *pData, int nBits )
 {
 	byte	*pOut = (byte *)pData;
 	int	nBitsLeft = nBits;
+#ifdef BF_WORD_IO
+	// bulk data that fits goes whole bytes at once when aligned
+	// or 56 bits per store, overflowing writes take the slow way
+	if( bf_wordio && nBits >= 64 && ( bf->iCurBit + nBits ) <= bf->nDataBits )
+	{
+		if(( bf->iCurBit & 7 ) == 0 )
+		{
+			memcpy( bf->pData + ( bf->iCurBit >> 3 ), pOut, nBitsLeft >> 3 );
+			bf->iCurBit += nBitsLeft & ~7;
+			pOut += nBitsLeft >> 3;
+			nBitsLeft &= 7;
+		}
+		else
+		{
+			uint64_t	data = 0;
+
+			while( nBitsLeft >= 56 && BF_HasWord( bf ))
+			{
+				memcpy( &data, pOut, 7 );
+				BF_WriteWordBits( bf, data, 56 );
+				pOut += 7;
+				nBitsLeft -= 56;
+			}
+		}
+	}
+#endif
 #ifndef XASH_BIG_ENDIAN
 	// get output dword-aligned.
 	while((( size_t )pOut & 3 ) != 0 && nBitsLeft >= 8 )
@@ -383,7 +472,10 @@ uint32_t BF_ReadUBitLong( sizebuf_t *bf, int numbits )
 	}
 
 	//ASSERT( numbits > 0 && numbits <= 32 );
-
+#ifdef BF_WORD_IO
+	if( BF_HasWord( bf ))
+		return (uint32_t)BF_ReadWordBits( bf, numbits );
+#endif
 	// Read the current dword.
 	idword1 = bf->iCurBit >> 5;
 	dword1 = LittleLong(((uint32_t *)bf->pData)[idword1]);
@@ -441,6 +533,31 @@ qboolean BF_ReadBits( sizebuf_t *bf, void *pOutData, int nBits )
 {
 	byte	*pOut = (byte *)pOutData;
 	int	nBitsLeft = nBits;
+#ifdef BF_WORD_IO
+	// see BF_WriteBits
+	if( bf_wordio && nBits >= 64 && ( bf->iCurBit + nBits ) <= bf->nDataBits )
+	{
+		if(( bf->iCurBit & 7 ) == 0 )
+		{
+			memcpy( pOut, bf->pData + ( bf->iCurBit >> 3 ), nBitsLeft >> 3 );
+			bf->iCurBit += nBitsLeft & ~7;
+			pOut += nBitsLeft >> 3;
+			nBitsLeft &= 7;
+		}
+		else
+		{
+			uint64_t	data;
+
+			while( nBitsLeft >= 56 && BF_HasWord( bf ))
+			{
+				data = BF_ReadWordBits( bf, 56 );
+				memcpy( pOut, &data, 7 );
+				pOut += 7;
+				nBitsLeft -= 56;
+			}
+		}
+	}
+#endif
 #ifndef XASH_BIG_ENDIAN
 	// get output dword-aligned.
 	while((( size_t )pOut & 3) != 0 && nBitsLeft >= 8 )
@@ -613,3 +730,143 @@ void BF_ExciseBits( sizebuf_t *bf, int startbit, int bitstoremove )
 	BF_SeekToBit( bf, startbit );
 	bf->nDataBits -= bitstoremove;
 }
+
+#define BITBENCH_VALUES	65536
+#define BITBENCH_BLOCKS	128
+#define BITBENCH_BLOCKSIZE	2048
+#define BITBENCH_BUFSIZE	( 512 * 1024 )
+
+/*
+=======================
+BF_BenchLead
+
+bits written before bench block, keeps
+every second block unaligned
+=======================
+*/
+static int BF_BenchLead( sizebuf_t *bf, int block )
+{
+	if( block & 1 ) return 3;
+	return ( 8 - ( bf->iCurBit & 7 )) & 7;
+}
+
+/*
+=======================
+BF_Bench_f
+
+net_bitbench [passes] - time bit and byte io with both paths
+=======================
+*/
+void BF_Bench_f( void )
+{
+	uint32_t	*values;
+	byte	*widths, *block, *out;
+	byte	*buf[2][2];
+	int	lengths[BITBENCH_BLOCKS];
+	double	start, times[2][4];
+	int	bits[2][2], errors = 0;
+	int	i, pass, passes, mode;
+	sizebuf_t	bf;
+
+	passes = ( Cmd_Argc() > 1 ) ? max( Q_atoi( Cmd_Argv( 1 )), 1 ) : 100;
+
+	values = Z_Malloc( BITBENCH_VALUES * sizeof( uint32_t ));
+	widths = Z_Malloc( BITBENCH_VALUES );
+	block = Z_Malloc( BITBENCH_BLOCKSIZE );
+	out = Z_Malloc( BITBENCH_BLOCKSIZE );
+
+	for( i = 0; i < BITBENCH_VALUES; i++ )
+	{
+		widths[i] = Com_RandomLong( 1, 32 );
+		values[i] = ((uint32_t)Com_RandomLong( 0, 0xFFFF ) << 16 ) | Com_RandomLong( 0, 0xFFFF );
+		if( widths[i] < 32 ) values[i] &= ExtraMasks[widths[i]];
+	}
+
+	for( i = 0; i < BITBENCH_BLOCKSIZE; i++ )
+		block[i] = Com_RandomLong( 0, 255 );
+
+	for( i = 0; i < BITBENCH_BLOCKS; i++ )
+		lengths[i] = Com_RandomLong( 1, BITBENCH_BLOCKSIZE );
+
+	for( mode = 0; mode < 2; mode++ )
+	{
+		bf_wordio = mode;
+		buf[mode][0] = Z_Malloc( BITBENCH_BUFSIZE );
+		buf[mode][1] = Z_Malloc( BITBENCH_BUFSIZE );
+		times[mode][0] = times[mode][1] = times[mode][2] = times[mode][3] = 0.0;
+
+		for( pass = 0; pass < passes; pass++ )
+		{
+			BF_Init( &bf, "BitBench", buf[mode][0], BITBENCH_BUFSIZE );
+			start = Sys_DoubleTime();
+			for( i = 0; i < BITBENCH_VALUES; i++ )
+				BF_WriteUBitLong( &bf, values[i], widths[i] );
+			times[mode][0] += Sys_DoubleTime() - start;
+			bits[mode][0] = BF_GetNumBitsWritten( &bf );
+
+			BF_StartReading( &bf, buf[mode][0], BF_GetNumBytesWritten( &bf ), 0, -1 );
+			start = Sys_DoubleTime();
+			for( i = 0; i < BITBENCH_VALUES; i++ )
+			{
+				if( BF_ReadUBitLong( &bf, widths[i] ) != values[i] )
+					errors++;
+			}
+			times[mode][1] += Sys_DoubleTime() - start;
+
+			BF_Init( &bf, "BitBench", buf[mode][1], BITBENCH_BUFSIZE );
+			start = Sys_DoubleTime();
+			for( i = 0; i < BITBENCH_BLOCKS; i++ )
+			{
+				BF_WriteUBitLong( &bf, 0, BF_BenchLead( &bf, i ));
+				BF_WriteBytes( &bf, block, lengths[i] );
+			}
+			times[mode][2] += Sys_DoubleTime() - start;
+			bits[mode][1] = BF_GetNumBitsWritten( &bf );
+
+			BF_StartReading( &bf, buf[mode][1], BF_GetNumBytesWritten( &bf ), 0, -1 );
+			start = Sys_DoubleTime();
+			for( i = 0; i < BITBENCH_BLOCKS; i++ )
+			{
+				BF_ReadUBitLong( &bf, BF_BenchLead( &bf, i ));
+				BF_ReadBytes( &bf, out, lengths[i] );
+				if( memcmp( out, block, lengths[i] ))
+					errors++;
+			}
+			times[mode][3] += Sys_DoubleTime() - start;
+		}
+	}
+
+	bf_wordio = true;
+
+	// both paths must give same bits
+	for( i = 0; i < 2; i++ )
+	{
+		if( bits[0][i] != bits[1][i] || memcmp( buf[0][i], buf[1][i], BitByte( bits[0][i] )))
+			Msg( "^1net_bitbench: word io wrote different bits\n" );
+	}
+
+	Msg( "%i values, %i blocks, %i passes\n", BITBENCH_VALUES, BITBENCH_BLOCKS, passes );
+
+	for( mode = 0; mode < 2; mode++ )
+	{
+		for( i = 0; i < 4; i++ )
+			times[mode][i] = max( times[mode][i], 0.000001 );
+
+		Msg( "%s: bits write %.1f Mbit/s, read %.1f Mbit/s, bytes write %.1f Mbit/s, read %.1f Mbit/s\n",
+			mode ? "word" : "dword",
+			(double)bits[mode][0] * passes / times[mode][0] * 0.000001,
+			(double)bits[mode][0] * passes / times[mode][1] * 0.000001,
+			(double)bits[mode][1] * passes / times[mode][2] * 0.000001,
+			(double)bits[mode][1] * passes / times[mode][3] * 0.000001 );
+
+		Mem_Free( buf[mode][0] );
+		Mem_Free( buf[mode][1] );
+	}
+
+	Msg( "read mismatches: %i\n", errors );
+
+	Mem_Free( values );
+	Mem_Free( widths );
+	Mem_Free( block );
+	Mem_Free( out );
+}
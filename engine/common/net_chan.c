@@ -115,7 +115,7 @@ Collect fragmrnts with signature 0xFFFFFFFE to single packet
 return true when got full packet
 ======================
 */
-qboolean NetSplit_GetLong( netsplit_t *ns, netadr_t *from, byte *data, size_t *length, qboolean decompress )
+qboolean NetSplit_GetLong( netsplit_t *ns, netadr_t *from, byte *data, size_t *length, int decompress )
 {
 	netsplit_packet_t *packet = (netsplit_packet_t*)data;
 	netsplit_chain_packet_t * p;
@@ -181,7 +181,9 @@ qboolean NetSplit_GetLong( netsplit_t *ns, netadr_t *from, byte *data, size_t *l
 
 		ns->total_received += len;
 
-		if( decompress )
+		if( decompress == NET_COMPRESS_STATIC )
+			Huff_DecompressDataStatic( p->data, &len );
+		else if( decompress )
 			Huff_DecompressData( p->data, &len );
 
 		ns->total_received_uncompressed += len;
@@ -205,12 +207,14 @@ NetSplit_SendLong
 Send parts that are less or equal maxpacket
 ======================
 */
-void NetSplit_SendLong( netsrc_t sock, size_t length, void *data, netadr_t to, uint32_t maxpacket, uint32_t id, qboolean compress )
+void NetSplit_SendLong( netsrc_t sock, size_t length, void *data, netadr_t to, uint32_t maxpacket, uint32_t id, int compress )
 {
 	netsplit_packet_t packet = {0};
 	uint32_t part = maxpacket - NETSPLIT_HEADER_SIZE;
 
-	if( compress )
+	if( compress == NET_COMPRESS_STATIC )
+		Huff_CompressDataStatic( data, &length );
+	else if( compress )
 		Huff_CompressData( data, &length );
 
 	packet.signature = LittleLong(0xFFFFFFFE);
@@ -263,6 +267,9 @@ void Netchan_Init( void )
 
 	Huff_Init ();	// initialize huffman compression
 	BF_InitMasks ();	// initialize bit-masks
+
+	Cmd_AddCommand( "net_bitbench", BF_Bench_f, "benchmark network bit buffer io" );
+	Cmd_AddCommand( "net_huffman", Huff_Bench_f, "capture packets to train and benchmark huffman compression" );
 }
 
 void Netchan_Shutdown( void )
@@ -303,7 +310,7 @@ void Netchan_Setup( netsrc_t sock, netchan_t *chan, netadr_t adr, int qport )
 	chan->incoming_sequence = 0;
 	chan->outgoing_sequence = 1;
 	chan->rate = DEFAULT_RATE;
-	chan->compress = false;	// work but low efficiency
+	chan->compress = NET_COMPRESS_NONE;	// negotiated on connect
 	chan->qport = qport;
 
 	BF_Init( &chan->message, "NetData", chan->message_buf, sizeof( chan->message_buf ));
@@ -1560,7 +1567,9 @@ void Netchan_TransmitBits( netchan_t *chan, int length, byte *data )
 	Netchan_UpdateFlow( chan );
 
 	size1 = BF_GetNumBytesWritten( &send );
-	if( chan->compress ) Huff_CompressPacket( &send, hdr_size );
+	Huff_RecordPacket( BF_GetData( &send ) + hdr_size, size1 - hdr_size );
+	if( chan->compress == NET_COMPRESS_STATIC ) Huff_CompressPacketStatic( &send, hdr_size );
+	else if( chan->compress ) Huff_CompressPacket( &send, hdr_size );
 	size2 = BF_GetNumBytesWritten( &send );
 
 	chan->total_sended += size2;
@@ -1765,7 +1774,8 @@ qboolean Netchan_Process( netchan_t *chan, sizebuf_t *msg )
 	hdr_size = BF_GetNumBytesRead( msg );
 
 	size1 = BF_GetMaxBytes( msg );
-	if( chan->compress ) Huff_DecompressPacket( msg, hdr_size );
+	if( chan->compress == NET_COMPRESS_STATIC ) Huff_DecompressPacketStatic( msg, hdr_size );
+	else if( chan->compress ) Huff_DecompressPacket( msg, hdr_size );
 	size2 = BF_GetMaxBytes( msg );
 
 	chan->total_received += size1;
@@ -26,6 +26,20 @@ GNU General Public License for more details.
 #define DELTA_PATH		"delta.lst"
 
 static qboolean		delta_init = false;
+static void		*delta_encodelock = NULL;	// set while encoding runs on several threads
+static qboolean		delta_bytediff = true;	// delta_bench turns it off to compare
+static delta_info_t		*dt_entity, *dt_player, *dt_custom;	// resolved before encoding jobs can run
+
+#define DELTA_MAX_FIELDS	128	// enough for any table
+#define DELTA_MASK_WORDS	( DELTA_MAX_FIELDS / 32 )
+#define DELTA_MAX_BLOCKS	64	// compare structs up to 1kb with Delta_DiffBytes
+
+#if defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+#include <emmintrin.h>
+#define XASH_DELTA_SSE2
+#endif
+
+static qboolean Delta_CompileTable( delta_info_t *dt );
  
 // list of all the struct names
 static const delta_field_t cmd_fields[] =
@@ -387,6 +401,70 @@ void Delta_CustomEncode( delta_info_t *dt, const void *from, const void *to )
 	}
 }
 
+/*
+=====================
+Delta_SetEncodeLock
+
+custom encoders change the table fields in place, so
+when entities are encoded from several threads every
+thread takes own copy of the fields under this lock
+=====================
+*/
+void Delta_SetEncodeLock( void *mutex )
+{
+	int	i, j;
+
+	// workers can't compile tables
+	if( mutex )
+	{
+		for( i = 0; i < NUM_FIELDS( dt_info ); i++ )
+		{
+			if( dt_info[i].bInitialized )
+				Delta_CompileTable( &dt_info[i] );
+		}
+	}
+
+	delta_encodelock = mutex;
+
+	if( !mutex ) return;
+
+	// tables without encoder are not touched while lock is set
+	for( i = 0; i < NUM_FIELDS( dt_info ); i++ )
+	{
+		if( !dt_info[i].pFields || dt_info[i].userCallback )
+			continue;
+
+		for( j = 0; j < dt_info[i].numFields; j++ )
+			dt_info[i].pFields[j].bInactive = false;
+	}
+}
+
+/*
+=====================
+Delta_CustomEncodeFields
+
+returns fields prepared for encoding, may be a copy
+=====================
+*/
+static delta_t *Delta_CustomEncodeFields( delta_info_t *dt, const void *from, const void *to, delta_t *copy )
+{
+	if( !delta_encodelock || dt->numFields > DELTA_MAX_FIELDS )
+	{
+		Delta_CustomEncode( dt, from, to );
+		return dt->pFields;
+	}
+
+	if( !dt->userCallback )
+		return dt->pFields;
+
+	Sys_LockMutex( delta_encodelock );
+	Delta_CustomEncode( dt, from, to );
+	Q_memcpy( copy, dt->pFields, dt->numFields * sizeof( delta_t ));
+	Sys_UnlockMutex( delta_encodelock );
+
+	return copy;
+}
+
 delta_field_t *Delta_FindFieldInfo( const delta_field_t *pInfo, const char *fieldName )
 {
 	if( !fieldName || !*fieldName )
@@ -436,6 +514,7 @@ qboolean Delta_AddField( const char *pStructName, const char *pName, int flags,
 			pField->bits = bits;
 			pField->multiplier = mul;
 			pField->post_multiplier = post_mul;
+			dt->bCompiled = false;
 			return true;
 		}
 	}
@@ -467,6 +546,7 @@ qboolean Delta_AddField( const char *pStructName, const char *pName, int flags,
 	pField->multiplier = mul;
 	pField->post_multiplier = post_mul;
 	dt->numFields++;
+	dt->bCompiled = false;
 
 	return true;
 }
@@ -693,6 +773,7 @@ void Delta_ParseTable( char **delta_script, delta_info_t *dt, const char *encode
 	pField = dt->pFields;
 	pInfo = dt->pInfo;
 	dt->numFields = 0;
+	dt->bCompiled = false;
 
 	// assume we have handled '{'
 	while(( *delta_script = COM_ParseFile( *delta_script, token )) != NULL )
@@ -777,6 +858,21 @@ void Delta_InitFields( void )
 	Delta_AddField( "event_t", "velocity[2]", DT_SIGNED | DT_FLOAT, 16, 8.0f, 1.0f );	
 }
 
+/*
+=====================
+Delta_InitEntityTables
+
+tables for Delta_EntityTable, it's called from snapshot
+jobs so they can't be looked up there
+=====================
+*/
+static void Delta_InitEntityTables( void )
+{
+	dt_entity = Delta_FindStruct( "entity_state_t" );
+	dt_player = Delta_FindStruct( "entity_state_player_t" );
+	dt_custom = Delta_FindStruct( "custom_entity_state_t" );
+}
+
 void Delta_Init( void )
 {
 	delta_info_t	*dt;
@@ -785,6 +881,7 @@ void Delta_Init( void )
 	if( delta_init ) Delta_Shutdown ();
 
 	Delta_InitFields ();	// initialize fields
+	Delta_InitEntityTables ();
 	delta_init = true;
 
 	dt = Delta_FindStruct( "movevars_t" );
@@ -835,6 +932,8 @@ void Delta_InitClient( void )
 {
 	int	i, numActive = 0;
 
+	Delta_InitEntityTables ();
+
 	// already initalized
 	if( delta_init ) return;
 
@@ -869,6 +968,22 @@ void Delta_Shutdown( void )
 			dt_info[i].pFields = NULL;
 		}
 
+		if( dt_info[i].pOps )
+		{
+			Mem_Free( dt_info[i].pOps );
+			dt_info[i].pOps = NULL;
+		}
+
+		if( dt_info[i].pBlockFields )
+		{
+			Mem_Free( dt_info[i].pBlockFields );
+			dt_info[i].pBlockFields = NULL;
+		}
+
+		dt_info[i].numBlocks = 0;
+
+		dt_info[i].bCompiled = false;
+
 		dt_info[i].bInitialized = false;
 	}
 
@@ -1308,6 +1423,836 @@ qboolean Delta_ReadField( sizebuf_t *msg, delta_t *pField, void *from, void *to,
 /*
 =============================================================================
 
+compiled tables
+
+=============================================================================
+*/
+// one field with flags resolved to a single type
+typedef struct delta_op_s
+{
+	int		type;		// DT_BYTE .. DT_STRING, 0 is never sent
+	int		offset;
+	int		size;		// bytes checked by Delta_ChangedFields
+	int		bits;
+	qboolean		bSigned;
+	float		multiplier;
+	float		post_multiplier;
+} delta_op_t;
+
+/*
+=====================
+Delta_CompileTable
+
+resolves field flags once, in the same order as
+Delta_WriteField checks them. returns false if table
+can't be compiled now
+=====================
+*/
+static qboolean Delta_CompileTable( delta_info_t *dt )
+{
+	static const int	types[] = { DT_BYTE, DT_SHORT, DT_INTEGER, DT_FLOAT, DT_ANGLE, DT_TIMEWINDOW_8, DT_TIMEWINDOW_BIG, DT_STRING };
+	delta_op_t	*op;
+	delta_t		*pField;
+	int		i, j;
+
+	if( dt->bCompiled )
+		return true;
+
+	// tables are shared by encoding threads
+	if( delta_encodelock || dt->numFields > DELTA_MAX_FIELDS || !dt->pFields )
+		return false;
+
+	if( dt->pOps ) Mem_Free( dt->pOps );
+	dt->pOps = Z_Malloc( max( dt->numFields, 1 ) * sizeof( delta_op_t ));
+
+	for( i = 0, op = dt->pOps, pField = dt->pFields; i < dt->numFields; i++, op++, pField++ )
+	{
+		for( j = 0; j < ARRAYSIZE( types ); j++ )
+		{
+			if( pField->flags & types[j] )
+				break;
+		}
+
+		op->type = ( j < ARRAYSIZE( types )) ? types[j] : 0;
+		op->offset = pField->offset;
+		op->bits = pField->bits;
+		op->bSigned = ( pField->flags & DT_SIGNED ) ? true : false;
+		op->multiplier = pField->multiplier;
+		op->post_multiplier = pField->post_multiplier;
+
+		switch( op->type )
+		{
+		case DT_BYTE:
+			op->size = 1;
+			break;
+		case DT_SHORT:
+			op->size = 2;
+			break;
+		case DT_STRING:
+			op->size = pField->size;
+			break;
+		case 0:
+			op->size = 0;
+			break;
+		default:
+			op->size = 4;
+			break;
+		}
+	}
+
+	// map 16 byte blocks of the struct to fields
+	for( i = 0, dt->extent = 0, op = dt->pOps; i < dt->numFields; i++, op++ )
+		dt->extent = max( dt->extent, op->offset + op->size );
+
+	if( dt->pBlockFields ) Mem_Free( dt->pBlockFields );
+	dt->pBlockFields = NULL;
+	dt->numBlocks = ( dt->extent + 15 ) >> 4;
+
+	if( dt->numBlocks > DELTA_MAX_BLOCKS )
+		dt->numBlocks = 0;
+
+	if( dt->numBlocks )
+	{
+		dt->pBlockFields = Z_Malloc( dt->numBlocks * DELTA_MASK_WORDS * sizeof( uint ));
+
+		for( i = 0, op = dt->pOps; i < dt->numFields; i++, op++ )
+		{
+			if( !op->size ) continue;
+
+			for( j = op->offset >> 4; j <= ( op->offset + op->size - 1 ) >> 4; j++ )
+				dt->pBlockFields[j * DELTA_MASK_WORDS + (i >> 5)] |= BIT( i & 31 );
+		}
+	}
+
+	dt->bCompiled = true;
+
+	return true;
+}
+
+/*
+=====================
+Delta_DiffBytes
+
+one bit for every byte which differs, 16 bytes per mask word.
+returns false if nothing differs
+=====================
+*/
+static qboolean Delta_DiffBytes( const byte *a, const byte *b, int size, word *bytemask )
+{
+	int	i, j, full = size >> 4;
+	uint	bits, any = 0;
+
+	for( i = 0; i < full; i++, a += 16, b += 16 )
+	{
+#ifdef XASH_DELTA_SSE2
+		__m128i	va = _mm_loadu_si128( (const __m128i *)a );
+		__m128i	vb = _mm_loadu_si128( (const __m128i *)b );
+
+		bits = ~_mm_movemask_epi8( _mm_cmpeq_epi8( va, vb )) & 0xFFFF;
+#else
+		uint64_t	wa[2], wb[2];
+
+		memcpy( wa, a, 16 );
+		memcpy( wb, b, 16 );
+		bits = 0;
+
+		if( wa[0] != wb[0] || wa[1] != wb[1] )
+		{
+			for( j = 0; j < 16; j++ )
+			{
+				if( a[j] != b[j] )
+					bits |= BIT( j );
+			}
+		}
+#endif
+		bytemask[i] = bits;
+		any |= bits;
+	}
+
+	if( size & 15 )
+	{
+		for( j = 0, bits = 0; j < ( size & 15 ); j++ )
+		{
+			if( a[j] != b[j] )
+				bits |= BIT( j );
+		}
+
+		bytemask[i] = bits;
+		any |= bits;
+	}
+
+	return any ? true : false;
+}
+
+/*
+=====================
+Delta_RangeChanged
+=====================
+*/
+static qboolean Delta_RangeChanged( const word *bytemask, int offset, int size )
+{
+	int	count, end = offset + size;
+	uint	bits;
+
+	while( offset < end )
+	{
+		count = min( end - offset, 16 - ( offset & 15 ));
+		bits = (( 1U << count ) - 1 ) << ( offset & 15 );
+
+		if( bytemask[offset >> 4] & bits )
+			return true;
+
+		offset += count;
+	}
+
+	return false;
+}
+
+/*
+=====================
+Delta_ChangedFields
+
+sets bit in mask for every field which bytes differ,
+other fields are known to compare equal.
+whole struct is compared first, then only fields in
+changed blocks are checked
+=====================
+*/
+static int Delta_ChangedFields( const delta_info_t *dt, const void *from, const void *to, uint *mask )
+{
+	word		bytemask[DELTA_MAX_BLOCKS];
+	uint		blocks[DELTA_MASK_WORDS];
+	const delta_op_t	*op = dt->pOps;
+	const byte	*a, *b;
+	int		i, j, w, count = 0;
+	qboolean		same;
+	uint		bits;
+
+	Q_memset( mask, 0, DELTA_MASK_WORDS * sizeof( uint ));
+
+	if( dt->numBlocks && delta_bytediff )
+	{
+		if( !Delta_DiffBytes( from, to, dt->extent, bytemask ))
+			return 0;
+
+		Q_memset( blocks, 0, sizeof( blocks ));
+
+		for( i = 0; i < dt->numBlocks; i++ )
+		{
+			if( !bytemask[i] ) continue;
+
+			for( w = 0; w < DELTA_MASK_WORDS; w++ )
+				blocks[w] |= dt->pBlockFields[i * DELTA_MASK_WORDS + w];
+		}
+
+		for( w = 0; w < DELTA_MASK_WORDS; w++ )
+		{
+			for( j = 0, bits = blocks[w]; bits; j++, bits >>= 1 )
+			{
+				if(!( bits & 1 )) continue;
+
+				i = ( w << 5 ) + j;
+				if( Delta_RangeChanged( bytemask, op[i].offset, op[i].size ))
+				{
+					mask[w] |= BIT( j );
+					count++;
+				}
+			}
+		}
+
+		return count;
+	}
+
+	for( i = 0; i < dt->numFields; i++, op++ )
+	{
+		a = (const byte *)from + op->offset;
+		b = (const byte *)to + op->offset;
+
+		switch( op->size )
+		{
+		case 0: same = true; break;
+		case 1: same = ( *a == *b ); break;
+		case 2: same = !memcmp( a, b, 2 ); break;
+		case 4: same = !memcmp( a, b, 4 ); break;
+		default: same = !memcmp( a, b, op->size ); break;
+		}
+
+		if( !same )
+		{
+			mask[i >> 5] |= BIT( i & 31 );
+			count++;
+		}
+	}
+
+	return count;
+}
+
+/*
+=====================
+Delta_CompareValue
+
+integer value as Delta_CompareField sees it
+=====================
+*/
+static int Delta_CompareValue( const delta_op_t *op, const byte *base )
+{
+	int	value;
+
+	switch( op->type )
+	{
+	case DT_BYTE:
+		value = op->bSigned ? *(signed char *)( base + op->offset ) : *( base + op->offset );
+		break;
+	case DT_SHORT:
+		value = op->bSigned ? *(short *)( base + op->offset ) : *(word *)( base + op->offset );
+		break;
+	default:
+		value = op->bSigned ? *(int *)( base + op->offset ) : *(uint32_t *)( base + op->offset );
+		break;
+	}
+
+	value = Delta_ClampIntegerField( value, op->bSigned, op->bits );
+	if( op->multiplier != 1.0f ) value *= op->multiplier;
+
+	return value;
+}
+
+/*
+=====================
+Delta_WriteOp
+
+same output as Delta_WriteField
+=====================
+*/
+static qboolean Delta_WriteOp( sizebuf_t *msg, const delta_op_t *op, const byte *from, const byte *to, float timebase )
+{
+	float		flValue, flTime, val_a, val_b;
+	uint32_t		iValue;
+
+	switch( op->type )
+	{
+	case DT_BYTE:
+	case DT_SHORT:
+	case DT_INTEGER:
+		if( Delta_CompareValue( op, from ) == Delta_CompareValue( op, to ))
+			break;
+
+		if( op->type == DT_BYTE ) iValue = *( to + op->offset );
+		else if( op->type == DT_SHORT ) iValue = *(word *)( to + op->offset );
+		else iValue = *(uint32_t *)( to + op->offset );
+
+		iValue = Delta_ClampIntegerField( iValue, op->bSigned, op->bits );
+		if( op->multiplier != 1.0f ) iValue *= op->multiplier;
+
+		BF_WriteOneBit( msg, 1 );
+		BF_WriteBitLong( msg, iValue, op->bits, op->bSigned );
+		return true;
+	case DT_FLOAT:
+		if( !memcmp( from + op->offset, to + op->offset, 4 ))
+			break;
+
+		memcpy( &flValue, to + op->offset, sizeof( float ));
+		iValue = (int)(flValue * op->multiplier);
+
+		BF_WriteOneBit( msg, 1 );
+		BF_WriteBitLong( msg, iValue, op->bits, op->bSigned );
+		return true;
+	case DT_ANGLE:
+		if( !memcmp( from + op->offset, to + op->offset, 4 ))
+			break;
+
+		memcpy( &flValue, to + op->offset, sizeof( float ));
+
+		BF_WriteOneBit( msg, 1 );
+		BF_WriteBitAngle( msg, flValue, op->bits );
+		return true;
+	case DT_TIMEWINDOW_8:
+		memcpy( &val_a, from + op->offset, sizeof( float ));
+		memcpy( &flValue, to + op->offset, sizeof( float ));
+		val_a = Q_rint( val_a * 100.0f ) - Q_rint( timebase * 100.0f );
+		val_b = Q_rint( flValue * 100.0f ) - Q_rint( timebase * 100.0f );
+		if( !memcmp( &val_a, &val_b, sizeof( float )))
+			break;
+
+		flTime = Q_rint( timebase * 100.0f ) - Q_rint( flValue * 100.0f );
+		iValue = (uint32_t)fabs( flTime );
+
+		BF_WriteOneBit( msg, 1 );
+		BF_WriteBitLong( msg, iValue, op->bits, op->bSigned );
+		return true;
+	case DT_TIMEWINDOW_BIG:
+		memcpy( &val_a, from + op->offset, sizeof( float ));
+		memcpy( &flValue, to + op->offset, sizeof( float ));
+		val_b = flValue;
+		if( op->multiplier != 1.0f )
+		{
+			val_a = (timebase * op->multiplier) - val_a * op->multiplier;
+			val_b = (timebase * op->multiplier) - val_b * op->multiplier;
+		}
+		else
+		{
+			val_a = timebase - val_a;
+			val_b = timebase - val_b;
+		}
+		if( !memcmp( &val_a, &val_b, sizeof( float )))
+			break;
+
+		flTime = (timebase * op->multiplier) - (flValue * op->multiplier);
+		iValue = (uint32_t)fabs( flTime );
+
+		BF_WriteOneBit( msg, 1 );
+		BF_WriteBitLong( msg, iValue, op->bits, op->bSigned );
+		return true;
+	case DT_STRING:
+		if( !Q_strcmp( (char *)from + op->offset, (char *)to + op->offset ))
+			break;
+
+		BF_WriteOneBit( msg, 1 );
+		BF_WriteString( msg, (char *)to + op->offset );
+		return true;
+	}
+
+	BF_WriteOneBit( msg, 0 );	// unchanged
+	return false;
+}
+
+/*
+=====================
+Delta_ReadOp
+
+same as Delta_ReadField
+=====================
+*/
+static void Delta_ReadOp( sizebuf_t *msg, const delta_op_t *op, const byte *from, byte *to, float timebase )
+{
+	float		flValue;
+	uint32_t		iValue;
+	const char	*pStr;
+
+	if( !BF_ReadOneBit( msg ))
+	{
+		// unchanged, copy from old state
+		if( op->type == DT_STRING )
+			Q_strncpy( (char *)to + op->offset, (char *)from + op->offset, op->size );
+		else if( op->size ) memcpy( to + op->offset, from + op->offset, op->size );
+		return;
+	}
+
+	switch( op->type )
+	{
+	case DT_BYTE:
+	case DT_SHORT:
+	case DT_INTEGER:
+		iValue = BF_ReadBitLong( msg, op->bits, op->bSigned );
+		if( op->multiplier != 1.0f ) iValue /= op->multiplier;
+
+		if( op->type == DT_BYTE ) *( to + op->offset ) = iValue;
+		else if( op->type == DT_SHORT ) *(word *)( to + op->offset ) = iValue;
+		else *(uint32_t *)( to + op->offset ) = iValue;
+		break;
+	case DT_FLOAT:
+		iValue = BF_ReadBitLong( msg, op->bits, op->bSigned );
+		flValue = (int)iValue * ( 1.0f / op->multiplier );
+		flValue = flValue * op->post_multiplier;
+		memcpy( to + op->offset, &flValue, sizeof( float ));
+		break;
+	case DT_ANGLE:
+		flValue = BF_ReadBitAngle( msg, op->bits );
+		memcpy( to + op->offset, &flValue, sizeof( float ));
+		break;
+	case DT_TIMEWINDOW_8:
+		iValue = BF_ReadBitLong( msg, op->bits, op->bSigned );
+		flValue = timebase + (float)((int)(iValue * 0.01f ));
+		memcpy( to + op->offset, &flValue, sizeof( float ));
+		break;
+	case DT_TIMEWINDOW_BIG:
+		iValue = BF_ReadBitLong( msg, op->bits, op->bSigned );
+		flValue = timebase + (float)((int)iValue) * ( 1.0f / op->multiplier );
+		memcpy( to + op->offset, &flValue, sizeof( float ));
+		break;
+	case DT_STRING:
+		pStr = BF_ReadString( msg );
+		Q_strncpy( (char *)to + op->offset, pStr, op->size );
+		break;
+	}
+}
+
+/*
+=====================
+Delta_WriteFields
+
+writes all fields of table, returns number of changed.
+pFields may be a copy made for custom encoder
+=====================
+*/
+static int Delta_WriteFields( sizebuf_t *msg, delta_info_t *dt, const delta_t *pFields, const uint *changed, const void *from, const void *to, float timebase )
+{
+	int	i, numChanges = 0;
+
+	for( i = 0; i < dt->numFields; i++ )
+	{
+		// raw bytes are same or custom encoder disabled it
+		if(!( changed[i >> 5] & BIT( i & 31 )) || pFields[i].bInactive )
+		{
+			BF_WriteOneBit( msg, 0 );
+			continue;
+		}
+
+		if( Delta_WriteOp( msg, &dt->pOps[i], from, to, timebase ))
+			numChanges++;
+	}
+
+	return numChanges;
+}
+
+/*
+=====================
+Delta_EntityTable
+
+avoids looking up tables by name for every entity,
+they are set by Delta_Init or Delta_InitClient
+=====================
+*/
+static delta_info_t *Delta_EntityTable( int entityType, qboolean player )
+{
+	if( entityType == ENTITY_BEAM )
+		return dt_custom;
+
+	return player ? dt_player : dt_entity;
+}
+
+/*
+=============================================================================
+
+delta benchmark
+
+=============================================================================
+*/
+typedef struct
+{
+	entity_state_t	from;
+	entity_state_t	to;
+	qboolean		player;
+	float		timebase;
+} deltapair_t;
+
+static struct
+{
+	deltapair_t	*pairs;
+	int		numpairs;
+	int		maxpairs;
+	qboolean		recording;
+} delta_bench;
+
+/*
+=====================
+Delta_RecordEntity
+=====================
+*/
+static void Delta_RecordEntity( const entity_state_t *from, const entity_state_t *to, qboolean player, float timebase )
+{
+	deltapair_t	*pair;
+
+	if( delta_encodelock ) Sys_LockMutex( delta_encodelock );
+
+	if( delta_bench.recording && delta_bench.numpairs < delta_bench.maxpairs )
+	{
+		pair = &delta_bench.pairs[delta_bench.numpairs++];
+		pair->from = *from;
+		pair->to = *to;
+		pair->player = player;
+		pair->timebase = timebase;
+
+		if( delta_bench.numpairs == delta_bench.maxpairs )
+		{
+			delta_bench.recording = false;
+			Msg( "delta_bench: recorded %i entity deltas\n", delta_bench.numpairs );
+		}
+	}
+
+	if( delta_encodelock ) Sys_UnlockMutex( delta_encodelock );
+}
+
+/*
+=====================
+Delta_BenchEncode
+
+encodes all recorded pairs, generic or compiled
+=====================
+*/
+static void Delta_BenchEncode( sizebuf_t *msg, qboolean compiled )
+{
+	delta_t		fields[DELTA_MAX_FIELDS];
+	uint		changed[DELTA_MASK_WORDS];
+	deltapair_t	*pair;
+	delta_info_t	*dt;
+	delta_t		*pField;
+	int		i, j;
+
+	for( i = 0, pair = delta_bench.pairs; i < delta_bench.numpairs; i++, pair++ )
+	{
+		dt = Delta_EntityTable( pair->to.entityType, pair->player );
+		if( !dt || !dt->bInitialized ) continue;
+
+		pField = Delta_CustomEncodeFields( dt, &pair->from, &pair->to, fields );
+
+		if( compiled && Delta_CompileTable( dt ))
+		{
+			Delta_ChangedFields( dt, &pair->from, &pair->to, changed );
+			Delta_WriteFields( msg, dt, pField, changed, &pair->from, &pair->to, pair->timebase );
+		}
+		else
+		{
+			for( j = 0; j < dt->numFields; j++, pField++ )
+				Delta_WriteField( msg, pField, &pair->from, &pair->to, pair->timebase );
+		}
+	}
+}
+
+/*
+=====================
+Delta_BenchDecode
+
+decodes what Delta_BenchEncode wrote
+=====================
+*/
+static void Delta_BenchDecode( sizebuf_t *msg, qboolean compiled, entity_state_t *states )
+{
+	deltapair_t	*pair;
+	delta_info_t	*dt;
+	int		i, j;
+
+	for( i = 0, pair = delta_bench.pairs; i < delta_bench.numpairs; i++, pair++ )
+	{
+		dt = Delta_EntityTable( pair->to.entityType, pair->player );
+		if( !dt || !dt->bInitialized ) continue;
+
+		states[i] = pair->from;
+
+		if( compiled && Delta_CompileTable( dt ))
+		{
+			for( j = 0; j < dt->numFields; j++ )
+				Delta_ReadOp( msg, &dt->pOps[j], (byte *)&pair->from, (byte *)&states[i], pair->timebase );
+		}
+		else
+		{
+			for( j = 0; j < dt->numFields; j++ )
+				Delta_ReadField( msg, &dt->pFields[j], &pair->from, &states[i], pair->timebase );
+		}
+	}
+}
+
+/*
+=====================
+Delta_BenchEncodeRandom
+
+writes one delta with generic fields (mode 0), compiled
+fields compared one by one (1) or by Delta_DiffBytes (2)
+=====================
+*/
+static int Delta_BenchEncodeRandom( sizebuf_t *msg, delta_info_t *dt, delta_t *fields, const void *from, const void *to, float timebase, int mode )
+{
+	uint	changed[DELTA_MASK_WORDS];
+	int	i;
+
+	if( mode == 0 )
+	{
+		for( i = 0; i < dt->numFields; i++ )
+			Delta_WriteField( msg, &fields[i], (void *)from, (void *)to, timebase );
+	}
+	else
+	{
+		delta_bytediff = ( mode == 2 );
+		Delta_ChangedFields( dt, from, to, changed );
+		Delta_WriteFields( msg, dt, fields, changed, from, to, timebase );
+		delta_bytediff = true;
+	}
+
+	return BF_GetNumBitsWritten( msg );
+}
+
+/*
+=====================
+Delta_BenchRandom
+
+encodes random entity states with all three ways,
+returns number of deltas which are not bit identical
+=====================
+*/
+static int Delta_BenchRandom( int count )
+{
+	delta_t		fields[DELTA_MAX_FIELDS];
+	entity_state_t	from, to;
+	byte		buf[3][2048];
+	int		bits[3];
+	sizebuf_t		msg;
+	delta_info_t	*dt;
+	int		i, j, k, n, mode;
+	int		mismatches = 0;
+	float		timebase;
+	delta_op_t	*op;
+
+	for( i = 0; i < count; i++ )
+	{
+		dt = Delta_EntityTable( Com_RandomLong( 0, 1 ) ? ENTITY_NORMAL : ENTITY_BEAM, Com_RandomLong( 0, 1 ));
+
+		if( !dt || !dt->bInitialized || !Delta_CompileTable( dt ))
+			continue;
+
+		// custom encoders are not called, they may not expect garbage
+		Q_memcpy( fields, dt->pFields, dt->numFields * sizeof( delta_t ));
+		for( j = 0; j < dt->numFields; j++ )
+			fields[j].bInactive = false;
+
+		for( j = 0; j < sizeof( from ); j++ )
+			((byte *)&from)[j] = Com_RandomLong( 0, 255 );
+		to = from;
+
+		// change a few fields, sometimes just a byte anywhere
+		for( n = Com_RandomLong( 0, 4 ); n > 0; n-- )
+		{
+			op = &dt->pOps[Com_RandomLong( 0, dt->numFields - 1 )];
+
+			for( k = 0; k < op->size; k++ )
+			{
+				if( Com_RandomLong( 0, 1 ))
+					((byte *)&to)[op->offset + k] = Com_RandomLong( 0, 255 );
+			}
+		}
+
+		if( !Com_RandomLong( 0, 3 ))
+			((byte *)&to)[Com_RandomLong( 0, sizeof( to ) - 1 )] ^= BIT( Com_RandomLong( 0, 7 ));
+
+		// keep strings terminated
+		for( j = 0, op = dt->pOps; j < dt->numFields; j++, op++ )
+		{
+			if( op->type == DT_STRING && op->size > 0 )
+			{
+				((byte *)&from)[op->offset + op->size - 1] = 0;
+				((byte *)&to)[op->offset + op->size - 1] = 0;
+			}
+		}
+
+		timebase = Com_RandomLong( 0, 100000 ) * 0.01f;
+
+		for( mode = 0; mode < 3; mode++ )
+		{
+			BF_Init( &msg, "DeltaBench", buf[mode], sizeof( buf[mode] ));
+			bits[mode] = Delta_BenchEncodeRandom( &msg, dt, fields, &from, &to, timebase, mode );
+		}
+
+		for( mode = 1; mode < 3; mode++ )
+		{
+			if( bits[mode] != bits[0] || memcmp( buf[mode], buf[0], BitByte( bits[0] )))
+			{
+				mismatches++;
+				break;
+			}
+		}
+	}
+
+	return mismatches;
+}
+
+/*
+=====================
+Delta_Bench_f
+
+delta_bench record <count> - store entity deltas sent to clients
+delta_bench run [passes] - encode and decode them with both paths
+delta_bench random [count] - check that encoders write same bits
+=====================
+*/
+void Delta_Bench_f( void )
+{
+	entity_state_t	*states[2];
+	double		start, times[2][2];
+	int		bytes[2], mismatches = 0;
+	int		i, pass, passes;
+	sizebuf_t		msg[2];
+	byte		*buf[2];
+	size_t		size;
+
+	if( Cmd_Argc() > 2 && !Q_stricmp( Cmd_Argv( 1 ), "record" ))
+	{
+		if( delta_bench.pairs ) Mem_Free( delta_bench.pairs );
+		delta_bench.maxpairs = bound( 1, Q_atoi( Cmd_Argv( 2 )), 65536 );
+		delta_bench.pairs = Z_Malloc( delta_bench.maxpairs * sizeof( deltapair_t ));
+		delta_bench.numpairs = 0;
+		delta_bench.recording = true;
+		Msg( "delta_bench: recording %i entity deltas\n", delta_bench.maxpairs );
+		return;
+	}
+
+	if( Cmd_Argc() > 1 && !Q_stricmp( Cmd_Argv( 1 ), "random" ))
+	{
+		passes = ( Cmd_Argc() > 2 ) ? max( Q_atoi( Cmd_Argv( 2 )), 1 ) : 10000;
+		mismatches = Delta_BenchRandom( passes );
+		Msg( "delta_bench: %i random entity deltas, %i not bit identical\n", passes, mismatches );
+		return;
+	}
+
+	if( Cmd_Argc() < 2 || Q_stricmp( Cmd_Argv( 1 ), "run" ))
+	{
+		Msg( "Usage: delta_bench record <count> | run [passes] | random [count]\n" );
+		return;
+	}
+
+	if( !delta_bench.numpairs )
+	{
+		Msg( "delta_bench: nothing recorded\n" );
+		return;
+	}
+
+	passes = ( Cmd_Argc() > 2 ) ? max( Q_atoi( Cmd_Argv( 2 )), 1 ) : 10;
+	size = delta_bench.numpairs * 512;
+
+	for( i = 0; i < 2; i++ )
+	{
+		buf[i] = Z_Malloc( size );
+		states[i] = Z_Malloc( delta_bench.numpairs * sizeof( entity_state_t ));
+		times[i][0] = times[i][1] = 0.0;
+
+		for( pass = 0; pass < passes; pass++ )
+		{
+			BF_Init( &msg[i], "DeltaBench", buf[i], size );
+			start = Sys_DoubleTime();
+			Delta_BenchEncode( &msg[i], i );
+			times[i][0] += Sys_DoubleTime() - start;
+			bytes[i] = BF_GetNumBytesWritten( &msg[i] );
+
+			BF_Init( &msg[i], "DeltaBench", buf[i], bytes[i] );
+			start = Sys_DoubleTime();
+			Delta_BenchDecode( &msg[i], i, states[i] );
+			times[i][1] += Sys_DoubleTime() - start;
+		}
+	}
+
+	// both paths must give same bits and same states
+	if( bytes[0] != bytes[1] || memcmp( buf[0], buf[1], bytes[0] ))
+		Msg( "^1delta_bench: compiled tables wrote different bits\n" );
+
+	for( i = 0; i < delta_bench.numpairs; i++ )
+	{
+		if( memcmp( &states[0][i], &states[1][i], sizeof( entity_state_t )))
+			mismatches++;
+	}
+
+	for( i = 0; i < 2; i++ )
+	{
+		Mem_Free( buf[i] );
+		Mem_Free( states[i] );
+	}
+
+	Msg( "%i entity deltas, %i bytes, %i passes\n", delta_bench.numpairs, bytes[0], passes );
+	Msg( "generic: encode %.3f ms, decode %.3f ms\n", times[0][0] * 1000.0, times[0][1] * 1000.0 );
+	Msg( "compiled: encode %.3f ms, decode %.3f ms\n", times[1][0] * 1000.0, times[1][1] * 1000.0 );
+	Msg( "decode mismatches: %i\n", mismatches );
+}
+
+/*
+=============================================================================
+
 usercmd_t communication
   
 =============================================================================
@@ -1385,6 +2330,7 @@ MSG_WriteDeltaEvent
 */
 void MSG_WriteDeltaEvent( sizebuf_t *msg, event_args_t *from, event_args_t *to )
 {
+	delta_t		fields[DELTA_MAX_FIELDS];
 	delta_t		*pField;
 	delta_info_t	*dt;
 	int		i;
@@ -1392,14 +2338,15 @@ void MSG_WriteDeltaEvent( sizebuf_t *msg, event_args_t *from, event_args_t *to )
 	dt = Delta_FindStruct( "event_t" );
 	if( !dt || !dt->bInitialized )
 	{
-		Host_Error( "MSG_WriteDeltaEvent: delta not initialized!\n" );
+		// snapshots are encoded on worker threads
+		Sys_JobError( "MSG_WriteDeltaEvent: delta not initialized!\n" );
+		return;
 	}
 
-	pField = dt->pFields;
-	ASSERT( pField );
+	ASSERT( dt->pFields );
 
 	// activate fields and call custom encode func
-	Delta_CustomEncode( dt, from, to );
+	pField = Delta_CustomEncodeFields( dt, from, to, fields );
 
 	// process fields
 	for( i = 0; i < dt->numFields; i++, pField++ )
@@ -1531,7 +2478,9 @@ void MSG_WriteClientData( sizebuf_t *msg, clientdata_t *from, clientdata_t *to,
 	dt = Delta_FindStruct( "clientdata_t" );
 	if( !dt || !dt->bInitialized )
 	{
-		Host_Error( "MSG_WriteClientData: delta not initialized!\n" );
+		// snapshots are encoded on worker threads
+		Sys_JobError( "MSG_WriteClientData: delta not initialized!\n" );
+		return;
 	}
 
 	pField = dt->pFields;
@@ -1602,7 +2551,9 @@ void MSG_WriteWeaponData( sizebuf_t *msg, weapon_data_t *from, weapon_data_t *to
 	dt = Delta_FindStruct( "weapon_data_t" );
 	if( !dt || !dt->bInitialized )
 	{
-		Host_Error( "MSG_WriteWeaponData: delta not initialized!\n" );
+		// snapshots are encoded on worker threads
+		Sys_JobError( "MSG_WriteWeaponData: delta not initialized!\n" );
+		return;
 	}
 
 	pField = dt->pFields;
@@ -1678,10 +2629,13 @@ identical, under the assumption that the in-order delta code will catch it.
 */
 void MSG_WriteDeltaEntity( entity_state_t *from, entity_state_t *to, sizebuf_t *msg, qboolean force, qboolean player, float timebase ) 
 {
+	delta_t		fields[DELTA_MAX_FIELDS];
+	uint		changed[DELTA_MASK_WORDS];
 	delta_info_t	*dt = NULL;
 	delta_t		*pField;
 	int		i, startBit;
 	int		numChanges = 0;
+	qboolean		compiled;
 
 	if( to == NULL )
 	{
@@ -1711,6 +2665,27 @@ void MSG_WriteDeltaEntity( entity_state_t *from, entity_state_t *to, sizebuf_t *
 		return;
 	}
 
+	if( to->entityType == ENTITY_NORMAL || to->entityType == ENTITY_BEAM )
+		dt = Delta_EntityTable( to->entityType, player );
+
+	if( !dt || !dt->bInitialized )
+	{
+		// snapshots are encoded on worker threads
+		Sys_JobError( "MSG_WriteDeltaEntity: delta not initialized!\n" );
+		return;
+	}
+
+	ASSERT( dt->pFields );
+
+	if( delta_bench.recording )
+		Delta_RecordEntity( from, to, player, timebase );
+
+	compiled = Delta_CompileTable( dt );
+
+	// nothing differs, message would be killed below anyway
+	if( compiled && !force && !Delta_ChangedFields( dt, from, to, changed ))
+		return;
+
 	BF_WriteWord( msg, to->number );
 	BF_WriteUBitLong( msg, 0, 2 ); // alive
 
@@ -1721,38 +2696,22 @@ void MSG_WriteDeltaEntity( entity_state_t *from, entity_state_t *to, sizebuf_t *
 	}
 	else BF_WriteOneBit( msg, 0 ); 
 
-	if( to->entityType == ENTITY_NORMAL )
-	{
-		if( player )
-		{
-			dt = Delta_FindStruct( "entity_state_player_t" );
-		}
-		else
-		{
-			dt = Delta_FindStruct( "entity_state_t" );
-		}
-	}
-	else if( to->entityType == ENTITY_BEAM )
-	{
-		dt = Delta_FindStruct( "custom_entity_state_t" );
-	}
+	// activate fields and call custom encode func
+	pField = Delta_CustomEncodeFields( dt, from, to, fields );
 
-	if( !dt || !dt->bInitialized )
+	if( compiled )
 	{
-		Host_Error( "MSG_WriteDeltaEntity: delta not initialized!\n" );
+		if( force ) Delta_ChangedFields( dt, from, to, changed );
+		numChanges = Delta_WriteFields( msg, dt, pField, changed, from, to, timebase );
 	}
-
-	pField = dt->pFields;
-	ASSERT( pField );
-
-	// activate fields and call custom encode func
-	Delta_CustomEncode( dt, from, to );
-
-	// process fields
-	for( i = 0; i < dt->numFields; i++, pField++ )
+	else
 	{
-		if( Delta_WriteField( msg, pField, from, to, timebase ))
-			numChanges++;
+		// process fields
+		for( i = 0; i < dt->numFields; i++, pField++ )
+		{
+			if( Delta_WriteField( msg, pField, from, to, timebase ))
+				numChanges++;
+		}
 	}
 
 	// if we have no changes - kill the message
@@ -1815,7 +2774,7 @@ qboolean MSG_ReadDeltaEntity( sizebuf_t *msg, entity_state_t *from, entity_state
 
 	if( to->entityType == ENTITY_BEAM )
 	{
-		dt = Delta_FindStruct( "custom_entity_state_t" );
+		dt = Delta_EntityTable( ENTITY_BEAM, false );
 	}
 	else //  ENTITY_NORMAL or other (try predict type)
 	{
@@ -1824,14 +2783,7 @@ qboolean MSG_ReadDeltaEntity( sizebuf_t *msg, entity_state_t *from, entity_state
 		 * but i don't know how to do it better.*/
 		if( to->entityType != ENTITY_NORMAL )
 			MsgDev( D_NOTE, "MSG_ReadDeltaEntity: broken delta: entityType = %d\n", to->entityType );
-		if( player )
-		{
-			dt = Delta_FindStruct( "entity_state_player_t" );
-		}
-		else
-		{
-			dt = Delta_FindStruct( "entity_state_t" );
-		}
+		dt = Delta_EntityTable( ENTITY_NORMAL, player );
 	}
 
 	if( !(dt && dt->bInitialized) ) // Broken  delta?
@@ -1842,10 +2794,18 @@ qboolean MSG_ReadDeltaEntity( sizebuf_t *msg, entity_state_t *from, entity_state
 	pField = dt->pFields;
 	ASSERT( pField );
 
-	// process fields
-	for( i = 0; i < dt->numFields; i++, pField++ )
+	if( Delta_CompileTable( dt ))
 	{
-		Delta_ReadField( msg, pField, from, to, timebase );
+		for( i = 0; i < dt->numFields; i++ )
+			Delta_ReadOp( msg, &dt->pOps[i], (byte *)from, (byte *)to, timebase );
+	}
+	else
+	{
+		// process fields
+		for( i = 0; i < dt->numFields; i++, pField++ )
+		{
+			Delta_ReadField( msg, pField, from, to, timebase );
+		}
 	}
 #endif
 	// message parsed
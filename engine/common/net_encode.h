@@ -84,6 +84,13 @@ typedef struct
 	char		funcName[32];
 	pfnDeltaEncode	userCallback;
 	qboolean		bInitialized;
+
+	// flat copy of pFields made by Delta_CompileTable
+	struct delta_op_s	*pOps;
+	int		extent;		// end of the last field in bytes
+	int		numBlocks;	// 16 byte blocks compared at once, 0 - per field
+	uint		*pBlockFields;	// fields touching each block
+	qboolean		bCompiled;
 } delta_info_t;
 
 //
@@ -102,6 +109,8 @@ void Delta_SetField( delta_t *pFields, const char *fieldname );
 void Delta_UnsetField( delta_t *pFields, const char *fieldname );
 void Delta_SetFieldByIndex( struct delta_s *pFields, int fieldNumber );
 void Delta_UnsetFieldByIndex( struct delta_s *pFields, int fieldNumber );
+void Delta_SetEncodeLock( void *mutex );
+void Delta_Bench_f( void );
 
 // send table over network
 void Delta_WriteTableField( sizebuf_t *msg, int tableIndex, const delta_t *pField );
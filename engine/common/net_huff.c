@@ -15,6 +15,7 @@ GNU General Public License for more details.
 
 #include "common.h"
 #include "netchan.h"
+#include "mathlib.h"
 
 #define VALUE(a)			((int   )(size_t)(a))
 #define NODE(a)			((void *)(a))
@@ -67,8 +68,32 @@ static const int huff_tree[256] =
 0x003F5, 0x00325, 0x003F0, 0x0031C, 0x003E4, 0x00421, 0x02CC1, 0x034C0
 };
 
-// static Huffman tree
-static tree_t	huffTree;
+#define HUFF_MAXBITS		12	// longest static code
+#define HUFF_HEADER_SIZE		3	// length << 1 | stored, big endian
+#define HUFF_MAX_CAPTURE		( 8 * 1024 * 1024 )
+
+// canonical code, bits are sent lsb first like MSG_* does
+typedef struct
+{
+	word		codes[256];		// bit reversed
+	byte		lengths[256];
+	word		decode[1<<HUFF_MAXBITS];	// byte | length << 8
+} huffcode_t;
+
+// static code built from huff_tree counts
+static huffcode_t	huffStatic;
+
+// net_huffman record
+static struct
+{
+	qboolean		recording;
+	int		counts[256];
+	byte		*data;
+	int		size;
+	int		*lengths;
+	int		numpackets;
+	int		maxpackets;
+} huffCapture;
 
 // received from MSG_* code
 static int	huffBitPos;
@@ -685,23 +710,588 @@ void Huff_DecompressData( byte *data, size_t *length )
 	Q_memcpy( data, buffer, outLen );
 }
 
+/*
+=======================================================================================
+
+  STATIC HUFFMAN CODE
+
+  Code never changes, so there are no tree updates and every
+  byte is decoded with one table lookup
+=======================================================================================
+*/
 /*
 ============
-Huff_Init
+Huff_BuildLengths
+
+code lengths for given counts, counts are scaled
+down until no code is longer than HUFF_MAXBITS
 ============
 */
-void Huff_Init( void )
+static void Huff_BuildLengths( const int *counts, byte *lengths )
 {
-	int	i, j;
+	int	weight[511], parent[511];
+	int	i, j, a, b, len, maxlen;
+	int	numnodes, shift;
 
-	if( huffInit ) return;
+	for( shift = 0; shift < 32; shift++ )
+	{
+		// every byte must get a code
+		for( i = 0; i < 256; i++ )
+			weight[i] = ( counts[i] >> shift ) + 1;
+
+		for( i = 0; i < 511; i++ )
+			parent[i] = -1;
+
+		// join two lightest roots until one is left
+		for( numnodes = 256; numnodes < 511; numnodes++ )
+		{
+			for( j = 0, a = b = -1; j < numnodes; j++ )
+			{
+				if( parent[j] != -1 ) continue;
+
+				if( a == -1 || weight[j] < weight[a] )
+				{
+					b = a;
+					a = j;
+				}
+				else if( b == -1 || weight[j] < weight[b] )
+					b = j;
+			}
+
+			weight[numnodes] = weight[a] + weight[b];
+			parent[a] = parent[b] = numnodes;
+		}
+
+		for( i = maxlen = 0; i < 256; i++ )
+		{
+			for( j = i, len = 0; parent[j] != -1; j = parent[j] )
+				len++;
+			lengths[i] = len;
+			maxlen = max( maxlen, len );
+		}
+
+		if( maxlen <= HUFF_MAXBITS )
+			return;
+	}
+}
 
-	// build empty tree
-	Huff_PrepareTree( huffTree );
+/*
+============
+Huff_BuildCode
+============
+*/
+static void Huff_BuildCode( huffcode_t *code, const int *counts )
+{
+	int	numcodes[HUFF_MAXBITS+1];
+	int	nextcode[HUFF_MAXBITS+1];
+	int	i, j, len, rev;
 
-	// add all pre-defined byte references
+	Huff_BuildLengths( counts, code->lengths );
+
+	Q_memset( numcodes, 0, sizeof( numcodes ));
 	for( i = 0; i < 256; i++ )
-		for( j = 0; j < huff_tree[i]; j++ )
-			Huff_AddReference( huffTree, i );
+		numcodes[code->lengths[i]]++;
+
+	nextcode[0] = 0;
+	for( len = 1; len <= HUFF_MAXBITS; len++ )
+		nextcode[len] = ( nextcode[len-1] + numcodes[len-1] ) << 1;
+
+	for( i = 0; i < 256; i++ )
+	{
+		len = code->lengths[i];
+
+		// first bit of canonical code goes to lsb
+		for( j = 0, rev = 0; j < len; j++ )
+			rev |= (( nextcode[len] >> j ) & 1 ) << ( len - 1 - j );
+		nextcode[len]++;
+
+		code->codes[i] = rev;
+
+		// every index with this code in low bits decodes to the byte
+		for( j = rev; j < ( 1 << HUFF_MAXBITS ); j += ( 1 << len ))
+			code->decode[j] = i | ( len << 8 );
+	}
+}
+
+/*
+============
+Huff_EncodeStatic
+
+returns -1 if output doesn't fit in maxOut
+============
+*/
+static int Huff_EncodeStatic( const huffcode_t *code, const byte *in, int inLen, byte *out, int maxOut )
+{
+	uint64_t	bits = 0;
+	int	numbits = 0;
+	int	i, outLen = 0;
+
+	for( i = 0; i < inLen; i++ )
+	{
+		bits |= (uint64_t)code->codes[in[i]] << numbits;
+		numbits += code->lengths[in[i]];
+
+		if( numbits < 32 ) continue;
+
+		if( outLen + 4 > maxOut )
+			return -1;
+
+		out[outLen+0] = (byte)( bits );
+		out[outLen+1] = (byte)( bits >> 8 );
+		out[outLen+2] = (byte)( bits >> 16 );
+		out[outLen+3] = (byte)( bits >> 24 );
+		outLen += 4;
+		bits >>= 32;
+		numbits -= 32;
+	}
+
+	for( ; numbits > 0; numbits -= 8, bits >>= 8 )
+	{
+		if( outLen >= maxOut )
+			return -1;
+		out[outLen++] = (byte)bits;
+	}
+
+	return outLen;
+}
+
+/*
+============
+Huff_DecodeStatic
+
+returns false if input ends too early,
+rest of output is zeroed then
+============
+*/
+static qboolean Huff_DecodeStatic( const huffcode_t *code, const byte *in, int inLen, byte *out, int outLen )
+{
+	uint64_t	bits = 0;
+	int	numbits = 0;
+	int	i, len, inPos = 0;
+	word	entry;
+
+	for( i = 0; i < outLen; i++ )
+	{
+		if( numbits < HUFF_MAXBITS )
+		{
+			for( ; numbits <= 56 && inPos < inLen; numbits += 8 )
+				bits |= (uint64_t)in[inPos++] << numbits;
+		}
+
+		entry = code->decode[bits & (( 1 << HUFF_MAXBITS ) - 1 )];
+		len = entry >> 8;
+
+		if( len > numbits )
+		{
+			Q_memset( out + i, 0, outLen - i );
+			return false;
+		}
+
+		out[i] = (byte)entry;
+		bits >>= len;
+		numbits -= len;
+	}
+
+	return true;
+}
+
+/*
+============
+Huff_CompressStatic
+
+writes header and the code or the data itself when
+code is not shorter, returns -1 if nothing fits
+============
+*/
+static int Huff_CompressStatic( const huffcode_t *code, const byte *in, int inLen, byte *out, int maxOut )
+{
+	qboolean	stored = false;
+	int	len, value;
+
+	if( maxOut <= HUFF_HEADER_SIZE )
+		return -1;
+
+	len = Huff_EncodeStatic( code, in, inLen, out + HUFF_HEADER_SIZE, min( maxOut - HUFF_HEADER_SIZE, inLen - 1 ));
+
+	if( len < 0 )
+	{
+		if( inLen > maxOut - HUFF_HEADER_SIZE )
+			return -1;
+
+		Q_memcpy( out + HUFF_HEADER_SIZE, in, inLen );
+		len = inLen;
+		stored = true;
+	}
+
+	value = ( inLen << 1 ) | stored;
+	out[0] = ( value >> 16 ) & 0xFF;
+	out[1] = ( value >> 8 ) & 0xFF;
+	out[2] = value & 0xFF;
+
+	return len + HUFF_HEADER_SIZE;
+}
+
+/*
+============
+Huff_DecompressStatic
+
+returns decompressed length
+============
+*/
+static int Huff_DecompressStatic( const huffcode_t *code, const byte *in, int inLen, byte *out, int maxOut )
+{
+	int	value, outLen;
+
+	if( inLen < HUFF_HEADER_SIZE )
+		return 0;
+
+	value = ( in[0] << 16 ) | ( in[1] << 8 ) | in[2];
+	outLen = value >> 1;
+	in += HUFF_HEADER_SIZE;
+	inLen -= HUFF_HEADER_SIZE;
+
+	if( outLen > maxOut )
+	{
+		MsgDev( D_ERROR, "Huff_DecompressStatic: overflow\n" );
+		outLen = maxOut;
+	}
+
+	if( value & 1 )
+	{
+		outLen = min( outLen, inLen );
+		Q_memcpy( out, in, outLen );
+	}
+	else if( !Huff_DecodeStatic( code, in, inLen, out, outLen ))
+		MsgDev( D_ERROR, "Huff_DecompressStatic: truncated data\n" );
+
+	return outLen;
+}
+
+/*
+============
+Huff_CompressPacketStatic
+
+Compress message using static Huffman code,
+beginning from specified offset
+============
+*/
+void Huff_CompressPacketStatic( sizebuf_t *msg, int offset )
+{
+	byte	buffer[NET_MAX_PAYLOAD];
+	byte	*data;
+	int	outLen;
+	int	inLen;
+
+	data = BF_GetData( msg ) + offset;
+	inLen = BF_GetNumBytesWritten( msg ) - offset;
+	if( inLen <= 0 || inLen >= NET_MAX_PAYLOAD )
+		return;
+
+	outLen = Huff_CompressStatic( &huffStatic, data, inLen, buffer, min( NET_MAX_PAYLOAD, BF_GetMaxBytes( msg ) - offset ));
+
+	if( outLen < 0 )
+	{
+		MsgDev( D_ERROR, "Huff_CompressPacketStatic: overflow\n" );
+		outLen = 0;
+	}
+
+	msg->iCurBit = (offset + outLen) << 3;
+	Q_memcpy( data, buffer, outLen );
+}
+
+/*
+============
+Huff_DecompressPacketStatic
+============
+*/
+void Huff_DecompressPacketStatic( sizebuf_t *msg, int offset )
+{
+	byte	buffer[NET_MAX_PAYLOAD];
+	byte	*data;
+	int	outLen;
+	int	inLen;
+
+	data = BF_GetData( msg ) + offset;
+	inLen = BF_GetMaxBytes( msg ) - offset;
+	if( inLen <= 0 ) return;
+
+	outLen = Huff_DecompressStatic( &huffStatic, data, inLen, buffer, NET_MAX_PAYLOAD - offset );
+
+	msg->nDataBits = ( offset + outLen ) << 3;
+	Q_memcpy( data, buffer, outLen );
+}
+
+/*
+============
+Huff_CompressDataStatic
+============
+*/
+void Huff_CompressDataStatic( byte *data, size_t *length )
+{
+	byte	buffer[NET_MAX_PAYLOAD];
+	int	outLen;
+
+	outLen = Huff_CompressStatic( &huffStatic, data, *length, buffer, sizeof( buffer ));
+
+	if( *length <= 0 || outLen < 0 )
+	{
+		MsgDev( D_ERROR, "Huff_CompressDataStatic: overflow\n");
+		return;
+	}
+
+	*length = outLen;
+	Q_memcpy( data, buffer, outLen );
+}
+
+/*
+============
+Huff_DecompressDataStatic
+============
+*/
+void Huff_DecompressDataStatic( byte *data, size_t *length )
+{
+	byte	buffer[NET_MAX_PAYLOAD];
+	int	outLen;
+
+	if( *length <= 0 ) return;
+
+	outLen = Huff_DecompressStatic( &huffStatic, data, *length, buffer, sizeof( buffer ));
+
+	*length = outLen;
+	Q_memcpy( data, buffer, outLen );
+}
+
+/*
+=======================================================================================
+
+  TRAINING AND BENCHMARK
+
+=======================================================================================
+*/
+/*
+============
+Huff_RecordPacket
+
+counts bytes of outgoing payload
+while net_huffman is recording
+============
+*/
+void Huff_RecordPacket( const byte *data, int length )
+{
+	int	i;
+
+	if( !huffCapture.recording || length <= 0 )
+		return;
+
+	for( i = 0; i < length; i++ )
+		huffCapture.counts[data[i]]++;
+
+	if( huffCapture.numpackets >= huffCapture.maxpackets || huffCapture.size + length > HUFF_MAX_CAPTURE )
+	{
+		huffCapture.recording = false;
+		Msg( "net_huffman: captured %i packets, %s\n", huffCapture.numpackets, Q_memprint( huffCapture.size ));
+		return;
+	}
+
+	Q_memcpy( huffCapture.data + huffCapture.size, data, length );
+	huffCapture.lengths[huffCapture.numpackets++] = length;
+	huffCapture.size += length;
+}
+
+/*
+============
+Huff_FreeCapture
+============
+*/
+static void Huff_FreeCapture( void )
+{
+	if( huffCapture.data ) Mem_Free( huffCapture.data );
+	if( huffCapture.lengths ) Mem_Free( huffCapture.lengths );
+
+	Q_memset( &huffCapture, 0, sizeof( huffCapture ));
+}
+
+/*
+============
+Huff_DumpCounts
+
+writes counts of captured bytes in format of huff_tree
+============
+*/
+static void Huff_DumpCounts( const char *filename )
+{
+	file_t	*f;
+	int	i;
+
+	if( !huffCapture.size )
+	{
+		Msg( "net_huffman: nothing recorded\n" );
+		return;
+	}
+
+	f = FS_Open( filename, "w", true );
+
+	if( !f )
+	{
+		Msg( "net_huffman: couldn't write %s\n", filename );
+		return;
+	}
+
+	FS_Printf( f, "// %i packets, %i bytes\n", huffCapture.numpackets, huffCapture.size );
+	FS_Printf( f, "static const int huff_tree[256] =\n{\n" );
+
+	for( i = 0; i < 256; i++ )
+		FS_Printf( f, "0x%05X,%s", huffCapture.counts[i], (( i & 7 ) == 7 ) ? "\n" : " " );
+
+	FS_Printf( f, "};\n" );
+	FS_Close( f );
+
+	Msg( "net_huffman: counts of %i bytes written to %s\n", huffCapture.size, filename );
+}
+
+/*
+============
+Huff_BenchCodec
+
+mode 0 is adaptive tree, otherwise static code is used.
+returns number of packets that don't survive round trip
+============
+*/
+static int Huff_BenchCodec( const huffcode_t *code, byte *buffer, byte *out, int passes, int *outSize, double *times )
+{
+	int	i, pass, offset, errors = 0;
+	size_t	length;
+	double	start;
+
+	*outSize = 0;
+	times[0] = times[1] = 0.0;
+
+	for( pass = 0; pass < passes; pass++ )
+	{
+		for( i = offset = 0; i < huffCapture.numpackets; offset += huffCapture.lengths[i], i++ )
+		{
+			length = huffCapture.lengths[i];
+
+			start = Sys_DoubleTime();
+			if( code ) length = Huff_CompressStatic( code, huffCapture.data + offset, length, buffer, NET_MAX_PAYLOAD );
+			else
+			{
+				Q_memcpy( buffer, huffCapture.data + offset, length );
+				Huff_CompressData( buffer, &length );
+			}
+			times[0] += Sys_DoubleTime() - start;
+
+			if( !pass ) *outSize += length;
+
+			start = Sys_DoubleTime();
+			if( code ) length = Huff_DecompressStatic( code, buffer, length, out, NET_MAX_PAYLOAD );
+			else
+			{
+				Q_memcpy( out, buffer, length );
+				Huff_DecompressData( out, &length );
+			}
+			times[1] += Sys_DoubleTime() - start;
+
+			if( length != huffCapture.lengths[i] || memcmp( out, huffCapture.data + offset, length ))
+				errors++;
+		}
+	}
+
+	return errors;
+}
+
+/*
+============
+Huff_Bench_f
+
+net_huffman record [count] - capture outgoing packets
+net_huffman stop - stop capture
+net_huffman dump <file> - write byte counts for huff_tree
+net_huffman bench [passes] - compress captured packets
+============
+*/
+void Huff_Bench_f( void )
+{
+	const char	*names[3] = { "adaptive", "static", "trained" };
+	huffcode_t	*trained;
+	byte		*buffer, *out;
+	int		outSize, errors;
+	int		i, passes;
+	double		times[2];
+
+	if( Cmd_Argc() > 1 && !Q_stricmp( Cmd_Argv( 1 ), "record" ))
+	{
+		Huff_FreeCapture();
+		huffCapture.maxpackets = ( Cmd_Argc() > 2 ) ? bound( 1, Q_atoi( Cmd_Argv( 2 )), 65536 ) : 4096;
+		huffCapture.lengths = Z_Malloc( huffCapture.maxpackets * sizeof( int ));
+		huffCapture.data = Z_Malloc( HUFF_MAX_CAPTURE );
+		huffCapture.recording = true;
+		Msg( "net_huffman: recording %i packets\n", huffCapture.maxpackets );
+		return;
+	}
+
+	if( Cmd_Argc() > 1 && !Q_stricmp( Cmd_Argv( 1 ), "stop" ))
+	{
+		huffCapture.recording = false;
+		Msg( "net_huffman: captured %i packets, %s\n", huffCapture.numpackets, Q_memprint( huffCapture.size ));
+		return;
+	}
+
+	if( Cmd_Argc() > 2 && !Q_stricmp( Cmd_Argv( 1 ), "dump" ))
+	{
+		Huff_DumpCounts( Cmd_Argv( 2 ));
+		return;
+	}
+
+	if( Cmd_Argc() < 2 || Q_stricmp( Cmd_Argv( 1 ), "bench" ))
+	{
+		Msg( "Usage: net_huffman record [count] | stop | dump <file> | bench [passes]\n" );
+		return;
+	}
+
+	if( !huffCapture.numpackets )
+	{
+		Msg( "net_huffman: nothing recorded\n" );
+		return;
+	}
+
+	passes = ( Cmd_Argc() > 2 ) ? max( Q_atoi( Cmd_Argv( 2 )), 1 ) : 10;
+
+	// shows what a table trained on this capture would give
+	trained = Z_Malloc( sizeof( huffcode_t ));
+	Huff_BuildCode( trained, huffCapture.counts );
+
+	buffer = Z_Malloc( NET_MAX_MESSAGE );
+	out = Z_Malloc( NET_MAX_MESSAGE );
+
+	Msg( "%i packets, %i bytes, %i passes\n", huffCapture.numpackets, huffCapture.size, passes );
+
+	for( i = 0; i < 3; i++ )
+	{
+		errors = Huff_BenchCodec( i == 0 ? NULL : i == 1 ? &huffStatic : trained, buffer, out, passes, &outSize, times );
+
+		times[0] = max( times[0], 0.000001 );
+		times[1] = max( times[1], 0.000001 );
+
+		Msg( "%s: %i bytes (%.1f%%), compress %.1f MB/s, decompress %.1f MB/s%s\n", names[i], outSize,
+			outSize * 100.0 / huffCapture.size, (double)huffCapture.size * passes / times[0] * ( 1.0 / ( 1024 * 1024 )),
+			(double)huffCapture.size * passes / times[1] * ( 1.0 / ( 1024 * 1024 )), errors ? va( ", ^1%i broken", errors ) : "" );
+	}
+
+	Mem_Free( trained );
+	Mem_Free( buffer );
+	Mem_Free( out );
+}
+
+/*
+============
+Huff_Init
+============
+*/
+void Huff_Init( void )
+{
+	if( huffInit ) return;
+
+	Huff_BuildCode( &huffStatic, huff_tree );
 	huffInit = true;
 }
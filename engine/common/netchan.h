@@ -83,6 +83,12 @@ NET
 #define NET_EXT_HUFF		(1U<<0)
 #define NET_EXT_SPLIT		(1U<<1)
 #define NET_EXT_SPLITHUFF	(1U<<2)
+#define NET_EXT_HUFFSTATIC	(1U<<3)	// static code for negotiated compression
+
+// netchan compression
+#define NET_COMPRESS_NONE	0
+#define NET_COMPRESS_HUFF	1	// adaptive huffman tree
+#define NET_COMPRESS_STATIC	2	// static huffman code
 
 // message data
 typedef struct
@@ -167,7 +173,7 @@ typedef struct netchan_s
 	netadr_t		remote_address;	// address this channel is talking to.  
 	int		qport;		// qport value to write when transmitting
 	
-	qboolean		compress;		// enable huffman compression
+	int		compress;		// NET_COMPRESS_*
 			
 	double		last_received;	// for timeouts
 	double		last_sent;	// for retransmits		
@@ -226,7 +232,7 @@ typedef struct netchan_s
 	size_t		total_received;
 	size_t		total_received_uncompressed;
 	qboolean	split;
-	qboolean	splitcompress;
+	int	splitcompress;		// NET_COMPRESS_*
 	unsigned int	maxpacket;
 	unsigned int	splitid;
 	netsplit_t netsplit;
@@ -261,7 +267,7 @@ void Netchan_Clear( netchan_t *chan );
 void Netchan_ReportFlow( netchan_t *chan );
 
 // packet splitting
-qboolean NetSplit_GetLong(netsplit_t *ns, netadr_t *from, byte *data, size_t *length , qboolean decompress );
+qboolean NetSplit_GetLong(netsplit_t *ns, netadr_t *from, byte *data, size_t *length , int decompress );
 
 // huffman compression
 void Huff_Init( void );
@@ -269,5 +275,11 @@ void Huff_CompressPacket( sizebuf_t *msg, int offset );
 void Huff_DecompressPacket( sizebuf_t *msg, int offset );
 void Huff_CompressData( byte *data, size_t *length );
 void Huff_DecompressData( byte *data, size_t *length );
+void Huff_CompressPacketStatic( sizebuf_t *msg, int offset );
+void Huff_DecompressPacketStatic( sizebuf_t *msg, int offset );
+void Huff_CompressDataStatic( byte *data, size_t *length );
+void Huff_DecompressDataStatic( byte *data, size_t *length );
+void Huff_RecordPacket( const byte *data, int length );
+void Huff_Bench_f( void );
 
 #endif//NET_MSG_H
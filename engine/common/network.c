@@ -13,6 +13,11 @@ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
 GNU General Public License for more details.
 */
 
+#if defined( __linux__ ) && !defined( __ANDROID__ )
+#define _GNU_SOURCE // recvmmsg, sendmmsg
+#define HAVE_MMSG
+#endif
+
 #ifdef _WIN32
 // Winsock2
 #include <ws2tcpip.h>
@@ -113,6 +118,49 @@ typedef struct packetlag_s
 	struct packetlag_s	*prev;
 } packetlag_t;
 
+#ifdef HAVE_MMSG
+#define NET_MAX_BATCH	32		// datagrams per recvmmsg/sendmmsg call
+#define NET_BATCH_BUFSIZE	0x40000		// outgoing datagrams storage
+
+typedef struct
+{
+	struct mmsghdr	hdr[NET_MAX_BATCH];
+	struct iovec	iov[NET_MAX_BATCH];
+	struct sockaddr	addr[NET_MAX_BATCH];
+	byte		*data;		// NET_MAX_BATCH * NET_MAX_PAYLOAD, allocated on first use
+	int		count;		// datagrams received by the last call
+	int		current;		// next datagram to give out
+} netrecvbatch_t;
+
+typedef struct
+{
+	struct mmsghdr	hdr[NET_MAX_BATCH];
+	struct iovec	iov[NET_MAX_BATCH];
+	struct sockaddr	addr[NET_MAX_BATCH];
+	netadr_t		to[NET_MAX_BATCH];	// for error messages
+	byte		data[NET_BATCH_BUFSIZE];
+	SOCKET		socket;
+	int		count;
+	size_t		used;
+	qboolean		active;		// between NET_BeginSendBatch and NET_EndSendBatch
+} netsendbatch_t;
+
+static netrecvbatch_t	recvbatch;
+static netsendbatch_t	sendbatch;
+static qboolean		mmsg_unsupported = false;
+static convar_t		*net_batchio;
+#endif
+
+typedef struct
+{
+	int	recvcalls;	// recvfrom/recvmmsg syscalls
+	int	sendcalls;	// sendto/sendmmsg syscalls
+	int	packetsin;
+	int	packetsout;
+	int	startframe;
+} netiostats_t;
+
+static netiostats_t	net_iostats;
 static loopback_t	loopbacks[NS_COUNT];
 static packetlag_t lagdata[NS_COUNT];
 static float fakelag = 0.0f; // actual lag value
@@ -862,6 +910,232 @@ static qboolean NET_LagPacket( qboolean newdata, netsrc_t sock, netadr_t *from,
 }
 
 
+#ifdef HAVE_MMSG
+/*
+==================
+NET_RecvBatch
+
+drain the server socket with a single recvmmsg call
+and give out datagrams one by one
+==================
+*/
+static int NET_RecvBatch( SOCKET net_socket, byte *data, struct sockaddr *addr, socklen_t *addr_len )
+{
+	netrecvbatch_t	*b = &recvbatch;
+	int		i, ret;
+
+	if( b->current >= b->count )
+	{
+		if( !b->data )
+			b->data = (byte *)Z_Malloc( NET_MAX_BATCH * NET_MAX_PAYLOAD );
+
+		for( i = 0; i < NET_MAX_BATCH; i++ )
+		{
+			b->iov[i].iov_base = b->data + i * NET_MAX_PAYLOAD;
+			b->iov[i].iov_len = NET_MAX_PAYLOAD;
+			b->hdr[i].msg_hdr.msg_name = &b->addr[i];
+			b->hdr[i].msg_hdr.msg_namelen = sizeof( b->addr[i] );
+			b->hdr[i].msg_hdr.msg_iov = &b->iov[i];
+			b->hdr[i].msg_hdr.msg_iovlen = 1;
+			b->hdr[i].msg_hdr.msg_control = NULL;
+			b->hdr[i].msg_hdr.msg_controllen = 0;
+			b->hdr[i].msg_hdr.msg_flags = 0;
+		}
+
+		b->count = b->current = 0;
+		net_iostats.recvcalls++;
+
+		ret = recvmmsg( net_socket, b->hdr, NET_MAX_BATCH, 0, NULL );
+
+		if( ret < 0 )
+		{
+			if( errno == ENOSYS )
+			{
+				MsgDev( D_WARN, "NET_RecvBatch: recvmmsg is not supported, using recvfrom\n" );
+				mmsg_unsupported = true;
+				net_iostats.recvcalls++;
+				return pRecvFrom( net_socket, data, NET_MAX_PAYLOAD, 0, addr, addr_len );
+			}
+			return ret;
+		}
+
+		if( ret == 0 )
+		{
+			errno = EWOULDBLOCK;
+			return SOCKET_ERROR;
+		}
+
+		b->count = ret;
+	}
+
+	i = b->current++;
+
+	Q_memcpy( addr, &b->addr[i], sizeof( *addr ));
+	*addr_len = b->hdr[i].msg_hdr.msg_namelen;
+
+	// truncated datagrams are reported as oversize
+	if( b->hdr[i].msg_hdr.msg_flags & MSG_TRUNC )
+		return NET_MAX_PAYLOAD;
+
+	Q_memcpy( data, b->iov[i].iov_base, b->hdr[i].msg_len );
+
+	return b->hdr[i].msg_len;
+}
+
+/*
+==================
+NET_FlushSendBatch
+
+send all queued datagrams with sendmmsg
+==================
+*/
+static void NET_FlushSendBatch( void )
+{
+	netsendbatch_t	*b = &sendbatch;
+	int		ret, sent = 0;
+
+	while( sent < b->count )
+	{
+		if( mmsg_unsupported )
+		{
+			net_iostats.sendcalls++;
+			ret = pSendTo( b->socket, b->iov[sent].iov_base, b->iov[sent].iov_len, 0, &b->addr[sent], sizeof( b->addr[sent] ));
+			ret = ret < 0 ? ret : 1;
+		}
+		else
+		{
+			net_iostats.sendcalls++;
+			ret = sendmmsg( b->socket, b->hdr + sent, b->count - sent, 0 );
+
+			if( ret < 0 && errno == ENOSYS )
+			{
+				MsgDev( D_WARN, "NET_FlushSendBatch: sendmmsg is not supported, using sendto\n" );
+				mmsg_unsupported = true;
+				continue;
+			}
+		}
+
+		if( ret < 0 )
+		{
+			netadr_t	to = b->to[sent];
+
+			// WSAEWOULDBLOCK is silent, some PPP links don't allow broadcasts
+			if( errno != EWOULDBLOCK && !( errno == EADDRNOTAVAIL && ( to.type == NA_BROADCAST || to.type == NA_BROADCAST_IPX )))
+				MsgDev( D_ERROR, "NET_SendPacket: %s to %s\n", NET_ErrorString(), NET_AdrToString( to ));
+
+			// skip the failed datagram
+			ret = 1;
+		}
+
+		sent += ret;
+	}
+
+	b->count = 0;
+	b->used = 0;
+}
+
+/*
+==================
+NET_QueuePacket
+
+returns false if datagram should be sent immediately
+==================
+*/
+static qboolean NET_QueuePacket( SOCKET net_socket, size_t length, const void *data, struct sockaddr *addr, netadr_t to )
+{
+	netsendbatch_t	*b = &sendbatch;
+	int		i;
+
+	if( length > NET_BATCH_BUFSIZE )
+		return false;
+
+	if( b->count && ( b->socket != net_socket || b->count == NET_MAX_BATCH || b->used + length > NET_BATCH_BUFSIZE ))
+		NET_FlushSendBatch();
+
+	i = b->count++;
+	b->socket = net_socket;
+
+	Q_memcpy( b->data + b->used, data, length );
+	Q_memcpy( &b->addr[i], addr, sizeof( *addr ));
+	b->to[i] = to;
+
+	b->iov[i].iov_base = b->data + b->used;
+	b->iov[i].iov_len = length;
+	b->hdr[i].msg_hdr.msg_name = &b->addr[i];
+	b->hdr[i].msg_hdr.msg_namelen = sizeof( b->addr[i] );
+	b->hdr[i].msg_hdr.msg_iov = &b->iov[i];
+	b->hdr[i].msg_hdr.msg_iovlen = 1;
+	b->hdr[i].msg_hdr.msg_control = NULL;
+	b->hdr[i].msg_hdr.msg_controllen = 0;
+	b->hdr[i].msg_hdr.msg_flags = 0;
+
+	b->used += length;
+
+	return true;
+}
+
+/*
+==================
+NET_ClearBatches
+
+drop pending datagrams, the socket is about to close
+==================
+*/
+static void NET_ClearBatches( void )
+{
+	recvbatch.count = recvbatch.current = 0;
+	sendbatch.count = 0;
+	sendbatch.used = 0;
+}
+#endif
+
+/*
+==================
+NET_BeginSendBatch
+
+datagrams sent to the server socket are queued
+until the matching NET_EndSendBatch call
+==================
+*/
+void NET_BeginSendBatch( void )
+{
+#ifdef HAVE_MMSG
+	sendbatch.active = true;
+#endif
+}
+
+/*
+==================
+NET_EndSendBatch
+
+also called when frame was aborted
+==================
+*/
+void NET_EndSendBatch( void )
+{
+#ifdef HAVE_MMSG
+	sendbatch.active = false;
+
+	if( sendbatch.count )
+		NET_FlushSendBatch();
+#endif
+}
+
+/*
+==================
+NET_RecvFrom
+==================
+*/
+static int NET_RecvFrom( netsrc_t sock, SOCKET net_socket, byte *data, struct sockaddr *addr, socklen_t *addr_len )
+{
+#ifdef HAVE_MMSG
+	if( sock == NS_SERVER && net_batchio->integer && !mmsg_unsupported )
+		return NET_RecvBatch( net_socket, data, addr, addr_len );
+#endif
+	net_iostats.recvcalls++;
+	return pRecvFrom( net_socket, data, NET_MAX_PAYLOAD, 0, addr, addr_len );
+}
+
 /*
 ==================
 NET_GetPacket
@@ -897,7 +1171,7 @@ qboolean NET_GetPacket( netsrc_t sock, netadr_t *from, byte *data, size_t *lengt
 		if( !net_socket ) continue;
 
 		addr_len = sizeof( addr );
-		ret = pRecvFrom( net_socket, data, NET_MAX_PAYLOAD, 0, (struct sockaddr *)&addr, &addr_len );
+		ret = NET_RecvFrom( sock, net_socket, data, (struct sockaddr *)&addr, &addr_len );
 
 		NET_SockadrToNetadr( &addr, from );
 
@@ -925,6 +1199,7 @@ qboolean NET_GetPacket( netsrc_t sock, netadr_t *from, byte *data, size_t *lengt
 		}
 
 		*length = ret;
+		net_iostats.packetsin++;
 		return true;
 	}
 
@@ -975,7 +1250,13 @@ void NET_SendPacket( netsrc_t sock, size_t length, const void *data, netadr_t to
 	}
 
 	NET_NetadrToSockadr( &to, &addr );
+	net_iostats.packetsout++;
 
+#ifdef HAVE_MMSG
+	if( sock == NS_SERVER && sendbatch.active && net_batchio->integer && NET_QueuePacket( net_socket, length, data, &addr, to ))
+		return;
+#endif
+	net_iostats.sendcalls++;
 	ret = pSendTo( net_socket, data, length, 0, &addr, sizeof( addr ));
 
 #ifdef _WIN32
@@ -1007,6 +1288,47 @@ void NET_SendPacket( netsrc_t sock, size_t length, const void *data, netadr_t to
 #endif
 }
 
+/*
+====================
+NET_Sleep
+
+blocks until the server socket becomes readable or
+timeout (in microseconds) expires. returns true when
+there is pending data to read
+====================
+*/
+qboolean NET_Sleep( int usec )
+{
+	struct timeval	timeout;
+	fd_set		fdset;
+	SOCKET		net_socket;
+
+	if( usec < 0 ) usec = 0;
+
+	timeout.tv_sec = usec / 1000000;
+	timeout.tv_usec = usec % 1000000;
+
+	net_socket = ip_sockets[NS_SERVER];
+
+#ifdef HAVE_MMSG
+	// already drained from the socket
+	if( recvbatch.current < recvbatch.count )
+		return true;
+#endif
+
+	if( noip || !net_socket )
+	{
+		// nothing to wait for
+		Sys_Sleep( usec / 1000 );
+		return false;
+	}
+
+	FD_ZERO( &fdset );
+	FD_SET( net_socket, &fdset );
+
+	return pSelect( net_socket + 1, &fdset, NULL, NULL, &timeout ) > 0;
+}
+
 /*
 ====================
 NET_IPSocket
@@ -1105,6 +1427,9 @@ static void NET_OpenIP( qboolean changeport )
 	if( changeport && ( net_port->modified || sv_nat ) )
 	{
 		// reopen socket to set random port
+#ifdef HAVE_MMSG
+		NET_ClearBatches();
+#endif
 		if( ip_sockets[NS_SERVER] )
 			pCloseSocket( ip_sockets[NS_SERVER] );
 		ip_sockets[NS_SERVER] = 0;
@@ -1229,6 +1554,9 @@ void NET_Config( qboolean multiplayer, qboolean changeport )
 	{	
 		int	i;
 
+#ifdef HAVE_MMSG
+		NET_ClearBatches();
+#endif
 		// shut down any existing sockets
 		for( i = 0; i < 2; i++ )
 		{
@@ -1284,6 +1612,37 @@ void NET_ShowIP_f( void )
 	}
 }
 
+/*
+=================
+NET_IOStats_f
+=================
+*/
+void NET_IOStats_f( void )
+{
+	int	frames = max( host.framecount - net_iostats.startframe, 1 );
+
+	if( Cmd_Argc() > 1 && !Q_stricmp( Cmd_Argv( 1 ), "reset" ))
+	{
+		Q_memset( &net_iostats, 0, sizeof( net_iostats ));
+		net_iostats.startframe = host.framecount;
+		return;
+	}
+
+	Msg( "====================\n" );
+	Msg( "network i/o statistics\n" );
+	Msg( "====================\n" );
+#ifdef HAVE_MMSG
+	Msg( "batched i/o: %s\n", mmsg_unsupported ? "unsupported" : net_batchio->integer ? "enabled" : "disabled" );
+#else
+	Msg( "batched i/o: unsupported\n" );
+#endif
+	Msg( "frames: %i\n", frames );
+	Msg( "receive syscalls: %i (%.2f per frame)\n", net_iostats.recvcalls, (float)net_iostats.recvcalls / frames );
+	Msg( "send syscalls: %i (%.2f per frame)\n", net_iostats.sendcalls, (float)net_iostats.sendcalls / frames );
+	Msg( "packets received: %i (%.2f per frame)\n", net_iostats.packetsin, (float)net_iostats.packetsin / frames );
+	Msg( "packets sent: %i (%.2f per frame)\n", net_iostats.packetsout, (float)net_iostats.packetsout / frames );
+}
+
 /*
 ====================
 NET_Init
@@ -1312,6 +1671,10 @@ void NET_Init( void )
 
 	Cmd_AddCommand( "net_showip", NET_ShowIP_f,  "show hostname and IPs" );
 	Cmd_AddCommand( "net_restart", NET_Restart_f, "restart the network subsystem" );
+	Cmd_AddCommand( "net_iostats", NET_IOStats_f, "show network syscalls and packets per frame" );
+#ifdef HAVE_MMSG
+	net_batchio = Cvar_Get( "net_batchio", "1", CVAR_ARCHIVE, "use recvmmsg/sendmmsg on the server socket" );
+#endif
 
 	net_fakelag = Cvar_Get( "net_fakelag", "0", 0, "lag all incoming network data (including loopback) by xxx ms." );
 	net_fakeloss = Cvar_Get( "net_fakeloss", "0", 0, "act like we dropped the packet this % of the time." );
@@ -1343,10 +1706,20 @@ void NET_Shutdown( void )
 
 	Cmd_RemoveCommand( "net_showip" );
 	Cmd_RemoveCommand( "net_restart" );
+	Cmd_RemoveCommand( "net_iostats" );
 
 	NET_ClearLagData( true, true );
 
 	NET_Config( false, false );
+#ifdef HAVE_MMSG
+	NET_ClearBatches();
+	sendbatch.active = false;
+	if( recvbatch.data )
+	{
+		Mem_Free( recvbatch.data );
+		recvbatch.data = NULL;
+	}
+#endif
 #ifdef _WIN32
 	WSACleanup();
 #endif
@@ -167,17 +167,6 @@ hull_t *PM_HullForStudio( physent_t *pe, playermove_t *pmove, int *numhitboxes )
 
 	return Mod_HullForStudio( pe->studiomodel, pe->frame, pe->sequence, pe->angles, pe->origin, size, pe->controller, pe->blending, numhitboxes, NULL );
 }
-/* "Not a number" possible here.
- * Enable this macro to debug it */
-#ifdef DEBUGNAN
-static void _assertNAN(const char *f, int l, const char *x)
-{
-	MsgDev( D_WARN, "NAN detected at %s:%i (%s)\n", f, l, x );
-}
-#define ASSERTNAN(x) if( !finitef(x) ) _assertNAN( __FILE__, __LINE__, #x );
-#else
-#define ASSERTNAN(x)
-#endif
 /*
 ==================
 PM_RecursiveHullCheck
@@ -185,28 +174,10 @@ PM_RecursiveHullCheck
 */
 qboolean PM_RecursiveHullCheck( hull_t *hull, int num, float p1f, float p2f, vec3_t p1, vec3_t p2, pmtrace_t *trace )
 {
-	dclipnode_t	*node;
-	mplane_t		*plane;
-	float		t1, t2;
-	float		frac, midf;
-	int		side;
-	vec3_t		mid;
+	hulltrace_t	tr;
+	qboolean		result;
 
-	// check for empty
-	if( num < 0 )
-	{
-		if( num != CONTENTS_SOLID )
-		{
-			trace->allsolid = false;
-			if( num == CONTENTS_EMPTY )
-				trace->inopen = true;
-			else trace->inwater = true;
-		}
-		else trace->startsolid = true;
-		return true; // empty
-	}
-
-	if( hull->firstclipnode >= hull->lastclipnode )
+	if( num >= 0 && hull->firstclipnode >= hull->lastclipnode )
 	{
 		// studiotrace issues
 		trace->allsolid = false;
@@ -214,98 +185,27 @@ qboolean PM_RecursiveHullCheck( hull_t *hull, int num, float p1f, float p2f, vec
 		return true;
 	}
 
-	if( num < hull->firstclipnode || num > hull->lastclipnode )
-		Host_Error( "PM_RecursiveHullCheck: bad node number %i\n", num );
-
-	// find the point distances
-	node = hull->clipnodes + num;
-	plane = hull->planes + node->planenum;
-
-	if( plane->type < 3 )
-	{
-		t1 = p1[plane->type] - plane->dist;
-		t2 = p2[plane->type] - plane->dist;
-	}
-	else
-	{
-		t1 = DotProduct( plane->normal, p1 ) - plane->dist;
-		t2 = DotProduct( plane->normal, p2 ) - plane->dist;
-	}
-
-	ASSERTNAN( t1 )
-	ASSERTNAN( t2 )
-
-	if( t1 >= 0.0f && t2 >= 0.0f )
-		return PM_RecursiveHullCheck( hull, node->children[0], p1f, p2f, p1, p2, trace );
-	if( t1 < 0.0f && t2 < 0.0f )
-		return PM_RecursiveHullCheck( hull, node->children[1], p1f, p2f, p1, p2, trace );
-
-	ASSERTNAN( t1 )
-	ASSERTNAN( t2 )
-
-	// put the crosspoint DIST_EPSILON pixels on the near side
-	side = (t1 < 0.0f);
-
-	if( side ) frac = ( t1 + DIST_EPSILON ) / ( t1 - t2 );
-	else frac = ( t1 - DIST_EPSILON ) / ( t1 - t2 );
-
-	ASSERTNAN( frac )
-
-	if( frac < 0.0f ) frac = 0.0f;
-	if( frac > 1.0f ) frac = 1.0f;
-
-	midf = p1f + ( p2f - p1f ) * frac;
-	VectorLerp( p1, frac, p2, mid );
-
-	// move up to the node
-	if( !PM_RecursiveHullCheck( hull, node->children[side], p1f, midf, p1, mid, trace ))
-		return false;
-
-	// this recursion can not be optimized because mid would need to be duplicated on a stack
-	if( PM_HullPointContents( hull, node->children[side^1], mid ) != CONTENTS_SOLID )
-	{
-		// go past the node
-		return PM_RecursiveHullCheck( hull, node->children[side^1], midf, p2f, mid, p2, trace );
-	}	
-
-	// never got out of the solid area
-	if( trace->allsolid )
-		return false;
-
-	// the other side of the node is solid, this is the impact point
-	if( !side )
-	{
-		VectorCopy( plane->normal, trace->plane.normal );
-		trace->plane.dist = plane->dist;
-	}
-	else
-	{
-		VectorNegate( plane->normal, trace->plane.normal );
-		trace->plane.dist = -plane->dist;
-	}
-
-	while( PM_HullPointContents( hull, hull->firstclipnode, mid ) == CONTENTS_SOLID )
-	{
-		ASSERTNAN( frac )
-		// shouldn't really happen, but does occasionally
-		frac -= 0.1f;
-
-		if( ( frac < 0.0f )  || IS_NAN( frac ) )
-		{
-			trace->fraction = midf;
-			VectorCopy( mid, trace->endpos );
-			MsgDev( D_WARN, "trace backed up past 0.0\n" );
-			return false;
-		}
-
-		midf = p1f + ( p2f - p1f ) * frac;
-		VectorLerp( p1, frac, p2, mid );
-	}
-
-	trace->fraction = midf;
-	VectorCopy( mid, trace->endpos );
-
-	return false;
+	tr.allsolid = trace->allsolid;
+	tr.startsolid = trace->startsolid;
+	tr.inopen = trace->inopen;
+	tr.inwater = trace->inwater;
+	tr.fraction = trace->fraction;
+	VectorCopy( trace->endpos, tr.endpos );
+	VectorCopy( trace->plane.normal, tr.normal );
+	tr.dist = trace->plane.dist;
+
+	result = World_HullTrace( hull, num, p1f, p2f, p1, p2, &tr );
+
+	trace->allsolid = tr.allsolid;
+	trace->startsolid = tr.startsolid;
+	trace->inopen = tr.inopen;
+	trace->inwater = tr.inwater;
+	trace->fraction = tr.fraction;
+	VectorCopy( tr.endpos, trace->endpos );
+	VectorCopy( tr.normal, trace->plane.normal );
+	trace->plane.dist = tr.dist;
+
+	return result;
 }
 
 pmtrace_t PM_PlayerTraceExt( playermove_t *pmove, vec3_t start, vec3_t end, int flags, int numents, physent_t *ents, int ignore_pe, pfnIgnore pmFilter )
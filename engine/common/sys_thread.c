@@ -0,0 +1,438 @@
+/*
+sys_thread.c - worker threads for parallel jobs
+Copyright (C) 2026 Flying With Gauss
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+*/
+
+#include "common.h"
+#include "mathlib.h"
+
+#ifndef _WIN32
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#define MAX_JOB_THREADS	16
+
+#ifdef _WIN32
+#define lock_t		CRITICAL_SECTION
+#define lock_init( x )	InitializeCriticalSection( x )
+#define lock_free( x )	DeleteCriticalSection( x )
+#define lock_enter( x )	EnterCriticalSection( x )
+#define lock_leave( x )	LeaveCriticalSection( x )
+#else
+#define lock_t		pthread_mutex_t
+#define lock_init( x )	pthread_mutex_init( x, NULL )
+#define lock_free( x )	pthread_mutex_destroy( x )
+#define lock_enter( x )	pthread_mutex_lock( x )
+#define lock_leave( x )	pthread_mutex_unlock( x )
+#endif
+
+typedef struct
+{
+	pfnJob		func;
+	void		*data;
+	int		count;		// jobs in current batch
+	int		next;		// next job to pick
+	int		remaining;	// jobs which are not finished yet
+	int		generation;	// incremented for each batch
+
+	int		numworkers;
+	qboolean		initialized;
+	qboolean		shutdown;
+	qboolean		running;		// Sys_RunJobs is in progress
+
+	char		error[MAX_SYSPATH];	// first Sys_JobError of the batch
+
+	lock_t		lock;
+#ifdef _WIN32
+	HANDLE		wake;		// semaphore
+	HANDLE		done;		// auto-reset event
+	HANDLE		threads[MAX_JOB_THREADS];
+#else
+	pthread_cond_t	wake;
+	pthread_cond_t	done;
+	pthread_t		threads[MAX_JOB_THREADS];
+#endif
+} jobpool_t;
+
+static jobpool_t	jobs;
+
+/*
+================
+Sys_CPUCount
+================
+*/
+static int Sys_CPUCount( void )
+{
+#ifdef _WIN32
+	SYSTEM_INFO	info;
+
+	GetSystemInfo( &info );
+	return info.dwNumberOfProcessors;
+#elif defined( _SC_NPROCESSORS_ONLN )
+	return sysconf( _SC_NPROCESSORS_ONLN );
+#else
+	return 1;
+#endif
+}
+
+/*
+================
+Sys_DoJobs
+
+pick and run jobs until batch is empty,
+called with pool locked
+================
+*/
+static void Sys_DoJobs( void )
+{
+	int	index;
+
+	while( jobs.next < jobs.count )
+	{
+		index = jobs.next++;
+
+		lock_leave( &jobs.lock );
+		jobs.func( jobs.data, index );
+		lock_enter( &jobs.lock );
+
+		if( --jobs.remaining == 0 )
+		{
+#ifdef _WIN32
+			SetEvent( jobs.done );
+#else
+			pthread_cond_signal( &jobs.done );
+#endif
+		}
+	}
+}
+
+/*
+================
+Sys_JobThread
+================
+*/
+#ifdef _WIN32
+static DWORD WINAPI Sys_JobThread( LPVOID unused )
+{
+	while( 1 )
+	{
+		WaitForSingleObject( jobs.wake, INFINITE );
+
+		lock_enter( &jobs.lock );
+		if( jobs.shutdown )
+		{
+			lock_leave( &jobs.lock );
+			break;
+		}
+		Sys_DoJobs();
+		lock_leave( &jobs.lock );
+	}
+	return 0;
+}
+#else
+static void *Sys_JobThread( void *unused )
+{
+	int	generation = 0;
+
+	lock_enter( &jobs.lock );
+	while( 1 )
+	{
+		while( !jobs.shutdown && jobs.generation == generation )
+			pthread_cond_wait( &jobs.wake, &jobs.lock );
+
+		if( jobs.shutdown )
+			break;
+
+		generation = jobs.generation;
+		Sys_DoJobs();
+	}
+	lock_leave( &jobs.lock );
+
+	return NULL;
+}
+#endif
+
+/*
+================
+Sys_InitJobs
+
+starts worker threads on first use,
+-numthreads overrides the number of cpu cores
+================
+*/
+static void Sys_InitJobs( void )
+{
+	char	parm[32];
+	int	i, count;
+
+	if( jobs.initialized )
+		return;
+
+	jobs.initialized = true;
+
+	if( Sys_GetParmFromCmdLine( "-numthreads", parm ))
+		count = Q_atoi( parm );
+	else count = Sys_CPUCount();
+
+	// main thread runs jobs too
+	count = bound( 0, count - 1, MAX_JOB_THREADS );
+	if( !count ) return;
+
+	lock_init( &jobs.lock );
+#ifdef _WIN32
+	jobs.wake = CreateSemaphore( NULL, 0, MAX_JOB_THREADS, NULL );
+	jobs.done = CreateEvent( NULL, FALSE, FALSE, NULL );
+#else
+	pthread_cond_init( &jobs.wake, NULL );
+	pthread_cond_init( &jobs.done, NULL );
+#endif
+
+	for( i = 0; i < count; i++ )
+	{
+#ifdef _WIN32
+		if(( jobs.threads[i] = CreateThread( NULL, 0, Sys_JobThread, NULL, 0, NULL )) == NULL )
+			break;
+#else
+		if( pthread_create( &jobs.threads[i], NULL, Sys_JobThread, NULL ))
+			break;
+#endif
+	}
+
+	jobs.numworkers = i;
+
+	if( jobs.numworkers != count )
+		MsgDev( D_WARN, "Sys_InitJobs: created only %i of %i worker threads\n", jobs.numworkers, count );
+	MsgDev( D_NOTE, "Sys_InitJobs: %i worker threads\n", jobs.numworkers );
+}
+
+/*
+================
+Sys_NumJobThreads
+
+how many threads will run jobs, including the calling thread
+================
+*/
+int Sys_NumJobThreads( void )
+{
+	Sys_InitJobs();
+	return jobs.numworkers + 1;
+}
+
+/*
+================
+Sys_RaiseJobError
+
+raises error kept by Sys_JobError on the calling thread
+================
+*/
+static void Sys_RaiseJobError( void )
+{
+	char	error[MAX_SYSPATH];
+
+	if( !jobs.error[0] )
+		return;
+
+	Q_strncpy( error, jobs.error, sizeof( error ));
+	jobs.error[0] = '\0';
+
+	Host_Error( "%s", error );
+}
+
+/*
+================
+Sys_JobError
+
+Host_Error which is safe to call from jobs: the first
+error is kept and raised by Sys_RunJobs after all jobs
+are done, so caller must return a harmless result.
+outside of jobs it's the same as Host_Error
+================
+*/
+void Sys_JobError( const char *error, ... )
+{
+	char	text[MAX_SYSPATH];
+	va_list	argptr;
+
+	va_start( argptr, error );
+	Q_vsnprintf( text, sizeof( text ), error, argptr );
+	va_end( argptr );
+
+	if( !jobs.running )
+		Host_Error( "%s", text );
+
+	if( jobs.numworkers ) lock_enter( &jobs.lock );
+	if( !jobs.error[0] ) Q_strncpy( jobs.error, text, sizeof( jobs.error ));
+	if( jobs.numworkers ) lock_leave( &jobs.lock );
+}
+
+/*
+================
+Sys_RunJobs
+
+calls func( data, index ) for every index in [0, count)
+spreading them over worker threads. returns when all
+jobs are done. jobs must call Sys_JobError instead of
+Host_Error, it's raised here after the batch
+================
+*/
+void Sys_RunJobs( pfnJob func, void *data, int count )
+{
+	int	i;
+
+	if( count <= 0 ) return;
+
+	Sys_InitJobs();
+
+	if( !jobs.numworkers || count == 1 )
+	{
+		jobs.running = true;
+		for( i = 0; i < count; i++ )
+			func( data, i );
+		jobs.running = false;
+
+		Sys_RaiseJobError();
+		return;
+	}
+
+	lock_enter( &jobs.lock );
+
+	jobs.running = true;
+
+	jobs.func = func;
+	jobs.data = data;
+	jobs.count = count;
+	jobs.next = 0;
+	jobs.remaining = count;
+	jobs.generation++;
+
+#ifdef _WIN32
+	ReleaseSemaphore( jobs.wake, min( jobs.numworkers, count - 1 ), NULL );
+#else
+	pthread_cond_broadcast( &jobs.wake );
+#endif
+
+	Sys_DoJobs();
+
+	while( jobs.remaining > 0 )
+	{
+#ifdef _WIN32
+		lock_leave( &jobs.lock );
+		WaitForSingleObject( jobs.done, INFINITE );
+		lock_enter( &jobs.lock );
+#else
+		pthread_cond_wait( &jobs.done, &jobs.lock );
+#endif
+	}
+
+	jobs.func = NULL;
+	jobs.data = NULL;
+	jobs.count = 0;
+	jobs.running = false;
+
+	lock_leave( &jobs.lock );
+
+	Sys_RaiseJobError();
+}
+
+/*
+================
+Sys_ShutdownJobs
+================
+*/
+void Sys_ShutdownJobs( void )
+{
+	int	i;
+
+	if( !jobs.initialized )
+		return;
+
+	if( jobs.numworkers )
+	{
+		lock_enter( &jobs.lock );
+		jobs.shutdown = true;
+#ifdef _WIN32
+		ReleaseSemaphore( jobs.wake, jobs.numworkers, NULL );
+#else
+		pthread_cond_broadcast( &jobs.wake );
+#endif
+		lock_leave( &jobs.lock );
+
+		for( i = 0; i < jobs.numworkers; i++ )
+		{
+#ifdef _WIN32
+			WaitForSingleObject( jobs.threads[i], INFINITE );
+			CloseHandle( jobs.threads[i] );
+#else
+			pthread_join( jobs.threads[i], NULL );
+#endif
+		}
+
+#ifdef _WIN32
+		CloseHandle( jobs.wake );
+		CloseHandle( jobs.done );
+#else
+		pthread_cond_destroy( &jobs.wake );
+		pthread_cond_destroy( &jobs.done );
+#endif
+		lock_free( &jobs.lock );
+	}
+
+	Q_memset( &jobs, 0, sizeof( jobs ));
+}
+
+/*
+================
+Sys_CreateMutex
+================
+*/
+void *Sys_CreateMutex( void )
+{
+	lock_t	*mutex = (lock_t *)Z_Malloc( sizeof( lock_t ));
+
+	lock_init( mutex );
+	return mutex;
+}
+
+/*
+================
+Sys_DestroyMutex
+================
+*/
+void Sys_DestroyMutex( void *mutex )
+{
+	if( !mutex ) return;
+
+	lock_free( (lock_t *)mutex );
+	Mem_Free( mutex );
+}
+
+/*
+================
+Sys_LockMutex
+================
+*/
+void Sys_LockMutex( void *mutex )
+{
+	lock_enter( (lock_t *)mutex );
+}
+
+/*
+================
+Sys_UnlockMutex
+================
+*/
+void Sys_UnlockMutex( void *mutex )
+{
+	lock_leave( (lock_t *)mutex );
+}
@@ -125,6 +125,25 @@ void Sys_InitLog( void );
 void Sys_PrintLog( const char *pMsg );
 int Sys_LogFileNo( void );
 
+//
+// sys_thread.c
+//
+#ifdef _MSC_VER
+#define THREAD_LOCAL	__declspec( thread )
+#else
+#define THREAD_LOCAL	__thread
+#endif
+
+typedef void (*pfnJob)( void *data, int index );
+int Sys_NumJobThreads( void );
+void Sys_RunJobs( pfnJob func, void *data, int count );
+void Sys_JobError( const char *error, ... ) _format(1);
+void Sys_ShutdownJobs( void );
+void *Sys_CreateMutex( void );
+void Sys_DestroyMutex( void *mutex );
+void Sys_LockMutex( void *mutex );
+void Sys_UnlockMutex( void *mutex );
+
 #ifdef _WIN32
 //
 // con_win.c
@@ -15,7 +15,7 @@ GNU General Public License for more details.
 
 #include "common.h"
 #include "world.h"
-#include "pm_defs.h"
+#include "pm_local.h"
 #include "mod_local.h"
 #include "mathlib.h"
 #include "studio.h"
@@ -243,4 +243,236 @@ int BoxOnPlaneSide( const vec3_t emins, const vec3_t emaxs, const mplane_t *p )
 		sides |= 2;
 
 	return sides;
-}
\ No newline at end of file
+}
+
+/*
+===============================================================================
+
+	HULL TRACING
+
+===============================================================================
+*/
+#define MAX_HULLTRACE_STACK	256
+
+// node where trace was split, waits for near side result
+typedef struct
+{
+	const float	*normal;
+	float		dist;
+	int		far;		// child on the far side
+	int		side;
+	float		frac;
+	float		p1f, p2f, midf;
+	vec3_t		p1, p2, mid;
+} hullsplit_t;
+
+/*
+==================
+World_HullPointContents
+
+PM_HullPointContents for packed clipnodes
+==================
+*/
+static int World_HullPointContents( hull_t *hull, const mclipnode_t *packed, int num, const vec3_t p )
+{
+	const mclipnode_t	*node;
+	float		d;
+
+	if( !packed )
+		return PM_HullPointContents( hull, num, p );
+
+	while( num >= 0 )
+	{
+		node = packed + num;
+
+		if( node->type < 3 )
+			d = p[node->type] - node->dist;
+		else d = DotProduct( node->normal, p ) - node->dist;
+
+		num = node->children[d < 0.0f];
+	}
+
+	return num;
+}
+
+/*
+==================
+World_HullTrace
+
+walks clipnodes without recursion, same rules as quake RecursiveHullCheck:
+trace must be initialized with allsolid set, fraction 1 and endpos p2.
+world hulls are walked through packed clipnodes to keep node and plane
+in the same cache line. returns false if trace was stopped
+==================
+*/
+qboolean World_HullTrace( hull_t *hull, int num, float p1f, float p2f, const vec3_t start, const vec3_t end, hulltrace_t *trace )
+{
+	hullsplit_t	stack[MAX_HULLTRACE_STACK];
+	hullsplit_t	*split;
+	const mclipnode_t	*packed;
+	const float	*normal;
+	dclipnode_t	*node;
+	mplane_t		*plane;
+	float		t1, t2, dist;
+	vec3_t		p1, p2;
+	int		type, children[2];
+	int		depth = 0;
+
+	packed = Mod_PackedClipnodes( hull );
+
+	VectorCopy( start, p1 );
+	VectorCopy( end, p2 );
+
+	while( 1 )
+	{
+		// go down to the leaf, splitting the segment by crossed planes
+		while( num >= 0 )
+		{
+			if( num < hull->firstclipnode || num > hull->lastclipnode )
+			{
+				// traces may run on worker threads, give up with empty trace
+				Sys_JobError( "World_HullTrace: bad node number %i\n", num );
+				trace->allsolid = trace->startsolid = false;
+				return true;
+			}
+
+			if( packed )
+			{
+				normal = packed[num].normal;
+				dist = packed[num].dist;
+				type = packed[num].type;
+				children[0] = packed[num].children[0];
+				children[1] = packed[num].children[1];
+			}
+			else
+			{
+				node = hull->clipnodes + num;
+				plane = hull->planes + node->planenum;
+				normal = plane->normal;
+				dist = plane->dist;
+				type = plane->type;
+				children[0] = node->children[0];
+				children[1] = node->children[1];
+			}
+
+			if( type < 3 )
+			{
+				t1 = p1[type] - dist;
+				t2 = p2[type] - dist;
+			}
+			else
+			{
+				t1 = DotProduct( normal, p1 ) - dist;
+				t2 = DotProduct( normal, p2 ) - dist;
+			}
+
+			if( t1 >= 0.0f && t2 >= 0.0f )
+			{
+				num = children[0];
+				continue;
+			}
+
+			if( t1 < 0.0f && t2 < 0.0f )
+			{
+				num = children[1];
+				continue;
+			}
+
+			if( depth == MAX_HULLTRACE_STACK )
+			{
+				Sys_JobError( "World_HullTrace: stack overflow\n" );
+				trace->allsolid = trace->startsolid = false;
+				return true;
+			}
+
+			split = &stack[depth++];
+			split->normal = normal;
+			split->dist = dist;
+			split->side = (t1 < 0.0f);
+			split->far = children[split->side^1];
+
+			// put the crosspoint DIST_EPSILON pixels on the near side
+			if( split->side ) split->frac = ( t1 + DIST_EPSILON ) / ( t1 - t2 );
+			else split->frac = ( t1 - DIST_EPSILON ) / ( t1 - t2 );
+			split->frac = bound( 0.0f, split->frac, 1.0f );
+
+			split->p1f = p1f;
+			split->p2f = p2f;
+			split->midf = p1f + ( p2f - p1f ) * split->frac;
+			VectorCopy( p1, split->p1 );
+			VectorCopy( p2, split->p2 );
+			VectorLerp( p1, split->frac, p2, split->mid );
+
+			// move up to the node
+			num = children[split->side];
+			p2f = split->midf;
+			VectorCopy( split->mid, p2 );
+		}
+
+		// reached a leaf
+		if( num != CONTENTS_SOLID )
+		{
+			trace->allsolid = false;
+			if( num == CONTENTS_EMPTY )
+				trace->inopen = true;
+			else trace->inwater = true;
+		}
+		else trace->startsolid = true;
+
+		// near side of every split is done
+		if( !depth ) return true;
+
+		split = &stack[--depth];
+
+		if( World_HullPointContents( hull, packed, split->far, split->mid ) != CONTENTS_SOLID )
+		{
+			// go past the node
+			num = split->far;
+			p1f = split->midf;
+			p2f = split->p2f;
+			VectorCopy( split->mid, p1 );
+			VectorCopy( split->p2, p2 );
+			continue;
+		}
+
+		break;
+	}
+
+	// never got out of the solid area
+	if( trace->allsolid )
+		return false;
+
+	// the other side of the node is solid, this is the impact point
+	if( !split->side )
+	{
+		VectorCopy( split->normal, trace->normal );
+		trace->dist = split->dist;
+	}
+	else
+	{
+		VectorNegate( split->normal, trace->normal );
+		trace->dist = -split->dist;
+	}
+
+	while( World_HullPointContents( hull, packed, hull->firstclipnode, split->mid ) == CONTENTS_SOLID )
+	{
+		// shouldn't really happen, but does occasionally
+		split->frac -= 0.1f;
+
+		if( split->frac < 0.0f || IS_NAN( split->frac ))
+		{
+			trace->fraction = split->midf;
+			VectorCopy( split->mid, trace->endpos );
+			MsgDev( D_WARN, "trace backed up past 0.0\n" );
+			return false;
+		}
+
+		split->midf = split->p1f + ( split->p2f - split->p1f ) * split->frac;
+		VectorLerp( split->p1, split->frac, split->p2, split->mid );
+	}
+
+	trace->fraction = split->midf;
+	VectorCopy( split->mid, trace->endpos );
+
+	return false;
+}
@@ -33,7 +33,7 @@ ENTITY AREA CHECKING
 ===============================================================================
 */
 #define MAX_TOTAL_ENT_LEAFS		128
-#define AREA_NODES			32
+#define AREA_NODES			256	// enough for adaptive tree
 #define AREA_DEPTH			4
 
 #include "lightstyle.h"
@@ -43,7 +43,20 @@ void InsertLinkBefore( link_t *l, link_t *before );
 void RemoveLink( link_t *l );
 void ClearLink( link_t *l );
 
+// result of hull trace, shared by trace_t and pmtrace_t users
+typedef struct
+{
+	qboolean		allsolid;		// if true, plane is not valid
+	qboolean		startsolid;	// if true, the initial point was in a solid area
+	qboolean		inopen, inwater;
+	float		fraction;		// time completed, 1.0 = didn't hit anything
+	vec3_t		endpos;		// final position
+	vec3_t		normal;		// surface normal at impact
+	float		dist;
+} hulltrace_t;
+
 // trace common
+qboolean World_HullTrace( hull_t *hull, int num, float p1f, float p2f, const vec3_t start, const vec3_t end, hulltrace_t *trace );
 qboolean SV_RecursiveHullCheck( hull_t *hull, int num, float p1f, float p2f, vec3_t p1, vec3_t p2, trace_t *trace );
 void World_MoveBounds( const vec3_t start, vec3_t mins, vec3_t maxs, const vec3_t end, vec3_t boxmins, vec3_t boxmaxs );
 void World_TransformAABB( matrix4x4 transform, const vec3_t mins, const vec3_t maxs, vec3_t outmins, vec3_t outmaxs );
@@ -37,6 +37,20 @@ typedef struct areanode_s
 	link_t		water_edicts;	// func water
 } areanode_t;
 
+// single move for pfnTraceBatch
+typedef struct tracereq_s
+{
+	vec3_t		start;
+	vec3_t		end;
+	vec3_t		mins;		// zero for line traces
+	vec3_t		maxs;
+	int		type;		// MOVE_ type and FMOVE_ flags
+	edict_t		*pentIgnore;
+} tracereq_t;
+
+// pfnTraceBatch flags
+#define TRACEBATCH_THREADS	(1<<0)	// allow world clipping on worker threads
+
 typedef struct server_physics_api_s
 {
 	// unlink edict from old position and link onto new
@@ -65,6 +79,14 @@ typedef struct server_physics_api_s
 	// static allocations
 	void	*(*pfnMemAlloc)( size_t cb, const char *filename, const int fileline );
 	void	(*pfnMemFree)( void *mem, const char *filename, const int fileline );
+
+	// trace a set of moves at once, trace globals are not updated
+	void	(*pfnTraceBatch)( const tracereq_t *requests, trace_t *results, int count, int flags );
+
+	// lag compensation: move all players except pClient back to server time
+	// (0 - where pClient saw them), trace, then restore. returns moved players
+	int	(*pfnRewindPlayers)( edict_t *pClient, double time );
+	void	(*pfnRestorePlayers)( void );
 } server_physics_api_t;
 
 // physic callbacks
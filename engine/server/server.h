@@ -279,6 +279,12 @@ typedef struct sv_client_s
 	int		userinfo_change_attempts;
 	int		speedhack_warns;	// how many times client time was faster than server during this session
 	qboolean speedhack_warned;	// did we warn our server operator in the log for this batch of commands?
+
+	struct sv_client_s	*hash_qport_next;	// next client in svs.clients_qport bucket
+	struct sv_client_s	*hash_port_next;	// next client in svs.clients_port bucket
+	uint		hash_qport;		// buckets this client is linked into
+	uint		hash_port;
+	qboolean		hashed;
 } sv_client_t;
 
 
@@ -298,6 +304,9 @@ typedef struct sv_client_s
 // out before legitimate users connected
 #define MAX_CHALLENGES	1024
 
+// incoming packets are matched to clients by hashed address
+#define SV_CLIENT_HASHSIZE	256	// must be power of two
+
 typedef struct
 {
 	netadr_t		adr;
@@ -404,6 +413,9 @@ typedef struct
 	entity_state_t	*baselines;		// [GI->max_edicts]
 
 	challenge_t	challenges[MAX_CHALLENGES];	// to prevent invalid IPs from connecting
+
+	sv_client_t	*clients_qport[SV_CLIENT_HASHSIZE];	// by ip and qport
+	sv_client_t	*clients_port[SV_CLIENT_HASHSIZE];	// by ip and port (netsplit packets)
 } server_static_t;
 
 //=============================================================================
@@ -478,6 +490,17 @@ extern	convar_t		*mp_logecho;
 extern	convar_t		*mp_logfile;
 extern	convar_t		*sv_fixmulticast;
 extern	convar_t		*sv_allow_split;
+extern	convar_t		*sv_threaded_snapshots;
+extern	convar_t		*sv_packcache;
+extern	convar_t		*sv_pvsindex;
+extern	convar_t		*sv_deltacache;
+extern	convar_t		*sv_deltacache_size;
+extern	convar_t		*sv_entstringindex;
+extern	convar_t		*sv_tracecache;
+extern	convar_t		*sv_clipbounds;
+extern	convar_t		*sv_adaptive_areanodes;
+extern	convar_t		*sv_physentcache;
+extern	convar_t		*sv_threaded_physics;
 extern	convar_t		*sv_allow_compress;
 extern	convar_t		*sv_maxpacket;
 extern	convar_t		*sv_forcesimulating;
@@ -514,6 +537,7 @@ void SV_PrepWorldFrame( void );
 void SV_ProcessFile( sv_client_t *cl, char *filename );
 void SV_SendResourceList_f( sv_client_t *cl );
 void SV_AddToMaster( netadr_t from, sizebuf_t *msg );
+void SV_ReadPackets( void );
 
 //
 // sv_init.c
@@ -574,6 +598,11 @@ qboolean SV_ShouldUpdatePing( sv_client_t *cl );
 const char *SV_GetClientIDString( sv_client_t *cl );
 sv_client_t *SV_ClientById( int id );
 sv_client_t *SV_ClientByName( const char *name );
+void SV_LinkClientAddress( sv_client_t *cl );
+void SV_UnlinkClientAddress( sv_client_t *cl );
+void SV_ClearClientAddresses( void );
+sv_client_t *SV_ClientFromAddress( netadr_t adr, int qport );
+sv_client_t *SV_SplitClientFromAddress( netadr_t adr );
 qboolean SV_SetCurrentClient( sv_client_t *cl );
 void SV_FullClientUpdate( sv_client_t *cl, sizebuf_t *msg );
 void SV_FullUpdateMovevars( sv_client_t *cl, sizebuf_t *msg );
@@ -613,10 +642,16 @@ int SV_TransferConsistencyInfo( void );
 // sv_frame.c
 //
 void SV_WriteFrameToClient( sv_client_t *client, sizebuf_t *msg );
-void SV_BuildClientFrame( sv_client_t *client );
 void SV_InactivateClients( void );
 void SV_SendMessagesToAll( void );
 void SV_SkipUpdates( void );
+void SV_FreeClientSnapshots( void );
+void SV_SnapshotStats_f( void );
+void SV_FreePackCache( void );
+void SV_PackCacheStats_f( void );
+void SV_FreeDeltaCache( void );
+void SV_DeltaCacheStats_f( void );
+void SV_FreeLeafVisibility( void );
 
 //
 // sv_game.c
@@ -636,6 +671,8 @@ void SV_PlaybackEventFull( int flags, const edict_t *pInvoker, word eventindex,
 	float *angles, float fparam1, float fparam2, int iparam1, int iparam2, int bparam1, int bparam2 );
 void SV_PlaybackReliableEvent( sizebuf_t *msg, word eventindex, float delay, event_args_t *args );
 void SV_BaselineForEntity( edict_t *pEdict );
+int pfnCheckVisibility( const edict_t *ent, byte *pset );
+void SV_SphereBench_f( void );
 void SV_WriteEntityPatch( const char *filename );
 char *SV_ReadEntityScript( const char *filename, int *flags );
 float SV_AngleMod( float ideal, float current, float speed );
@@ -677,6 +714,15 @@ static inline edict_t *SV_EDICT_NUM( int n, const char *file, const int line )
 	return NULL;	
 }
 
+// svs.clients is indexed by edict number - 1, so this is SV_ClientFromEdict( ent, true )
+// for an edict already known to be valid without the call, for per-edict loops
+static inline sv_client_t *SV_SpawnedClient( int num )
+{
+	if((unsigned int)( num - 1 ) < (unsigned int)sv_maxclients->integer && svs.clients[num - 1].state == cs_spawned )
+		return svs.clients + ( num - 1 );
+	return NULL;
+}
+
 //
 // sv_save.c
 //
@@ -694,18 +740,47 @@ void SV_InitSaveRestore( void );
 //
 void SV_GetTrueOrigin( sv_client_t *cl, int edictnum, vec3_t origin );
 void SV_GetTrueMinMax( sv_client_t *cl, int edictnum, vec3_t mins, vec3_t maxs );
+void SV_TouchPhysEnt( const edict_t *ent );
+void SV_FreePhysEntCache( void );
+void SV_PhysEntStats_f( void );
+void SV_RecordPlayerHistory( void );
+int SV_RewindPlayers( edict_t *pClient, double time );
+void SV_RestorePlayers( void );
 
 //
 // sv_world.c
 //
 void SV_ClearWorld( void );
 void SV_UnlinkEdict( edict_t *ent );
+void SV_UnlinkLeafEdict( edict_t *ent );
+void SV_FreeLeafEdicts( void );
+qboolean SV_LeafEdictsValid( const edict_t *ent );
+void SV_MarkLeafEdicts( const byte *pset, byte *marks );
+void SV_FreeEdictGrid( void );
+void SV_FreeAreaBounds( void );
+void SV_FreeAreaTree( void );
+void SV_CheckAreaNodes( void );
+void SV_AreaNodeStats_f( void );
+void SV_LooseEdict( edict_t *ent );
+const byte *SV_EdictsInBox( const vec3_t mins, const vec3_t maxs );
+void SV_FreeTraceBench( void );
+void SV_TraceBench_f( void );
 qboolean SV_HeadnodeVisible( mnode_t *node, byte *visbits, int *lastleaf );
 void SV_ClipMoveToEntity( edict_t *ent, const vec3_t start, vec3_t mins, vec3_t maxs, const vec3_t end, trace_t *trace );
 void SV_CustomClipMoveToEntity( edict_t *ent, const vec3_t start, vec3_t mins, vec3_t maxs, const vec3_t end, trace_t *trace );
 trace_t SV_TraceHull( edict_t *ent, int hullNum, const vec3_t start, vec3_t mins, vec3_t maxs, const vec3_t end );
 trace_t SV_Move( const vec3_t start, vec3_t mins, vec3_t maxs, const vec3_t end, int type, edict_t *e );
 trace_t SV_MoveNoEnts( const vec3_t start, vec3_t mins, vec3_t maxs, const vec3_t end, int type, edict_t *e );
+void SV_MoveBatch( const tracereq_t *requests, trace_t *results, int count, int flags );
+void SV_FreeTraceBatch( void );
+tracereq_t *SV_PrefetchRequests( int count );
+void SV_PrefetchMoves( int count );
+void SV_EndPrefetch( void );
+void SV_FreePrefetch( void );
+void SV_PrefetchStats_f( void );
+void SV_FlushTraceCache( void );
+void SV_FreeTraceCache( void );
+void SV_TraceCacheStats_f( void );
 const char *SV_TraceTexture( edict_t *ent, const vec3_t start, const vec3_t end );
 msurface_t *SV_TraceSurface( edict_t *ent, const vec3_t start, const vec3_t end );
 trace_t SV_MoveToss( edict_t *tossent, edict_t *ignore );
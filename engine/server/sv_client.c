@@ -184,6 +184,149 @@ qboolean SV_ProcessUserAgent( netadr_t from, char *useragent )
 	return true;
 }
 
+/*
+=====================
+SV_ClientHashKey
+=====================
+*/
+static uint SV_ClientHashKey( netadr_t adr, uint value )
+{
+	uint	key = 0;
+
+	if( adr.type == NA_IP )
+		key = adr.ip.u32 * 2654435761U;
+
+	key ^= value * 40503U;
+
+	return ( key ^ ( key >> 16 )) & ( SV_CLIENT_HASHSIZE - 1 );
+}
+
+/*
+=====================
+SV_UnlinkClientAddress
+
+remove client from address hash
+=====================
+*/
+void SV_UnlinkClientAddress( sv_client_t *cl )
+{
+	sv_client_t	**link;
+
+	if( !cl->hashed )
+		return;
+
+	for( link = &svs.clients_qport[cl->hash_qport]; *link; link = &(*link)->hash_qport_next )
+	{
+		if( *link == cl )
+		{
+			*link = cl->hash_qport_next;
+			break;
+		}
+	}
+
+	for( link = &svs.clients_port[cl->hash_port]; *link; link = &(*link)->hash_port_next )
+	{
+		if( *link == cl )
+		{
+			*link = cl->hash_port_next;
+			break;
+		}
+	}
+
+	cl->hash_qport_next = cl->hash_port_next = NULL;
+	cl->hashed = false;
+}
+
+/*
+=====================
+SV_LinkClientAddress
+
+(re)link client into address hash,
+must be called when remote address or qport was changed
+=====================
+*/
+void SV_LinkClientAddress( sv_client_t *cl )
+{
+	SV_UnlinkClientAddress( cl );
+
+	cl->hash_qport = SV_ClientHashKey( cl->netchan.remote_address, cl->netchan.qport );
+	cl->hash_port = SV_ClientHashKey( cl->netchan.remote_address, cl->netchan.remote_address.port );
+
+	cl->hash_qport_next = svs.clients_qport[cl->hash_qport];
+	svs.clients_qport[cl->hash_qport] = cl;
+	cl->hash_port_next = svs.clients_port[cl->hash_port];
+	svs.clients_port[cl->hash_port] = cl;
+	cl->hashed = true;
+}
+
+/*
+=====================
+SV_ClearClientAddresses
+
+svs.clients was reallocated
+=====================
+*/
+void SV_ClearClientAddresses( void )
+{
+	Q_memset( svs.clients_qport, 0, sizeof( svs.clients_qport ));
+	Q_memset( svs.clients_port, 0, sizeof( svs.clients_port ));
+}
+
+/*
+=====================
+SV_ClientFromAddress
+
+find connected client for sequenced packet,
+port is ignored to fix up translated ports
+=====================
+*/
+sv_client_t *SV_ClientFromAddress( netadr_t adr, int qport )
+{
+	sv_client_t	*cl, *best = NULL;
+
+	for( cl = svs.clients_qport[SV_ClientHashKey( adr, qport )]; cl; cl = cl->hash_qport_next )
+	{
+		// entries are not removed when client becomes free
+		if( cl->state == cs_free || cl->fakeclient )
+			continue;
+
+		if( cl->netchan.qport != qport || !NET_CompareBaseAdr( adr, cl->netchan.remote_address ))
+			continue;
+
+		// keep the slot order if some zombie has the same address
+		if( !best || cl < best )
+			best = cl;
+	}
+
+	return best;
+}
+
+/*
+=====================
+SV_SplitClientFromAddress
+
+netsplit packets have no qport and don't allow changing ports
+=====================
+*/
+sv_client_t *SV_SplitClientFromAddress( netadr_t adr )
+{
+	sv_client_t	*cl, *best = NULL;
+
+	for( cl = svs.clients_port[SV_ClientHashKey( adr, adr.port )]; cl; cl = cl->hash_port_next )
+	{
+		if( cl->state == cs_free || cl->fakeclient || !cl->netchan.split )
+			continue;
+
+		if( cl->netchan.remote_address.port != adr.port || !NET_CompareBaseAdr( adr, cl->netchan.remote_address ))
+			continue;
+
+		if( !best || cl < best )
+			best = cl;
+	}
+
+	return best;
+}
+
 /*
 =====================
 SV_CleanupClient
@@ -207,6 +350,7 @@ void SV_CleanupClient( sv_client_t *cl, qboolean full )
 
 	if( full )
 	{
+		SV_UnlinkClientAddress( cl );
 		Q_memset( cl, '\0', sizeof( sv_client_t ) );
 	} else {
 
@@ -442,11 +586,12 @@ gotnewcl:
 
 	// initailize netchan here because SV_DropClient will clear network buffer
 	Netchan_Setup( NS_SERVER, &newcl->netchan, from, qport );
+	SV_LinkClientAddress( newcl );
 
 	if( sv_allow_compress->integer && ( requested_extensions & NET_EXT_HUFF ) )
 	{
 		extensions |= NET_EXT_HUFF;
-		newcl->netchan.compress = true;
+		newcl->netchan.compress = NET_COMPRESS_HUFF;
 	}
 
 	if( sv_allow_split->integer && ( requested_extensions & NET_EXT_SPLIT ) )
@@ -462,7 +607,15 @@ gotnewcl:
 
 		if( sv_allow_compress->integer && sv_allow_split->integer &&
 			 ( requested_extensions & NET_EXT_SPLITHUFF ) && !( requested_extensions & NET_EXT_HUFF ) )
-			newcl->netchan.splitcompress = true, extensions |= NET_EXT_SPLITHUFF;
+			newcl->netchan.splitcompress = NET_COMPRESS_HUFF, extensions |= NET_EXT_SPLITHUFF;
+	}
+
+	// client knows static code, use it for whatever was negotiated
+	if(( extensions & ( NET_EXT_HUFF|NET_EXT_SPLITHUFF )) && ( requested_extensions & NET_EXT_HUFFSTATIC ))
+	{
+		extensions |= NET_EXT_HUFFSTATIC;
+		if( newcl->netchan.compress ) newcl->netchan.compress = NET_COMPRESS_STATIC;
+		if( newcl->netchan.splitcompress ) newcl->netchan.splitcompress = NET_COMPRESS_STATIC;
 	}
 
 	BF_Init( &newcl->datagram, "Datagram", newcl->datagram_buf, sizeof( newcl->datagram_buf )); // datagram buf
@@ -24,6 +24,79 @@ typedef struct
 	entity_state_t	entities[MAX_VISIBLE_PACKET];	
 } sv_ents_t;
 
+typedef struct
+{
+	int		framenum;		// sv_pack.framenum when filled
+	int		hostflags;
+	qboolean		visible;
+	qboolean		added;		// pfnAddToFullPack result
+	uint		serial;		// identifies the state for delta cache
+	entity_state_t	state;
+} sv_packent_t;
+
+// pfnAddToFullPack results shared by clients in one frame
+static struct
+{
+	sv_packent_t	*ents;
+	int		maxents;
+	int		framenum;
+	uint		*serials;		// by entity number, for the client being built
+	uint		nextserial;
+
+	// sv_packcache_stats
+	int		lookups;
+	int		hits;
+	int		dllcalls;
+} sv_pack;
+
+// edicts which are checked by every client, the rest come from PVS leafs
+static struct
+{
+	byte		*always;
+	byte		*marks[2];	// normal and portal pass
+	int		maxedicts;
+	qboolean		active;		// valid for this frame
+} sv_leafvis;
+
+#define SV_BASELINE_SERIAL	((uint)-1)	// delta from svs.baselines
+#define DELTACACHE_HASHSIZE	4096
+#define DELTACACHE_MAXBYTES	512		// bigger deltas are not stored
+
+typedef struct
+{
+	uint		fromserial;
+	uint		toserial;
+	int		number;
+	qboolean		player;
+	int		offset;		// into sv_delta.data
+	int		numbits;
+	int		hashnext;		// -1 terminates
+} sv_deltaent_t;
+
+// encoded entity deltas shared by clients in one frame
+static struct
+{
+	sv_deltaent_t	*ents;
+	int		numents;
+	int		maxents;
+	byte		*data;
+	int		datasize;
+	int		maxdata;
+	int		cachesize;	// sv_deltacache_size in bytes
+	int		hash[DELTACACHE_HASHSIZE];
+	void		*lock;		// encoded on worker threads
+
+	uint		*serials;		// serial of every svs.packet_entities slot
+	int		numserials;
+
+	// sv_deltacache_stats
+	int		lookups;
+	int		hits;
+	int		stored;
+	int		dropped;		// cache was full
+	int		mismatches;	// sv_deltacache 2
+} sv_delta;
+
 static byte *clientpvs;	// FatPVS
 static byte *clientphs;	// FatPHS
 
@@ -49,6 +122,235 @@ static int SV_EntityNumbers( const void *a, const void *b )
 	return 1;
 }
 
+/*
+=============
+SV_PackCacheable
+
+assumes result of pfnAddToFullPack depends on the host only
+through visibility, hostflags, ownership and groupinfo. mods
+with per-player effects, team-only entities or spectator
+filtering break that, so sv_packcache is off by default
+=============
+*/
+static qboolean SV_PackCacheable( edict_t *ent, edict_t *pClient, qboolean player )
+{
+	if( !sv_packcache->integer || player || ent == pClient )
+		return false;
+
+	if( SV_IsValidEdict( ent->v.owner ) && ( ent->v.owner->v.flags & FL_CLIENT ))
+		return false;
+
+	if( ent->v.groupinfo || ( pClient && pClient->v.groupinfo ))
+		return false;
+
+	return true;
+}
+
+/*
+=============
+SV_AddToFullPack
+
+calls pfnAddToFullPack or takes the state packed for
+another client with the same visibility this frame
+=============
+*/
+static int SV_AddToFullPack( entity_state_t *state, int e, edict_t *ent, edict_t *pClient, int player, byte *pset )
+{
+	sv_packent_t	*pack;
+	qboolean		visible;
+
+	if( !SV_PackCacheable( ent, pClient, player ) || e >= sv_pack.maxents )
+	{
+		// state is not shared, so it can't be identified
+		if( e < sv_pack.maxents ) sv_pack.serials[e] = 0;
+		sv_pack.dllcalls++;
+		return svgame.dllFuncs.pfnAddToFullPack( state, e, ent, pClient, sv.hostflags, player, pset );
+	}
+
+	pack = &sv_pack.ents[e];
+	visible = pfnCheckVisibility( ent, pset );
+	sv_pack.lookups++;
+
+	if( pack->framenum == sv_pack.framenum && pack->hostflags == sv.hostflags && pack->visible == visible )
+	{
+		sv_pack.hits++;
+		sv_pack.serials[e] = pack->serial;
+		if( pack->added ) *state = pack->state;
+		return pack->added;
+	}
+
+	sv_pack.dllcalls++;
+	pack->added = svgame.dllFuncs.pfnAddToFullPack( state, e, ent, pClient, sv.hostflags, player, pset );
+	pack->framenum = sv_pack.framenum;
+	pack->hostflags = sv.hostflags;
+	pack->visible = visible;
+	if( pack->added ) pack->state = *state;
+
+	// zero is not shared and -1 is baseline
+	if( ++sv_pack.nextserial == SV_BASELINE_SERIAL )
+		sv_pack.nextserial = 1;
+	pack->serial = sv_pack.serials[e] = sv_pack.nextserial;
+
+	return pack->added;
+}
+
+/*
+=============
+SV_ClearPackCache
+
+invalidates results of previous frame
+=============
+*/
+static void SV_ClearPackCache( void )
+{
+	if( sv_pack.maxents != GI->max_edicts )
+	{
+		SV_FreePackCache();
+
+		sv_pack.maxents = GI->max_edicts;
+		sv_pack.ents = Z_Malloc( sizeof( sv_packent_t ) * sv_pack.maxents );
+		sv_pack.serials = Z_Malloc( sizeof( uint ) * sv_pack.maxents );
+	}
+
+	sv_pack.framenum++;
+}
+
+/*
+=============
+SV_FreePackCache
+=============
+*/
+void SV_FreePackCache( void )
+{
+	if( sv_pack.ents ) Mem_Free( sv_pack.ents );
+	if( sv_pack.serials ) Mem_Free( sv_pack.serials );
+
+	sv_pack.ents = NULL;
+	sv_pack.serials = NULL;
+	sv_pack.maxents = 0;
+}
+
+/*
+=============
+SV_PackCacheStats_f
+=============
+*/
+void SV_PackCacheStats_f( void )
+{
+	if( Cmd_Argc() > 1 && !Q_stricmp( Cmd_Argv( 1 ), "reset" ))
+	{
+		sv_pack.lookups = sv_pack.hits = sv_pack.dllcalls = 0;
+		return;
+	}
+
+	Msg( "pack cache: %s\n", sv_packcache->integer ? "enabled" : "disabled" );
+	Msg( "%i lookups, %i hits (%.1f%%)\n", sv_pack.lookups, sv_pack.hits,
+		sv_pack.lookups ? sv_pack.hits * 100.0f / sv_pack.lookups : 0.0f );
+	Msg( "%i AddToFullPack calls, %i saved\n", sv_pack.dllcalls, sv_pack.hits );
+}
+
+/*
+=============
+SV_SetupLeafVisibility
+
+collects edicts which can't be found by PVS leafs,
+done once per frame instead of once per client
+=============
+*/
+static void SV_SetupLeafVisibility( void )
+{
+	edict_t	*ent;
+	int	e;
+
+	sv_leafvis.active = false;
+
+	if( !sv_pvsindex->integer || !sv.worldmodel )
+		return;
+
+	if( sv_leafvis.maxedicts != GI->max_edicts )
+	{
+		SV_FreeLeafVisibility();
+
+		sv_leafvis.maxedicts = GI->max_edicts;
+		sv_leafvis.always = Z_Malloc(( sv_leafvis.maxedicts + 7 ) >> 3 );
+		sv_leafvis.marks[0] = Z_Malloc(( sv_leafvis.maxedicts + 7 ) >> 3 );
+		sv_leafvis.marks[1] = Z_Malloc(( sv_leafvis.maxedicts + 7 ) >> 3 );
+	}
+
+	Q_memset( sv_leafvis.always, 0, ( sv_leafvis.maxedicts + 7 ) >> 3 );
+
+	for( e = 1; e < svgame.numEntities; e++ )
+	{
+		ent = EDICT_NUM( e );
+		if( ent->free ) continue;
+
+		// unlinked entities fail the PVS check anyway
+		if( ent->headnode < 0 && !ent->num_leafs && !( ent->v.flags & FL_CLIENT ))
+			continue;
+
+		// clients, beams upcast to owner, portals, PHS users and
+		// entities linked by headnode are tested one by one
+		if( !( ent->v.flags & ( FL_CLIENT|FL_CUSTOMENTITY )) && !( ent->v.effects & ( EF_MERGE_VISIBILITY|EF_REQUEST_PHS )) && SV_LeafEdictsValid( ent ))
+			continue;
+
+		sv_leafvis.always[e >> 3] |= 1U << ( e & 7 );
+	}
+
+	sv_leafvis.active = true;
+}
+
+/*
+=============
+SV_FreeLeafVisibility
+=============
+*/
+void SV_FreeLeafVisibility( void )
+{
+	if( sv_leafvis.always ) Mem_Free( sv_leafvis.always );
+	if( sv_leafvis.marks[0] ) Mem_Free( sv_leafvis.marks[0] );
+	if( sv_leafvis.marks[1] ) Mem_Free( sv_leafvis.marks[1] );
+
+	Q_memset( &sv_leafvis, 0, sizeof( sv_leafvis ));
+}
+
+/*
+=============
+SV_MarkVisibleEdicts
+
+returns edicts that may pass PVS check or NULL when
+every edict has to be tested. sv_pvsindex 2 compares
+result with the full scan
+=============
+*/
+static byte *SV_MarkVisibleEdicts( byte *pset )
+{
+	byte	*marks;
+	edict_t	*ent;
+	int	e;
+
+	if( !sv_leafvis.active || !pset )
+		return NULL;
+
+	marks = sv_leafvis.marks[( sv.hostflags & SVF_PORTALPASS ) ? 1 : 0];
+	Q_memcpy( marks, sv_leafvis.always, ( sv_leafvis.maxedicts + 7 ) >> 3 );
+	SV_MarkLeafEdicts( pset, marks );
+
+	if( sv_pvsindex->integer < 2 )
+		return marks;
+
+	for( e = 1; e < svgame.numEntities; e++ )
+	{
+		ent = EDICT_NUM( e );
+		if( ent->free || ( marks[e >> 3] & ( 1U << ( e & 7 ))))
+			continue;
+
+		if( pfnCheckVisibility( ent, pset ))
+			MsgDev( D_ERROR, "SV_MarkVisibleEdicts: %s (%i) is visible but not listed\n", SV_ClassName( ent ), e );
+	}
+
+	return marks;
+}
+
 /*
 =============
 SV_AddEntitiesToPacket
@@ -63,6 +365,7 @@ static void SV_AddEntitiesToPacket( edict_t *pViewEnt, edict_t *pClient, client_
 	sv_client_t	*netclient;
 	sv_client_t	*cl = NULL;
 	entity_state_t	*state;
+	byte		*marks;
 	int		e, player;
 
 	// during an error shutdown message we may need to transmit
@@ -97,8 +400,14 @@ static void SV_AddEntitiesToPacket( edict_t *pViewEnt, edict_t *pClient, client_
 	svgame.dllFuncs.pfnSetupVisibility( pViewEnt, pClient, &clientpvs, &clientphs );
 	if( !clientpvs ) fullvis = true;
 
+	marks = SV_MarkVisibleEdicts( clientpvs );
+
 	for( e = 1; e < svgame.numEntities; e++ )
 	{
+		// not in visible leafs
+		if( marks && !( marks[e >> 3] & ( 1U << ( e & 7 ))))
+			continue;
+
 		ent = EDICT_NUM( e );
 		if( ent->free ) continue;
 
@@ -112,11 +421,11 @@ static void SV_AddEntitiesToPacket( edict_t *pViewEnt, edict_t *pClient, client_
 		else pset = clientpvs;
 
 		state = &ents->entities[ents->num_entities];
-		netclient = SV_ClientFromEdict( ent, true );
+		netclient = SV_SpawnedClient( e );
 		player = ( netclient != NULL );
 
 		// add entity to the net packet
-		if( svgame.dllFuncs.pfnAddToFullPack( state, e, ent, pClient, sv.hostflags, player, pset ))
+		if( SV_AddToFullPack( state, e, ent, pClient, player, pset ))
 		{
 			// to prevent adds it twice through portals
 			ent->v.pushmsec = sv.net_framenum;
@@ -167,6 +476,251 @@ Encode a client frame onto the network channel
 
 =============================================================================
 */
+/*
+=============
+SV_DeltaFrame
+
+this is the frame that we are going to delta update from,
+must be called after all the frames for this update are
+written into svs.packet_entities
+=============
+*/
+static client_frame_t *SV_DeltaFrame( sv_client_t *cl )
+{
+	client_frame_t	*from;
+
+	if( cl->delta_sequence == -1 )
+		return NULL;
+
+	from = &cl->frames[cl->delta_sequence & SV_UPDATE_MASK];
+
+	// the snapshot's entities may still have rolled off the buffer, though
+	if( from->first_entity <= svs.next_client_entities - svs.num_client_entities )
+	{
+		MsgDev( D_WARN, "%s: delta request from out of date entities.\n", cl->name );
+		return NULL;
+	}
+
+	return from;
+}
+
+/*
+=============
+SV_ClearDeltaCache
+
+drops deltas of previous frame, resizes the
+cache when sv_deltacache_size was changed
+=============
+*/
+static void SV_ClearDeltaCache( void )
+{
+	int	cachesize = max( sv_deltacache_size->integer, 0 ) * 1024;
+
+	if( sv_delta.cachesize != cachesize )
+	{
+		if( sv_delta.ents ) Mem_Free( sv_delta.ents );
+		if( sv_delta.data ) Mem_Free( sv_delta.data );
+
+		sv_delta.ents = NULL;
+		sv_delta.data = NULL;
+		sv_delta.maxents = sv_delta.maxdata = 0;
+		sv_delta.cachesize = cachesize;
+
+		// budget is shared by entries and bits, deltas are 32 bytes at average
+		if( cachesize > 0 )
+		{
+			sv_delta.maxents = max( cachesize / ( sizeof( sv_deltaent_t ) + 32 ), 1 );
+			sv_delta.maxdata = cachesize - sv_delta.maxents * sizeof( sv_deltaent_t );
+			sv_delta.ents = Z_Malloc( sizeof( sv_deltaent_t ) * sv_delta.maxents );
+			sv_delta.data = Z_Malloc( sv_delta.maxdata );
+		}
+	}
+
+	if( !sv_delta.lock )
+		sv_delta.lock = Sys_CreateMutex();
+
+	sv_delta.numents = sv_delta.datasize = 0;
+	Q_memset( sv_delta.hash, 0xFF, sizeof( sv_delta.hash ));
+}
+
+/*
+=============
+SV_FreeDeltaCache
+=============
+*/
+void SV_FreeDeltaCache( void )
+{
+	if( sv_delta.ents ) Mem_Free( sv_delta.ents );
+	if( sv_delta.data ) Mem_Free( sv_delta.data );
+	if( sv_delta.serials ) Mem_Free( sv_delta.serials );
+	if( sv_delta.lock ) Sys_DestroyMutex( sv_delta.lock );
+
+	Q_memset( &sv_delta, 0, sizeof( sv_delta ));
+}
+
+/*
+=============
+SV_SetStateSerial
+
+remembers which shared state was copied
+into svs.packet_entities slot
+=============
+*/
+static void SV_SetStateSerial( int slot, int number )
+{
+	if( sv_delta.numserials != svs.num_client_entities )
+	{
+		if( sv_delta.serials ) Mem_Free( sv_delta.serials );
+
+		sv_delta.numserials = svs.num_client_entities;
+		sv_delta.serials = Z_Malloc( sizeof( uint ) * sv_delta.numserials );
+	}
+
+	if( number >= 0 && number < sv_pack.maxents )
+		sv_delta.serials[slot] = sv_pack.serials[number];
+	else sv_delta.serials[slot] = 0;
+}
+
+static uint SV_StateSerial( int slot )
+{
+	if( slot < sv_delta.numserials )
+		return sv_delta.serials[slot];
+	return 0;
+}
+
+/*
+=============
+SV_FindDeltaEntity
+
+must be called with sv_delta.lock held
+=============
+*/
+static sv_deltaent_t *SV_FindDeltaEntity( uint fromserial, uint toserial, int number, qboolean player, int hash )
+{
+	sv_deltaent_t	*dent;
+	int		i;
+
+	for( i = sv_delta.hash[hash]; i != -1; i = dent->hashnext )
+	{
+		dent = &sv_delta.ents[i];
+
+		if( dent->fromserial == fromserial && dent->toserial == toserial && dent->number == number && dent->player == player )
+			return dent;
+	}
+
+	return NULL;
+}
+
+/*
+=============
+SV_WriteDeltaEntity
+
+MSG_WriteDeltaEntity which takes the bits from another client
+that sent the same pair of states this frame. sv_deltacache 2
+encodes anyway and compares them
+=============
+*/
+static void SV_WriteDeltaEntity( entity_state_t *from, entity_state_t *to, uint fromserial, uint toserial, sizebuf_t *msg, qboolean force, qboolean player )
+{
+	byte		bits[DELTACACHE_MAXBYTES];
+	sv_deltaent_t	*dent;
+	int		hash, startBit, numbits, numbytes;
+	sizebuf_t		src;
+
+	if( !sv_deltacache->integer || !sv_delta.maxents || !sv_delta.lock || !fromserial || !toserial )
+	{
+		MSG_WriteDeltaEntity( from, to, msg, force, player, sv.time );
+		return;
+	}
+
+	hash = ( fromserial * 31 + toserial * 17 + to->number ) & ( DELTACACHE_HASHSIZE - 1 );
+
+	Sys_LockMutex( sv_delta.lock );
+	dent = SV_FindDeltaEntity( fromserial, toserial, to->number, player, hash );
+	sv_delta.lookups++;
+	if( dent ) sv_delta.hits++;
+	Sys_UnlockMutex( sv_delta.lock );
+
+	// stored entries never change until the next frame
+	if( dent && sv_deltacache->integer < 2 )
+	{
+		BF_WriteBits( msg, sv_delta.data + dent->offset, dent->numbits );
+		return;
+	}
+
+	startBit = BF_GetNumBitsWritten( msg );
+	MSG_WriteDeltaEntity( from, to, msg, force, player, sv.time );
+	numbits = BF_GetNumBitsWritten( msg ) - startBit;
+	numbytes = BitByte( numbits );
+
+	if( BF_CheckOverflow( msg ) || numbytes > sizeof( bits ))
+		return;
+
+	BF_StartReading( &src, BF_GetData( msg ), BF_GetMaxBytes( msg ), startBit, -1 );
+	BF_ReadBits( &src, bits, numbits );
+
+	if( dent )
+	{
+		if( dent->numbits != numbits || memcmp( sv_delta.data + dent->offset, bits, numbytes ))
+		{
+			MsgDev( D_ERROR, "SV_WriteDeltaEntity: cached delta for entity %i differs\n", to->number );
+			Sys_LockMutex( sv_delta.lock );
+			sv_delta.mismatches++;
+			Sys_UnlockMutex( sv_delta.lock );
+		}
+		return;
+	}
+
+	Sys_LockMutex( sv_delta.lock );
+
+	// another thread may have stored it meanwhile
+	if( !SV_FindDeltaEntity( fromserial, toserial, to->number, player, hash ))
+	{
+		if( sv_delta.numents < sv_delta.maxents && sv_delta.datasize + numbytes <= sv_delta.maxdata )
+		{
+			dent = &sv_delta.ents[sv_delta.numents];
+			dent->fromserial = fromserial;
+			dent->toserial = toserial;
+			dent->number = to->number;
+			dent->player = player;
+			dent->offset = sv_delta.datasize;
+			dent->numbits = numbits;
+			dent->hashnext = sv_delta.hash[hash];
+			Q_memcpy( sv_delta.data + dent->offset, bits, numbytes );
+
+			sv_delta.hash[hash] = sv_delta.numents++;
+			sv_delta.datasize += numbytes;
+			sv_delta.stored++;
+		}
+		else sv_delta.dropped++;
+	}
+
+	Sys_UnlockMutex( sv_delta.lock );
+}
+
+/*
+=============
+SV_DeltaCacheStats_f
+=============
+*/
+void SV_DeltaCacheStats_f( void )
+{
+	if( Cmd_Argc() > 1 && !Q_stricmp( Cmd_Argv( 1 ), "reset" ))
+	{
+		sv_delta.lookups = sv_delta.hits = sv_delta.stored = 0;
+		sv_delta.dropped = sv_delta.mismatches = 0;
+		return;
+	}
+
+	Msg( "delta cache: %s, %i entries, %s of bits\n", sv_deltacache->integer ? "enabled" : "disabled",
+		sv_delta.maxents, Q_memprint( sv_delta.maxdata ));
+	Msg( "%i lookups, %i hits (%.1f%%)\n", sv_delta.lookups, sv_delta.hits,
+		sv_delta.lookups ? sv_delta.hits * 100.0f / sv_delta.lookups : 0.0f );
+	Msg( "%i deltas stored, %i dropped when cache was full\n", sv_delta.stored, sv_delta.dropped );
+	Msg( "last frame: %i entries, %s\n", sv_delta.numents, Q_memprint( sv_delta.datasize ));
+	if( sv_deltacache->integer >= 2 ) Msg( "%i mismatches\n", sv_delta.mismatches );
+}
+
 /*
 =============
 SV_EmitPacketEntities
@@ -174,42 +728,25 @@ SV_EmitPacketEntities
 Writes a delta update of an entity_state_t list to the message->
 =============
 */
-void SV_EmitPacketEntities( sv_client_t *cl, client_frame_t *to, sizebuf_t *msg )
+static void SV_EmitPacketEntities( sv_client_t *cl, client_frame_t *from, client_frame_t *to, sizebuf_t *msg )
 {
 	entity_state_t	*oldent, *newent;
 	int		oldindex, newindex;
 	int		oldnum, newnum;
+	int		oldslot, newslot;
 	int		from_num_entities;
-	client_frame_t	*from;
 	qboolean player = false;
 
-	// this is the frame that we are going to delta update from
-	if( cl->delta_sequence != -1 )
+	if( from )
 	{
-		from = &cl->frames[cl->delta_sequence & SV_UPDATE_MASK];
 		from_num_entities = from->num_entities;
 
-		// the snapshot's entities may still have rolled off the buffer, though
-		if( from->first_entity <= svs.next_client_entities - svs.num_client_entities )
-		{
-			MsgDev( D_WARN, "%s: delta request from out of date entities.\n", cl->name );
-
-			from = NULL;
-			from_num_entities = 0;
-
-			BF_WriteByte( msg, svc_packetentities );
-			BF_WriteWord( msg, to->num_entities );
-		}
-		else
-		{
-			BF_WriteByte( msg, svc_deltapacketentities );
-			BF_WriteWord( msg, to->num_entities );
-			BF_WriteByte( msg, cl->delta_sequence );
-		}
+		BF_WriteByte( msg, svc_deltapacketentities );
+		BF_WriteWord( msg, to->num_entities );
+		BF_WriteByte( msg, cl->delta_sequence );
 	}
 	else
 	{
-		from = NULL;
 		from_num_entities = 0;
 
 		BF_WriteByte( msg, svc_packetentities );
@@ -230,7 +767,8 @@ void SV_EmitPacketEntities( sv_client_t *cl, client_frame_t *to, sizebuf_t *msg
 		}
 		else
 		{
-			newent = &svs.packet_entities[(to->first_entity+newindex)%svs.num_client_entities];
+			newslot = (to->first_entity+newindex)%svs.num_client_entities;
+			newent = &svs.packet_entities[newslot];
 			player = SV_IsPlayerIndex( newent->number );
 			newnum = newent->number;
 		}
@@ -241,7 +779,8 @@ void SV_EmitPacketEntities( sv_client_t *cl, client_frame_t *to, sizebuf_t *msg
 		}
 		else
 		{
-			oldent = &svs.packet_entities[(from->first_entity+oldindex)%svs.num_client_entities];
+			oldslot = (from->first_entity+oldindex)%svs.num_client_entities;
+			oldent = &svs.packet_entities[oldslot];
 			oldnum = oldent->number;
 		}
 
@@ -250,7 +789,7 @@ void SV_EmitPacketEntities( sv_client_t *cl, client_frame_t *to, sizebuf_t *msg
 			// delta update from old position
 			// because the force parm is false, this will not result
 			// in any bytes being emited if the entity has not changed at all
-			MSG_WriteDeltaEntity( oldent, newent, msg, false, player, sv.time );
+			SV_WriteDeltaEntity( oldent, newent, SV_StateSerial( oldslot ), SV_StateSerial( newslot ), msg, false, player );
 			oldindex++;
 			newindex++;
 			continue;
@@ -259,7 +798,7 @@ void SV_EmitPacketEntities( sv_client_t *cl, client_frame_t *to, sizebuf_t *msg
 		if( newnum < oldnum )
 		{	
 			// this is a new entity, send it from the baseline
-			MSG_WriteDeltaEntity( &svs.baselines[newnum], newent, msg, true, player, sv.time );
+			SV_WriteDeltaEntity( &svs.baselines[newnum], newent, SV_BASELINE_SERIAL, SV_StateSerial( newslot ), msg, true, player );
 			newindex++;
 			continue;
 		}
@@ -533,30 +1072,33 @@ void SV_WriteClientdataToMessage( sv_client_t *cl, sizebuf_t *msg )
 
 /*
 ==================
-SV_WriteEntitiesToClient
+SV_BuildClientFrame
 
+collects visible entities into the client frame,
+calls into the game dll so must be run serially.
+returns NULL if client was dropped
 ==================
 */
-void SV_WriteEntitiesToClient( sv_client_t *cl, sizebuf_t *msg )
+static client_frame_t *SV_BuildClientFrame( sv_client_t *cl, qboolean *send_pings )
 {
 	edict_t		*clent;
 	edict_t		*viewent;	// may be NULL
 	client_frame_t	*frame;
 	entity_state_t	*state;
 	static sv_ents_t	frame_ents;
-	int		i, send_pings;
+	int		i;
 
 	clent = cl->edict;
 	if(	!SV_IsValidEdict( clent ) )
 	{
 		SV_DropClient ( cl );
-		return;
+		return NULL;
 	}
 	viewent = cl->pViewEntity;	// himself or trigger_camera
 
 	frame = &cl->frames[cl->netchan.outgoing_sequence & SV_UPDATE_MASK];
 
-	send_pings = SV_ShouldUpdatePing( cl );
+	*send_pings = SV_ShouldUpdatePing( cl );
 
 	sv.net_framenum++;	// now all portal-through entities are invalidate
 	sv.hostflags &= ~SVF_PORTALPASS;
@@ -594,6 +1136,7 @@ void SV_WriteEntitiesToClient( sv_client_t *cl, sizebuf_t *msg )
 		// add it to the circular packet_entities array
 		state = &svs.packet_entities[svs.next_client_entities % svs.num_client_entities];
 		*state = frame_ents.entities[i];
+		SV_SetStateSerial( svs.next_client_entities % svs.num_client_entities, state->number );
 		svs.next_client_entities++;
 
 		// this should never hit, map should always be restarted first in SV_Frame
@@ -602,8 +1145,21 @@ void SV_WriteEntitiesToClient( sv_client_t *cl, sizebuf_t *msg )
 		frame->num_entities++;
 	}
 
-	SV_EmitPacketEntities( cl, frame, msg );
-	SV_EmitEvents( cl, frame, msg );
+	return frame;
+}
+
+/*
+==================
+SV_WriteClientFrame
+
+encodes the built frame, touches only the client itself
+and read-only server state so it may run on a worker thread
+==================
+*/
+static void SV_WriteClientFrame( sv_client_t *cl, client_frame_t *from, client_frame_t *to, qboolean send_pings, sizebuf_t *msg )
+{
+	SV_EmitPacketEntities( cl, from, to, msg );
+	SV_EmitEvents( cl, to, msg );
 	if( send_pings ) SV_EmitPings( msg );
 }
 
@@ -614,44 +1170,267 @@ FRAME UPDATES
 
 ===============================================================================
 */
+typedef struct
+{
+	sv_client_t	*cl;
+	client_frame_t	*from;		// delta frame, NULL for full update
+	client_frame_t	*to;		// NULL if client was dropped
+	qboolean		send_pings;
+	sizebuf_t		msg;
+} sv_snapshot_t;
+
+typedef struct
+{
+	int		frames;
+	double		time;
+} sv_snapshothist_t;
+
+static struct
+{
+	sv_snapshot_t	*snapshots;
+	byte		*buffers;		// NET_MAX_PAYLOAD for each client
+	int		numsnapshots;
+	void		*encodelock;
+
+	// sv_snapshot_stats
+	sv_snapshothist_t	hist[MAX_CLIENTS+1];	// by number of clients updated
+	double		build_time;
+	double		encode_time;
+	double		send_time;
+} sv_snap;
+
 /*
 =======================
-SV_SendClientDatagram
+SV_BeginClientDatagram
 =======================
 */
-void SV_SendClientDatagram( sv_client_t *cl )
+static void SV_BeginClientDatagram( sv_client_t *cl, sizebuf_t *msg )
 {
-	byte    	msg_buf[NET_MAX_PAYLOAD];
-	sizebuf_t	msg;
-
 	svs.currentPlayer = cl;
 	svs.currentPlayerNum = (cl - svs.clients);
 
-	Q_memset( msg_buf, 0, NET_MAX_PAYLOAD );
-	BF_Init( &msg, "Datagram", msg_buf, sizeof( msg_buf ));
-
 	// always send servertime at new frame
-	BF_WriteByte( &msg, svc_time );
-	BF_WriteFloat( &msg, sv.time );
+	BF_WriteByte( msg, svc_time );
+	BF_WriteFloat( msg, sv.time );
 
-	SV_WriteClientdataToMessage( cl, &msg );
-	SV_WriteEntitiesToClient( cl, &msg );
+	SV_WriteClientdataToMessage( cl, msg );
+}
 
+/*
+=======================
+SV_FinishClientDatagram
+=======================
+*/
+static void SV_FinishClientDatagram( sv_client_t *cl, sizebuf_t *msg )
+{
 	// copy the accumulated multicast datagram
 	// for this client out to the message
 	if( BF_CheckOverflow( &cl->datagram )) MsgDev( D_WARN, "datagram overflowed for %s\n", cl->name );
-	else BF_WriteBits( &msg, BF_GetData( &cl->datagram ), BF_GetNumBitsWritten( &cl->datagram ));
+	else BF_WriteBits( msg, BF_GetData( &cl->datagram ), BF_GetNumBitsWritten( &cl->datagram ));
 	BF_Clear( &cl->datagram );
 
-	if( BF_CheckOverflow( &msg ))
+	if( BF_CheckOverflow( msg ))
 	{	
 		// must have room left for the packet header
 		MsgDev( D_WARN, "msg overflowed for %s\n", cl->name );
-		BF_Clear( &msg );
+		BF_Clear( msg );
 	}
 
 	// send the datagram
-	Netchan_TransmitBits( &cl->netchan, BF_GetNumBitsWritten( &msg ), BF_GetData( &msg ));
+	Netchan_TransmitBits( &cl->netchan, BF_GetNumBitsWritten( msg ), BF_GetData( msg ));
+}
+
+/*
+=======================
+SV_SendClientDatagram
+=======================
+*/
+static void SV_SendClientDatagram( sv_client_t *cl )
+{
+	byte    	msg_buf[NET_MAX_PAYLOAD];
+	client_frame_t	*frame;
+	qboolean		send_pings;
+	sizebuf_t	msg;
+	double		start, end;
+
+	Q_memset( msg_buf, 0, NET_MAX_PAYLOAD );
+	BF_Init( &msg, "Datagram", msg_buf, sizeof( msg_buf ));
+
+	start = Sys_DoubleTime();
+
+	SV_BeginClientDatagram( cl, &msg );
+	frame = SV_BuildClientFrame( cl, &send_pings );
+
+	end = Sys_DoubleTime();
+	sv_snap.build_time += end - start;
+	start = end;
+
+	if( frame ) SV_WriteClientFrame( cl, SV_DeltaFrame( cl ), frame, send_pings, &msg );
+
+	end = Sys_DoubleTime();
+	sv_snap.encode_time += end - start;
+	start = end;
+
+	SV_FinishClientDatagram( cl, &msg );
+
+	sv_snap.send_time += Sys_DoubleTime() - start;
+}
+
+/*
+=======================
+SV_QueueClientDatagram
+
+runs the serial part of the update into the
+client's own buffer, encoding is done later
+=======================
+*/
+static void SV_QueueClientDatagram( sv_client_t *cl )
+{
+	sv_snapshot_t	*snap;
+	int		i;
+
+	if( sv_snap.numsnapshots != sv_maxclients->integer )
+	{
+		SV_FreeClientSnapshots();
+
+		sv_snap.numsnapshots = sv_maxclients->integer;
+		sv_snap.snapshots = Z_Malloc( sizeof( sv_snapshot_t ) * sv_snap.numsnapshots );
+		sv_snap.buffers = Z_Malloc( NET_MAX_PAYLOAD * sv_snap.numsnapshots );
+	}
+
+	i = cl - svs.clients;
+	snap = &sv_snap.snapshots[i];
+
+	snap->cl = cl;
+	snap->from = NULL;
+	BF_Init( &snap->msg, "Datagram", sv_snap.buffers + i * NET_MAX_PAYLOAD, NET_MAX_PAYLOAD );
+
+	SV_BeginClientDatagram( cl, &snap->msg );
+	snap->to = SV_BuildClientFrame( cl, &snap->send_pings );
+}
+
+/*
+=======================
+SV_EncodeSnapshotJob
+=======================
+*/
+static void SV_EncodeSnapshotJob( void *data, int index )
+{
+	sv_snapshot_t	*snap = ((sv_snapshot_t **)data)[index];
+
+	SV_WriteClientFrame( snap->cl, snap->from, snap->to, snap->send_pings, &snap->msg );
+}
+
+/*
+=======================
+SV_FlushClientDatagrams
+
+encodes queued frames on worker threads
+and sends them in the client order
+=======================
+*/
+static void SV_FlushClientDatagrams( sv_client_t **queued, int numqueued )
+{
+	sv_snapshot_t	*jobs[MAX_CLIENTS];
+	sv_snapshot_t	*snap;
+	int		i, numjobs;
+	double		start;
+
+	start = Sys_DoubleTime();
+
+	// all frames are in svs.packet_entities now, so
+	// out of date check accounts every client's frame
+	for( i = numjobs = 0; i < numqueued; i++ )
+	{
+		snap = &sv_snap.snapshots[queued[i] - svs.clients];
+		if( !snap->to ) continue;
+
+		snap->from = SV_DeltaFrame( snap->cl );
+		jobs[numjobs++] = snap;
+	}
+
+	if( !sv_snap.encodelock )
+		sv_snap.encodelock = Sys_CreateMutex();
+
+	Delta_SetEncodeLock( sv_snap.encodelock );
+	Sys_RunJobs( SV_EncodeSnapshotJob, jobs, numjobs );
+	Delta_SetEncodeLock( NULL );
+
+	sv_snap.encode_time += Sys_DoubleTime() - start;
+	start = Sys_DoubleTime();
+
+	for( i = 0; i < numqueued; i++ )
+	{
+		snap = &sv_snap.snapshots[queued[i] - svs.clients];
+
+		svs.currentPlayer = snap->cl;
+		svs.currentPlayerNum = (snap->cl - svs.clients);
+
+		SV_FinishClientDatagram( snap->cl, &snap->msg );
+	}
+
+	sv_snap.send_time += Sys_DoubleTime() - start;
+}
+
+/*
+=======================
+SV_FreeClientSnapshots
+=======================
+*/
+void SV_FreeClientSnapshots( void )
+{
+	// Host_Error from encoding jobs leaves it set
+	Delta_SetEncodeLock( NULL );
+
+	if( sv_snap.snapshots ) Mem_Free( sv_snap.snapshots );
+	if( sv_snap.buffers ) Mem_Free( sv_snap.buffers );
+
+	sv_snap.snapshots = NULL;
+	sv_snap.buffers = NULL;
+	sv_snap.numsnapshots = 0;
+}
+
+/*
+=======================
+SV_SnapshotStats_f
+=======================
+*/
+void SV_SnapshotStats_f( void )
+{
+	sv_snapshothist_t	*h;
+	int		i, frames = 0;
+	int		updates = 0;
+	double		total;
+
+	if( Cmd_Argc() > 1 && !Q_stricmp( Cmd_Argv( 1 ), "reset" ))
+	{
+		Q_memset( sv_snap.hist, 0, sizeof( sv_snap.hist ));
+		sv_snap.build_time = sv_snap.encode_time = sv_snap.send_time = 0.0;
+		return;
+	}
+
+	Msg( "snapshots: %s, %i threads\n", sv_threaded_snapshots->integer ? "threaded" : "serial",
+		sv_threaded_snapshots->integer ? Sys_NumJobThreads() : 1 );
+	Msg( "clients  frames   avg msec\n" );
+
+	for( i = 1, h = &sv_snap.hist[1]; i <= MAX_CLIENTS; i++, h++ )
+	{
+		if( !h->frames ) continue;
+		Msg( "%7i %7i %10.3f\n", i, h->frames, h->time * 1000.0 / h->frames );
+		frames += h->frames;
+		updates += h->frames * i;
+	}
+
+	if( !frames ) return;
+
+	total = sv_snap.build_time + sv_snap.encode_time + sv_snap.send_time;
+	if( total <= 0.0 ) return;
+
+	Msg( "build %.3f msec per client\n", sv_snap.build_time * 1000.0 / updates );
+	Msg( "build %.1f%%, encode %.1f%%, transmit %.1f%%\n",
+		sv_snap.build_time * 100.0 / total,
+		sv_snap.encode_time * 100.0 / total,
+		sv_snap.send_time * 100.0 / total );
 }
 
 /*
@@ -737,8 +1516,11 @@ SV_SendClientMessages
 */
 void SV_SendClientMessages( void )
 {
+	sv_client_t	*queued[MAX_CLIENTS];
 	sv_client_t	*cl;
-	int		i;
+	int		i, numqueued = 0;
+	qboolean		threaded;
+	double		start, build_start;
 
 	svs.currentPlayer = NULL;
 	svs.currentPlayerNum = 0;
@@ -746,8 +1528,17 @@ void SV_SendClientMessages( void )
 	if( sv.state == ss_dead )
 		return;
 
+	start = Sys_DoubleTime();
+	SV_ClearPackCache();
+	SV_ClearDeltaCache();
+	SV_SetupLeafVisibility();
+	threaded = ( sv_threaded_snapshots->integer && sv_maxclients->integer > 1 );
+
 	SV_UpdateToReliableMessages ();
 
+	// flush all client datagrams at once
+	NET_BeginSendBatch();
+
 	// send a message to each connected client
 	for( i = 0, cl = svs.clients; i < sv_maxclients->integer; i++, cl++ )
 	{
@@ -817,7 +1608,15 @@ void SV_SendClientMessages( void )
 
 		if( cl->state == cs_spawned )
 		{
-			SV_SendClientDatagram( cl );
+			if( threaded )
+			{
+				build_start = Sys_DoubleTime();
+				SV_QueueClientDatagram( cl );
+				sv_snap.build_time += Sys_DoubleTime() - build_start;
+				queued[numqueued] = cl;
+			}
+			else SV_SendClientDatagram( cl );
+			numqueued++;
 		}
 		else
 		{
@@ -826,6 +1625,18 @@ void SV_SendClientMessages( void )
 		}
 	}
 
+	if( threaded && numqueued )
+		SV_FlushClientDatagrams( queued, numqueued );
+
+	NET_EndSendBatch();
+
+	if( numqueued )
+	{
+		numqueued = min( numqueued, MAX_CLIENTS );
+		sv_snap.hist[numqueued].frames++;
+		sv_snap.hist[numqueued].time += Sys_DoubleTime() - start;
+	}
+
 	// reset current client
 	svs.currentPlayer = NULL;
 	svs.currentPlayerNum = 0;
@@ -872,6 +872,8 @@ void SV_InitEdict( edict_t *pEdict )
 
 	pEdict->v.pContainingEntity = pEdict; // make cross-links for consistency
 	pEdict->free = false;
+
+	SV_LooseEdict( pEdict );
 }
 
 void SV_FreeEdict( edict_t *pEdict )
@@ -895,6 +897,7 @@ void SV_FreeEdict( edict_t *pEdict )
 	}
 
 	SV_FreePrivateData( pEdict );
+	SV_UnlinkLeafEdict( pEdict );
 
 	// NOTE: don't clear all edict fields on releasing
 	// because gamedll may trying to use edict pointers and crash game (e.g. Opposing Force)
@@ -1353,22 +1356,235 @@ void GAME_EXPORT pfnChangePitch( edict_t* ent )
 	ent->v.angles[PITCH] = SV_AngleMod( ent->v.idealpitch, ent->v.angles[PITCH], ent->v.pitch_speed );	
 }
 
+/*
+===============================================================================
+
+ENTITY STRING INDEX
+
+game dll writes entvars directly, so engine can't see the changes.
+a lookup takes the first edict of the hash bucket which still holds
+the value, then rehashes edicts between the start edict and that one,
+any of them may have got the value since. comparing string_t of these
+is much cheaper than comparing strings, the result is always the same
+as linear search gives. edicts of a hash bucket are kept sorted by
+number to preserve "next after pStartEdict" order
+
+===============================================================================
+*/
+#define ENTSTRING_HASHSIZE	1024
+
+typedef struct
+{
+	const char	*name;
+	int		offset;
+
+	string_t		*values;		// value edict was indexed by
+	int		*next;		// in bucket, -1 terminated
+	int		*prev;
+	word		*hash;
+	int		heads[ENTSTRING_HASHSIZE];
+} entstringfield_t;
+
+static struct
+{
+	entstringfield_t	fields[5];
+	int		maxedicts;
+	qboolean		valid;
+} entstrings =
+{
+	{
+	{ "classname", offsetof( entvars_t, classname ) },
+	{ "targetname", offsetof( entvars_t, targetname ) },
+	{ "target", offsetof( entvars_t, target ) },
+	{ "globalname", offsetof( entvars_t, globalname ) },
+	{ "netname", offsetof( entvars_t, netname ) },
+	},
+};
+
 /*
 =========
-SV_FindEntityByString
+SV_ClearEntityStrings
 
+string_t values may be reused for other strings
 =========
 */
-edict_t* GAME_EXPORT SV_FindEntityByString( edict_t *pStartEdict, const char *pszField, const char *pszValue )
+static void SV_ClearEntityStrings( void )
+{
+	entstrings.valid = false;
+}
+
+/*
+=========
+SV_ResetEntityStrings
+=========
+*/
+static void SV_ResetEntityStrings( void )
 {
-	int		index = 0, e = 0;
+	entstringfield_t	*f;
+	int		i;
+
+	for( i = 0, f = entstrings.fields; i < ARRAYSIZE( entstrings.fields ); i++, f++ )
+	{
+		if( entstrings.maxedicts != GI->max_edicts )
+		{
+			if( f->values ) Mem_Free( f->values );
+			if( f->next ) Mem_Free( f->next );
+			if( f->prev ) Mem_Free( f->prev );
+			if( f->hash ) Mem_Free( f->hash );
+
+			f->values = Z_Malloc( sizeof( string_t ) * GI->max_edicts );
+			f->next = Z_Malloc( sizeof( int ) * GI->max_edicts );
+			f->prev = Z_Malloc( sizeof( int ) * GI->max_edicts );
+			f->hash = Z_Malloc( sizeof( word ) * GI->max_edicts );
+		}
+
+		Q_memset( f->values, 0, sizeof( string_t ) * GI->max_edicts );
+		Q_memset( f->heads, -1, sizeof( f->heads ));
+	}
+
+	entstrings.maxedicts = GI->max_edicts;
+	entstrings.valid = true;
+}
+
+/*
+=========
+SV_IndexEntityString
+
+rehash edict if its field was changed
+=========
+*/
+static void SV_IndexEntityString( entstringfield_t *f, int e )
+{
+	string_t	value;
+	int	link;
+
+	value = *(string_t *)((byte *)&svgame.edicts[e].v + f->offset );
+	if( value == f->values[e] ) return;
+
+	// remove from old bucket
+	if( f->values[e] )
+	{
+		if( f->prev[e] != -1 ) f->next[f->prev[e]] = f->next[e];
+		else f->heads[f->hash[e]] = f->next[e];
+		if( f->next[e] != -1 ) f->prev[f->next[e]] = f->prev[e];
+	}
+
+	f->values[e] = value;
+	if( !value ) return;
+
+	// insert sorted by edict number
+	f->hash[e] = Com_HashKey( STRING( value ), ENTSTRING_HASHSIZE );
+	f->prev[e] = -1;
+
+	for( link = f->heads[f->hash[e]]; link != -1 && link < e; link = f->next[link] )
+		f->prev[e] = link;
+
+	f->next[e] = link;
+	if( link != -1 ) f->prev[link] = e;
+	if( f->prev[e] != -1 ) f->next[f->prev[e]] = e;
+	else f->heads[f->hash[e]] = e;
+}
+
+/*
+=========
+SV_MatchEntityString
+
+edict may be returned by search
+=========
+*/
+static qboolean SV_MatchEntityString( entstringfield_t *f, int e, const char *pszValue )
+{
+	edict_t	*ed = &svgame.edicts[e];
+	string_t	value;
+
+	if( !SV_IsValidEdict( ed ))
+		return false;
+
+	if( sv_maxclients->integer != 1 && e <= sv_maxclients->integer && !SV_SpawnedClient( e ))
+		return false;
+
+	// field may be changed since it was hashed
+	value = *(string_t *)((byte *)&ed->v + f->offset );
+
+	return ( value && !Q_strcmp( STRING( value ), pszValue ));
+}
+
+/*
+=========
+SV_FindEntityByIndexedString
+
+returns NULL if field is not indexed
+=========
+*/
+static edict_t *SV_FindEntityByIndexedString( int start, const char *pszField, const char *pszValue )
+{
+	entstringfield_t	*f;
+	string_t		value;
+	int		i, e, x, hash;
+
+	if( svgame.physFuncs.pfnAllocString != NULL || svgame.physFuncs.pfnMakeString != NULL )
+		return NULL;	// don't know how custom pool reuses strings
+
+	for( i = 0, f = entstrings.fields; i < ARRAYSIZE( entstrings.fields ); i++, f++ )
+	{
+		if( !Q_strcmp( pszField, f->name ))
+			break;
+	}
+
+	if( i == ARRAYSIZE( entstrings.fields ))
+		return NULL;
+
+	if( !entstrings.valid || entstrings.maxedicts != GI->max_edicts )
+		SV_ResetEntityStrings();
+
+	hash = Com_HashKey( pszValue, ENTSTRING_HASHSIZE );
+
+	// continue right after start edict if it's in this bucket
+	if( start > 0 && start < svgame.numEntities && f->values[start] && f->hash[start] == hash )
+		e = f->next[start];
+	else for( e = f->heads[hash]; e != -1 && e <= start; e = f->next[e] );
+
+	for( ; e != -1 && e < svgame.numEntities; e = f->next[e] )
+	{
+		if( SV_MatchEntityString( f, e, pszValue ))
+			break;
+	}
+
+	if( e == -1 || e >= svgame.numEntities )
+		e = svgame.numEntities;
+
+	// edicts before the hit may have got the value since they were hashed
+	for( x = max( start, 0 ) + 1; x < e; x++ )
+	{
+		value = *(string_t *)((byte *)&svgame.edicts[x].v + f->offset );
+		if( value == f->values[x] ) continue;
+
+		SV_IndexEntityString( f, x );
+
+		if( SV_MatchEntityString( f, x, pszValue ))
+			return &svgame.edicts[x];
+	}
+
+	if( e < svgame.numEntities )
+		return &svgame.edicts[e];
+
+	return svgame.edicts;
+}
+
+/*
+=========
+SV_FindEntityByFieldString
+
+linear search through entvars description
+=========
+*/
+static edict_t *SV_FindEntityByFieldString( int e, const char *pszField, const char *pszValue )
+{
+	int		index = 0;
 	TYPEDESCRIPTION	*desc = NULL;
 	edict_t		*ed;
 	const char	*t;
 
-	if( pStartEdict ) e = NUM_FOR_EDICT( pStartEdict );
-	if( !pszValue || !*pszValue ) return svgame.edicts;
-
 	while(( desc = SV_GetEntvarsDescirption( index++ )) != NULL )
 	{
 		if( !Q_strcmp( pszField, desc->fieldName ))
@@ -1386,7 +1602,7 @@ edict_t* GAME_EXPORT SV_FindEntityByString( edict_t *pStartEdict, const char *ps
 		ed = EDICT_NUM( e );
 		if( !SV_IsValidEdict( ed )) continue;
 
-		if( e <= sv_maxclients->integer && !SV_ClientFromEdict( ed, ( sv_maxclients->integer != 1 )))
+		if( sv_maxclients->integer != 1 && e <= sv_maxclients->integer && !SV_SpawnedClient( e ))
 			continue;
 
 		switch( desc->fieldType )
@@ -1409,6 +1625,37 @@ edict_t* GAME_EXPORT SV_FindEntityByString( edict_t *pStartEdict, const char *ps
 	return svgame.edicts;
 }
 
+/*
+=========
+SV_FindEntityByString
+
+=========
+*/
+edict_t* GAME_EXPORT SV_FindEntityByString( edict_t *pStartEdict, const char *pszField, const char *pszValue )
+{
+	edict_t	*ed, *indexed = NULL;
+	int	e = 0;
+
+	if( pStartEdict ) e = NUM_FOR_EDICT( pStartEdict );
+	if( !pszValue || !*pszValue ) return svgame.edicts;
+
+	if( sv_entstringindex->integer && ( indexed = SV_FindEntityByIndexedString( e, pszField, pszValue )) != NULL )
+	{
+		if( sv_entstringindex->integer != 2 )
+			return indexed;
+	}
+
+	ed = SV_FindEntityByFieldString( e, pszField, pszValue );
+
+	if( indexed && indexed != ed )
+	{
+		MsgDev( D_WARN, "SV_FindEntityByString: index found %i instead of %i for %s \"%s\"\n",
+			NUM_FOR_EDICT( indexed ), NUM_FOR_EDICT( ed ), pszField, pszValue );
+	}
+
+	return ed;
+}
+
 /*
 ==============
 pfnGetEntityIllum
@@ -1429,17 +1676,29 @@ int GAME_EXPORT pfnGetEntityIllum( edict_t* pEnt )
 
 /*
 =================
-pfnFindEntityInSphere
+SV_FindEntityInSphere
 
-return NULL instead of world!
+candidates come from the edict grid when usegrid is set
 =================
 */
-edict_t *GAME_EXPORT pfnFindEntityInSphere( edict_t *pStartEdict, const float *org, float flRadius )
+static edict_t *SV_FindEntityInSphere( edict_t *pStartEdict, const float *org, float flRadius, qboolean usegrid )
 {
-	edict_t	*ent;
-	float	distSquared;
-	float	eorg;
-	int	j, e = 0;
+	const byte	*marks = NULL;
+	vec3_t		mins, maxs;
+	edict_t		*ent;
+	float		distSquared;
+	float		eorg;
+	int		j, e = 0;
+
+	if( usegrid )
+	{
+		for( j = 0; j < 3; j++ )
+		{
+			mins[j] = org[j] - flRadius;
+			maxs[j] = org[j] + flRadius;
+		}
+		marks = SV_EdictsInBox( mins, maxs );
+	}
 
 	flRadius *= flRadius;
 
@@ -1448,13 +1707,20 @@ edict_t *GAME_EXPORT pfnFindEntityInSphere( edict_t *pStartEdict, const float *o
 
 	for( e++; e < svgame.numEntities; e++ )
 	{
+		if( marks && !( marks[e >> 3] & ( 1U << ( e & 7 ))))
+		{
+			// skip empty bytes at once
+			if( !marks[e >> 3] ) e |= 7;
+			continue;
+		}
+
 		ent = EDICT_NUM( e );
 
 		if( !SV_IsValidEdict( ent ))
 			continue;
 
 		// ignore clients that not in a game
-		if( e <= sv_maxclients->integer && !SV_ClientFromEdict( ent, true ))
+		if( e <= sv_maxclients->integer && !SV_SpawnedClient( e ))
 			continue;
 
 		distSquared = 0.0f;
@@ -1478,6 +1744,78 @@ edict_t *GAME_EXPORT pfnFindEntityInSphere( edict_t *pStartEdict, const float *o
 	return EDICT_NUM( 0 );
 }
 
+/*
+=================
+pfnFindEntityInSphere
+
+return NULL instead of world!
+=================
+*/
+edict_t *GAME_EXPORT pfnFindEntityInSphere( edict_t *pStartEdict, const float *org, float flRadius )
+{
+	return SV_FindEntityInSphere( pStartEdict, org, flRadius, true );
+}
+
+/*
+=================
+SV_SphereBench_f
+
+compares grid and linear search around every edict
+=================
+*/
+void SV_SphereBench_f( void )
+{
+	double	start, gridtime, lineartime;
+	edict_t	*ent, *a, *b;
+	int	i, e, passes, found;
+	int	mismatches = 0;
+	float	radius;
+
+	if( sv.state != ss_active )
+	{
+		Msg( "sv_spherebench: server is not running\n" );
+		return;
+	}
+
+	radius = ( Cmd_Argc() > 1 ) ? Q_atof( Cmd_Argv( 1 )) : 256.0f;
+	passes = ( Cmd_Argc() > 2 ) ? Q_atoi( Cmd_Argv( 2 )) : 10;
+	passes = max( passes, 1 );
+
+	gridtime = lineartime = 0.0;
+	found = 0;
+
+	for( i = 0; i < passes; i++ )
+	{
+		for( e = 1; e < svgame.numEntities; e++ )
+		{
+			ent = EDICT_NUM( e );
+			if( ent->free ) continue;
+
+			start = Sys_DoubleTime();
+			for( a = SV_FindEntityInSphere( NULL, ent->v.origin, radius, true ); a != svgame.edicts; a = SV_FindEntityInSphere( a, ent->v.origin, radius, true ))
+				found++;
+			gridtime += Sys_DoubleTime() - start;
+
+			start = Sys_DoubleTime();
+			for( b = SV_FindEntityInSphere( NULL, ent->v.origin, radius, false ); b != svgame.edicts; b = SV_FindEntityInSphere( b, ent->v.origin, radius, false ));
+			lineartime += Sys_DoubleTime() - start;
+
+			// verify order
+			a = b = NULL;
+			do
+			{
+				a = SV_FindEntityInSphere( a, ent->v.origin, radius, true );
+				b = SV_FindEntityInSphere( b, ent->v.origin, radius, false );
+				if( a != b ) mismatches++;
+			} while( a == b && a != svgame.edicts );
+		}
+	}
+
+	Msg( "%i edicts, radius %g, %i passes, %i found\n", svgame.numEntities, radius, passes, found );
+	Msg( "grid %.3f msec, linear %.3f msec\n", gridtime * 1000.0, lineartime * 1000.0 );
+	if( mismatches ) Msg( "^1%i mismatches^7\n", mismatches );
+}
+
 /*
 =================
 SV_CheckClientPVS
@@ -2327,10 +2665,14 @@ NOTE: speed is unused
 */
 void GAME_EXPORT pfnGetAimVector( edict_t* ent, float speed, float *rgflReturn )
 {
+	static tracereq_t	*req;
+	static trace_t	*res;
+	static edict_t	**aim;
+	static int	maxaims;
 	edict_t		*check;
 	vec3_t		start, dir, end, bestdir;
 	float		dist, bestdist;
-	int		i, j;
+	int		i, j, numaims;
 	trace_t		tr;
 
 	VectorCopy( svgame.globals->v_forward, rgflReturn );	// assume failure if it returns early
@@ -2349,9 +2691,21 @@ void GAME_EXPORT pfnGetAimVector( edict_t* ent, float speed, float *rgflReturn )
 	if( tr.ent && (tr.ent->v.takedamage == DAMAGE_AIM || ent->v.team <= 0 || ent->v.team != tr.ent->v.team ))
 		return;
 
+	if( maxaims < svgame.numEntities )
+	{
+		if( req ) Mem_Free( req );
+		if( res ) Mem_Free( res );
+		if( aim ) Mem_Free( aim );
+		maxaims = max( GI->max_edicts, svgame.numEntities );
+		req = Z_Malloc( maxaims * sizeof( tracereq_t ));
+		res = Z_Malloc( maxaims * sizeof( trace_t ));
+		aim = Z_Malloc( maxaims * sizeof( edict_t* ));
+	}
+
 	// try all possible entities
 	VectorCopy( dir, bestdir );
 	bestdist = Cvar_VariableValue( "sv_aim" );
+	numaims = 0;
 
 	check = EDICT_NUM( 1 ); // start at first client
 	for( i = 1; i < svgame.numEntities; i++, check++ )
@@ -2366,12 +2720,32 @@ void GAME_EXPORT pfnGetAimVector( edict_t* ent, float speed, float *rgflReturn )
 		VectorNormalize( dir );
 		dist = DotProduct( dir, svgame.globals->v_forward );
 		if( dist < bestdist ) continue; // to far to turn
-		tr = SV_Move( start, vec3_origin, vec3_origin, end, MOVE_NORMAL, ent );
-		if( tr.ent == check )
-		{	
-			bestdist = dist;
-			VectorCopy( dir, bestdir );
-		}
+
+		VectorCopy( start, req[numaims].start );
+		VectorCopy( end, req[numaims].end );
+		VectorClear( req[numaims].mins );
+		VectorClear( req[numaims].maxs );
+		req[numaims].type = MOVE_NORMAL;
+		req[numaims].pentIgnore = ent;
+		aim[numaims++] = check;
+	}
+
+	// all candidates start from the eye, so they share most of the area walk
+	SV_MoveBatch( req, res, numaims, 0 );
+
+	for( i = 0; i < numaims; i++ )
+	{
+		if( res[i].ent != aim[i] )
+			continue;
+
+		VectorSubtract( req[i].end, start, dir );
+		VectorNormalize( dir );
+		dist = DotProduct( dir, svgame.globals->v_forward );
+
+		// same as picking while tracing, last of equally good wins
+		if( dist < bestdist ) continue;
+		bestdist = dist;
+		VectorCopy( dir, bestdir );
 	}
 
 	VectorCopy( bestdir, rgflReturn );
@@ -3001,7 +3375,118 @@ static struct str64_s
 	size_t numdups;
 	size_t numoverflows;
 	size_t totalalloc;
+
+	// hash of strings between poldstringbase and plast
+	int *hashtable;	// offsets from pstringarray, 0 is empty slot
+	size_t hashsize;	// power of two
+	size_t hashcount;
+	size_t numlookups;
+	size_t numprobes;
+	size_t maxprobes;
 } str64;
+
+#define STR64_HASHSIZE	4096	// initial slots
+
+/*
+==================
+Str64_HashString
+==================
+*/
+static uint32_t Str64_HashString( const char *s )
+{
+	uint32_t	hash = 2166136261U;
+
+	while( *s )
+	{
+		hash ^= (byte)*s++;
+		hash *= 16777619U;
+	}
+
+	return hash;
+}
+
+/*
+==================
+Str64_ClearHash
+
+strings are going to be overwritten
+==================
+*/
+static void Str64_ClearHash( void )
+{
+	if( str64.hashtable )
+		Q_memset( str64.hashtable, 0, sizeof( int ) * str64.hashsize );
+	str64.hashcount = 0;
+}
+
+/*
+==================
+Str64_InsertHash
+==================
+*/
+static void Str64_InsertHash( const char *string )
+{
+	size_t	i;
+
+	i = Str64_HashString( string ) & ( str64.hashsize - 1 );
+	while( str64.hashtable[i] )
+		i = ( i + 1 ) & ( str64.hashsize - 1 );
+
+	str64.hashtable[i] = string - str64.pstringarray;
+	str64.hashcount++;
+}
+
+/*
+==================
+Str64_GrowHash
+
+keep load under a half
+==================
+*/
+static void Str64_GrowHash( void )
+{
+	int	*old = str64.hashtable;
+	size_t	i, oldsize = str64.hashsize;
+
+	str64.hashsize = oldsize ? oldsize * 2 : STR64_HASHSIZE;
+	str64.hashtable = Mem_Alloc( host.mempool, sizeof( int ) * str64.hashsize );
+	str64.hashcount = 0;
+
+	for( i = 0; i < oldsize; i++ )
+	{
+		if( old[i] ) Str64_InsertHash( str64.pstringarray + old[i] );
+	}
+
+	if( old ) Mem_Free( old );
+}
+
+/*
+==================
+Str64_FindString
+==================
+*/
+static const char *Str64_FindString( const char *string )
+{
+	size_t	i, probes = 1;
+	const char	*s;
+
+	if( !str64.hashtable )
+		return NULL;
+
+	str64.numlookups++;
+
+	for( i = Str64_HashString( string ) & ( str64.hashsize - 1 ); str64.hashtable[i]; i = ( i + 1 ) & ( str64.hashsize - 1 ), probes++ )
+	{
+		s = str64.pstringarray + str64.hashtable[i];
+		if( !Q_strcmp( s, string ))
+			break;
+	}
+
+	str64.numprobes += probes;
+	str64.maxprobes = max( str64.maxprobes, probes );
+
+	return str64.hashtable[i] ? str64.pstringarray + str64.hashtable[i] : NULL;
+}
 #endif
 
 /*
@@ -3020,10 +3505,12 @@ void SV_EmptyStringPool( void )
 	{
 		str64.pstringbase = str64.poldstringbase = str64.pstringarraystatic;
 		str64.plast = str64.pstringbase + 1;
+		Str64_ClearHash();
 	}
 #else
 	Mem_EmptyPool( svgame.stringspool );
 #endif
+	SV_ClearEntityStrings();
 }
 
 /*
@@ -3156,6 +3643,11 @@ void SV_FreeStringPool( void )
 	else
 #endif // USE_MMAP
 		Mem_Free( str64.staticstringarray );
+
+	if( str64.hashtable )
+		Mem_Free( str64.hashtable );
+	str64.hashtable = NULL;
+	str64.hashsize = str64.hashcount = 0;
 #else
 	Mem_FreePool( &svgame.stringspool );
 #endif
@@ -3167,6 +3659,7 @@ SV_AllocString
 
 allocate new engine string
 on 64bit platforms find in array string if deduplication enabled (default)
+using hash of strings added since last array wrap
 if not found, add to array
 use -str64dup to disable deduplication, -str64alloc to set array size
 =============
@@ -3178,20 +3671,22 @@ string_t GAME_EXPORT SV_AllocString( const char *szValue )
 	if( svgame.physFuncs.pfnAllocString != NULL )
 		return svgame.physFuncs.pfnAllocString( szValue );
 #ifdef XASH_64BIT
-	int cmp = 1;
-
 	if( !str64.allowdup )
-		for( newString = str64.poldstringbase + 1; newString < str64.plast && ( cmp = Q_strcmp( newString, szValue ) ); newString += Q_strlen( newString ) + 1 );
+		newString = Str64_FindString( szValue );
 
-	if( cmp )
+	if( !newString )
 	{
 		uint32_t len = Q_strlen( szValue );
 
 		if( str64.plast - str64.poldstringbase + len + 2 > str64.maxstringarray )
 		{
+			MsgDev( D_ERROR, "SV_AllocString: string array overflow, older strings will be overwritten (use -str64alloc, now %lu)\n", str64.maxstringarray );
+
 			str64.plast = str64.pstringbase + 1;
 			str64.poldstringbase = str64.pstringbase;
 			str64.numoverflows++;
+			Str64_ClearHash();
+			SV_ClearEntityStrings();
 		}
 
 		//MsgDev( D_NOTE, "SV_AllocString: %ld %s\n", str64.plast - svgame.globals->pStringBase, szValue );
@@ -3200,6 +3695,13 @@ string_t GAME_EXPORT SV_AllocString( const char *szValue )
 
 		newString = str64.plast;
 		str64.plast += len + 1;
+
+		if( !str64.allowdup )
+		{
+			if(( str64.hashcount + 1 ) * 2 > str64.hashsize )
+				Str64_GrowHash();
+			Str64_InsertHash( newString );
+		}
 	}
 	else
 		str64.numdups++;
@@ -3226,6 +3728,10 @@ void SV_PrintStr64Stats_f( void )
 	Msg( "maximum array usage: %lu\n", str64.maxalloc );
 	Msg( "overflow counter: %lu\n", str64.numoverflows );
 	Msg( "dup string counter: %lu\n", str64.numdups );
+	Msg( "hash size: %lu, strings: %lu, load %.1f%%\n", str64.hashsize, str64.hashcount,
+		str64.hashsize ? str64.hashcount * 100.0 / str64.hashsize : 0.0 );
+	Msg( "hash lookups: %lu, average probes %.2f, max probes %lu\n", str64.numlookups,
+		str64.numlookups ? (double)str64.numprobes / str64.numlookups : 0.0, str64.maxprobes );
 }
 #endif
 
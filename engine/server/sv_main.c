@@ -92,6 +92,17 @@ convar_t	*sv_trace_messages;
 convar_t	*sv_corpse_solid;
 convar_t	*sv_fixmulticast;
 convar_t	*sv_allow_split;
+convar_t	*sv_threaded_snapshots;
+convar_t	*sv_packcache;
+convar_t	*sv_pvsindex;
+convar_t	*sv_deltacache;
+convar_t	*sv_deltacache_size;
+convar_t	*sv_entstringindex;
+convar_t	*sv_tracecache;
+convar_t	*sv_clipbounds;
+convar_t	*sv_adaptive_areanodes;
+convar_t	*sv_physentcache;
+convar_t	*sv_threaded_physics;
 convar_t	*sv_allow_compress;
 convar_t	*sv_maxpacket;
 convar_t	*sv_forcesimulating;
@@ -360,7 +371,7 @@ SV_ReadPackets
 void SV_ReadPackets( void )
 {
 	sv_client_t	*cl;
-	int		i, qport;
+	int		qport;
 	size_t curSize;
 
 	while( NET_GetPacket( NS_SERVER, &net_from, net_message_buffer, &curSize ))
@@ -392,21 +403,10 @@ void SV_ReadPackets( void )
 
 			// find client with this address and enabled netsplit
 			// netsplit packets does not allow changing ports
-
-			for( i = 0, cl = svs.clients; i < sv_maxclients->integer; i++, cl++ )
-			{
-				if( cl->state == cs_free || cl->fakeclient )
-					continue;
-
-				if( !NET_CompareBaseAdr( net_from, cl->netchan.remote_address ))
-					continue;
-
-				if( !cl->netchan.split )
-					continue;
-			}
+			cl = SV_SplitClientFromAddress( net_from );
 
 			// not a client
-			if( i >= sv_maxclients->integer )
+			if( !cl )
 			{
 				MsgDev( D_INFO, "netsplit from unknown addr %s\n", NET_AdrToString( net_from ) );
 				Netchan_OutOfBandPrint( NS_SERVER, net_from, "disconnect\n" );
@@ -436,61 +436,49 @@ void SV_ReadPackets( void )
 		qport = (int)BF_ReadShort( &net_message ) & 0xffff;
 
 		// check for packets from connected clients
-		for( i = 0, cl = svs.clients; i < sv_maxclients->integer; i++, cl++ )
-		{
-			if( cl->state == cs_free || cl->fakeclient )
-				continue;
+		if(( cl = SV_ClientFromAddress( net_from, qport )) == NULL )
+			continue;
 
-			if( !NET_CompareBaseAdr( net_from, cl->netchan.remote_address ))
-				continue;
+		if( cl->netchan.remote_address.port != net_from.port )
+		{
+			MsgDev( D_INFO, "SV_ReadPackets: fixing up a translated port\n");
+			cl->netchan.remote_address.port = net_from.port;
+			SV_LinkClientAddress( cl );
+		}
 
-			if( cl->netchan.qport != qport )
-				continue;
+		if( Netchan_Process( &cl->netchan, &net_message ))
+		{
+			if( sv_maxclients->integer == 1 || cl->state != cs_spawned )
+				cl->send_message = true; // reply at end of frame
 
-			if( cl->netchan.remote_address.port != net_from.port )
+			// this is a valid, sequenced packet, so process it
+			if( cl->frames != NULL && cl->state != cs_zombie )
 			{
-				MsgDev( D_INFO, "SV_ReadPackets: fixing up a translated port\n");
-				cl->netchan.remote_address.port = net_from.port;
+				cl->lastmessage = host.realtime; // don't timeout
+				SV_ExecuteClientMessage( cl, &net_message );
+				svgame.globals->frametime = host.frametime;
+				svgame.globals->time = sv.time;
 			}
+		}
 
-			if( Netchan_Process( &cl->netchan, &net_message ))
+		// fragmentation/reassembly sending takes priority over all game messages, want this in the future?
+		if( Netchan_IncomingReady( &cl->netchan ))
+		{
+			if( Netchan_CopyNormalFragments( &cl->netchan, &net_message ))
 			{
-				if( sv_maxclients->integer == 1 || cl->state != cs_spawned )
-					cl->send_message = true; // reply at end of frame
+				BF_Clear( &net_message );
 
-				// this is a valid, sequenced packet, so process it
 				if( cl->frames != NULL && cl->state != cs_zombie )
 				{
-					cl->lastmessage = host.realtime; // don't timeout
 					SV_ExecuteClientMessage( cl, &net_message );
-					svgame.globals->frametime = host.frametime;
-					svgame.globals->time = sv.time;
 				}
 			}
 
-			// fragmentation/reassembly sending takes priority over all game messages, want this in the future?
-			if( Netchan_IncomingReady( &cl->netchan ))
+			if( Netchan_CopyFileFragments( &cl->netchan, &net_message ))
 			{
-				if( Netchan_CopyNormalFragments( &cl->netchan, &net_message ))
-				{
-					BF_Clear( &net_message );
-
-					if( cl->frames != NULL && cl->state != cs_zombie )
-					{
-						SV_ExecuteClientMessage( cl, &net_message );
-					}
-				}
-
-				if( Netchan_CopyFileFragments( &cl->netchan, &net_message ))
-				{
-					SV_ProcessFile( cl, cl->netchan.incomingfilename );
-				}
+				SV_ProcessFile( cl, cl->netchan.incomingfilename );
 			}
-			break;
 		}
-
-		if( i != sv_maxclients->integer )
-			continue;
 	}
 }
 
@@ -917,6 +905,17 @@ void SV_Init( void )
 	sv_fixmulticast = Cvar_Get( "sv_fixmulticast", "1", CVAR_ARCHIVE, "do not send multicast to not spawned clients" );
 	sv_allow_compress = Cvar_Get( "sv_allow_compress", DEFAULT_SV_ALLOWCOMPRESSION, CVAR_ARCHIVE, "allow Huffman compression on server" );
 	sv_allow_split= Cvar_Get( "sv_allow_split", "1", CVAR_ARCHIVE, "allow splitting packets on server" );
+	sv_threaded_snapshots = Cvar_Get( "sv_threaded_snapshots", "0", CVAR_ARCHIVE, "encode client snapshots on worker threads" );
+	sv_packcache = Cvar_Get( "sv_packcache", "0", CVAR_ARCHIVE, "share entity states between clients with the same visibility, only for mods whose AddToFullPack doesn't depend on the viewing player (no per-player effects, team or spectator filtering)" );
+	sv_deltacache = Cvar_Get( "sv_deltacache", "1", CVAR_ARCHIVE, "share encoded entity deltas between clients, 2 - compare with own encoding. only states shared by sv_packcache are shared" );
+	sv_deltacache_size = Cvar_Get( "sv_deltacache_size", "256", CVAR_ARCHIVE, "memory for shared entity deltas in kilobytes" );
+	sv_pvsindex = Cvar_Get( "sv_pvsindex", "1", CVAR_ARCHIVE, "find visible entities by PVS leafs, 2 - compare with full scan" );
+	sv_entstringindex = Cvar_Get( "sv_entstringindex", "1", CVAR_ARCHIVE, "use hashed index to find entities by classname, targetname, etc, 2 - verify against linear search" );
+	sv_tracecache = Cvar_Get( "sv_tracecache", "0", CVAR_ARCHIVE, "reuse results of identical traces within a frame" );
+	sv_clipbounds = Cvar_Get( "sv_clipbounds", "1", CVAR_ARCHIVE, "reject solid edicts by cached bounds before clipping" );
+	sv_adaptive_areanodes = Cvar_Get( "sv_adaptive_areanodes", "1", CVAR_ARCHIVE, "rebuild areanode tree around edict clusters" );
+	sv_physentcache = Cvar_Get( "sv_physentcache", "1", CVAR_ARCHIVE, "convert edicts to pmove physents once per frame" );
+	sv_threaded_physics = Cvar_Get( "sv_threaded_physics", "0", CVAR_ARCHIVE, "trace tossed edicts on worker threads, 2 - verify against serial traces" );
 	sv_maxpacket = Cvar_Get( "sv_maxpacket", "2000", CVAR_ARCHIVE, "limit cl_maxpacket for all clients" );
 	sv_forcesimulating = Cvar_Get( "sv_forcesimulating", DEFAULT_SV_FORCESIMULATING, 0, "forcing world simulating when server don't have active players" );
 	sv_nat = Cvar_Get( "sv_nat", "0", 0, "enable NAT bypass for this server" );
@@ -948,6 +947,16 @@ void SV_Init( void )
 
 	Cmd_AddCommand( "logaddress", SV_SetLogAddress_f, "sets address and port for remote logging host" );
 	Cmd_AddCommand( "log", SV_ServerLog_f, "enables logging to file" );
+	Cmd_AddCommand( "sv_snapshot_stats", SV_SnapshotStats_f, "show client snapshot timings, 'reset' to clear" );
+	Cmd_AddCommand( "sv_packcache_stats", SV_PackCacheStats_f, "show entity state cache hit rate, 'reset' to clear" );
+	Cmd_AddCommand( "sv_deltacache_stats", SV_DeltaCacheStats_f, "show shared entity delta hit rate, 'reset' to clear" );
+	Cmd_AddCommand( "sv_spherebench", SV_SphereBench_f, "time FindEntityInSphere with and without edict grid: <radius> <passes>" );
+	Cmd_AddCommand( "sv_tracecache_stats", SV_TraceCacheStats_f, "show trace cache hit rate, 'reset' to clear" );
+	Cmd_AddCommand( "sv_areanode_stats", SV_AreaNodeStats_f, "show areanode tree shape and edicts tested per trace, 'reset' to clear, 'spread [count]' to test rebuilds" );
+	Cmd_AddCommand( "sv_physent_stats", SV_PhysEntStats_f, "show pmove physent conversions per frame, 'reset' to clear" );
+	Cmd_AddCommand( "sv_physics_stats", SV_PrefetchStats_f, "show how many threaded physics traces were used, 'reset' to clear" );
+	Cmd_AddCommand( "delta_bench", Delta_Bench_f, "record entity deltas and time generic against compiled delta tables" );
+	Cmd_AddCommand( "sv_tracebench", SV_TraceBench_f, "replay recorded traces: record <count> | run <passes>" );
 
 #ifdef XASH_64BIT
 	Cmd_AddCommand( "str64stats", SV_PrintStr64Stats_f, "show 64 bit string pool stats" );
@@ -1050,6 +1059,21 @@ void SV_Shutdown( qboolean reconnect )
 		svs.clients = NULL;
 	}
 
+	SV_ClearClientAddresses();
+	SV_FreeClientSnapshots();
+	SV_FreePackCache();
+	SV_FreeDeltaCache();
+	SV_FreeLeafVisibility();
+	SV_FreeLeafEdicts();
+	SV_FreeEdictGrid();
+	SV_FreeTraceBench();
+	SV_FreeTraceBatch();
+	SV_FreeTraceCache();
+	SV_FreeAreaBounds();
+	SV_FreeAreaTree();
+	SV_FreePhysEntCache();
+	SV_FreePrefetch();
+
 	if( svs.baselines )
 	{
 		Mem_Free( svs.baselines );
@@ -21,6 +21,8 @@ GNU General Public License for more details.
 #include "gl_export.h"
 
 typedef int (*PHYSICAPI)( int, server_physics_api_t*, physics_interface_t* );
+
+#define PREFETCH_MIN_MOVES	16	// fewer moves are traced on main thread
 extern triangleapi_t gTriApi;
 
 /*
@@ -1525,6 +1527,193 @@ void SV_Physics_Toss( edict_t *ent )
 	SV_CheckWaterTransition( ent );
 }
 
+/*
+=============
+SV_VelocityInRange
+
+checked before guessing, so SV_CheckVelocity never
+has to fix (and report) a guessed velocity
+=============
+*/
+static qboolean SV_VelocityInRange( const vec3_t velocity )
+{
+	int	i;
+
+	for( i = 0; i < 3; i++ )
+	{
+		if( IS_NAN( velocity[i] ) || velocity[i] > sv_maxvelocity->value || velocity[i] < -sv_maxvelocity->value )
+			return false;
+	}
+
+	return true;
+}
+
+/*
+=============
+SV_PredictTossMove
+
+guess the first SV_PushEntity of SV_Physics_Toss without
+touching the edict. a wrong guess only wastes a trace
+=============
+*/
+static qboolean SV_PredictTossMove( edict_t *ent, tracereq_t *req )
+{
+	vec3_t	velocity, basevelocity, move;
+	edict_t	*ground;
+	float	ent_gravity;
+	int	flags;
+
+	if( ent->v.flags & FL_KILLME )
+		return false;
+
+	// think can change anything
+	if( ent->v.nextthink > 0.0f && ent->v.nextthink <= sv.time + host.frametime )
+		return false;
+
+	VectorCopy( ent->v.velocity, velocity );
+	VectorCopy( ent->v.basevelocity, basevelocity );
+	flags = ent->v.flags;
+
+	// SV_UpdateBaseVelocity
+	if( flags & FL_ONGROUND )
+	{
+		ground = ent->v.groundentity;
+
+		if( SV_IsValidEdict( ground ) && ground->v.flags & FL_CONVEYOR )
+		{
+			vec3_t	new_basevel;
+
+			VectorScale( ground->v.movedir, ground->v.speed, new_basevel );
+			if( flags & FL_BASEVELOCITY )
+				VectorAdd( new_basevel, basevelocity, new_basevel );
+
+			flags |= FL_BASEVELOCITY;
+			VectorCopy( new_basevel, basevelocity );
+		}
+	}
+
+	// SV_Physics_Entity
+	if(!( flags & FL_BASEVELOCITY ) && !VectorIsNull( basevelocity ))
+	{
+		VectorMA( velocity, 1.0f + (host.frametime * 0.5f), basevelocity, velocity );
+		VectorClear( basevelocity );
+	}
+
+	flags &= ~FL_BASEVELOCITY;
+
+	// SV_Physics_Toss, water currents are not guessed
+	if( ent->v.watertype <= CONTENTS_CURRENT_0 )
+		return false;
+
+	ground = ent->v.groundentity;
+
+	if( velocity[2] > 0.0f || !SV_IsValidEdict( ground ) || ground->v.flags & (FL_MONSTER|FL_CLIENT) || svgame.globals->changelevel )
+		flags &= ~FL_ONGROUND;
+
+	if( flags & FL_ONGROUND && VectorIsNull( velocity ) && VectorIsNull( basevelocity ))
+		return false; // at rest
+
+	if( !SV_VelocityInRange( velocity ))
+		return false;
+
+	switch( ent->v.movetype )
+	{
+	case MOVETYPE_FLY:
+	case MOVETYPE_FLYMISSILE:
+	case MOVETYPE_BOUNCEMISSILE:
+		break;
+	default:
+		// SV_AddGravity
+		if( ent->v.gravity )
+			ent_gravity = ent->v.gravity;
+		else ent_gravity = 1.0f;
+
+		velocity[2] -= ( ent_gravity * sv_gravity->value * host.frametime );
+		velocity[2] += ( basevelocity[2] * host.frametime );
+		basevelocity[2] = 0.0f;
+
+		if( !SV_VelocityInRange( velocity ))
+			return false;
+		break;
+	}
+
+	VectorAdd( velocity, basevelocity, velocity );
+
+	if( !SV_VelocityInRange( velocity ))
+		return false;
+
+	VectorScale( velocity, host.frametime, move );
+
+	// SV_PushEntity
+	VectorAdd( ent->v.origin, move, req->end );
+	VectorCopy( ent->v.origin, req->start );
+	VectorCopy( ent->v.mins, req->mins );
+	VectorCopy( ent->v.maxs, req->maxs );
+	req->pentIgnore = ent;
+
+	if( ent->v.movetype == MOVETYPE_FLYMISSILE )
+		req->type = MOVE_MISSILE;
+	else if( ent->v.solid == SOLID_TRIGGER || ent->v.solid == SOLID_NOT )
+		req->type = MOVE_NOMONSTERS;
+	else req->type = MOVE_NORMAL;
+
+	return true;
+}
+
+/*
+=============
+SV_PrefetchPhysics
+
+traces flying and tossed edicts on worker threads before
+the serial loop. everything else, including touches, still
+runs in edict order, so results don't depend on threads
+=============
+*/
+static void SV_PrefetchPhysics( void )
+{
+	tracereq_t	*reqs;
+	edict_t		*ent;
+	int		i, count;
+
+	if( !sv_threaded_physics->integer || Sys_NumJobThreads() < 2 )
+		return;
+
+	// dll can take over any edict or filter collisions
+	if( svgame.physFuncs.SV_PhysicsEntity || svgame.dllFuncs2.pfnShouldCollide )
+		return;
+
+	if( svgame.globals->force_retouch != 0.0f )
+		return;
+
+	reqs = SV_PrefetchRequests( max( GI->max_edicts, svgame.numEntities ));
+
+	for( i = svgame.globals->maxClients + 1, count = 0; i < svgame.numEntities; i++ )
+	{
+		ent = EDICT_NUM( i );
+
+		if( !SV_IsValidEdict( ent ))
+			continue;
+
+		switch( ent->v.movetype )
+		{
+		case MOVETYPE_FLY:
+		case MOVETYPE_TOSS:
+		case MOVETYPE_BOUNCE:
+		case MOVETYPE_FLYMISSILE:
+		case MOVETYPE_BOUNCEMISSILE:
+			if( SV_PredictTossMove( ent, &reqs[count] ))
+				count++;
+			break;
+		}
+	}
+
+	// not worth waking the workers
+	if( count < PREFETCH_MIN_MOVES )
+		return;
+
+	SV_PrefetchMoves( count );
+}
+
 /*
 ===============================================================================
 
@@ -1750,12 +1939,16 @@ void SV_Physics( void )
 	int    	i;
 	
 	SV_CheckAllEnts ();
+	SV_FlushTraceCache ();
+	SV_CheckAreaNodes ();
 
 	svgame.globals->time = sv.time;
 
 	// let the progs know that a new frame has started
 	svgame.dllFuncs.pfnStartFrame();
 
+	SV_PrefetchPhysics ();
+
 	// treat each object in turn
 	for( i = 0; i < svgame.numEntities; i++ )
 	{
@@ -1770,6 +1963,8 @@ void SV_Physics( void )
 		SV_Physics_Entity( ent );
 	}
 
+	SV_EndPrefetch ();
+
 	if( svgame.physFuncs.SV_EndFrame != NULL )
 		svgame.physFuncs.SV_EndFrame();
 
@@ -1788,6 +1983,8 @@ void SV_Physics( void )
 
 	if( svgame.globals->force_retouch != 0.0f )
 		svgame.globals->force_retouch--;
+
+	SV_RecordPlayerHistory ();
 }
 
 /*
@@ -1960,6 +2157,9 @@ static server_physics_api_t gPhysicsAPI =
 	GL_TextureData,
 	pfnMem_Alloc,
 	pfnMem_Free,
+	SV_MoveBatch,
+	SV_RewindPlayers,
+	SV_RestorePlayers,
 };
 
 /*
@@ -154,6 +154,151 @@ qboolean SV_CopyEdictToPhysEnt( physent_t *pe, edict_t *ed )
 	return true;
 }
 
+/*
+===============================================================================
+
+PHYSENT CACHE
+
+===============================================================================
+*/
+static struct
+{
+	physent_t		*ents;
+	uint32_t		*frame;		// host frame when physent was made
+	uint		*stamp;		// link stamp it was made with
+	uint		*links;		// bumped when edict is linked or unlinked
+	int		maxedicts;
+
+	int		conversions;	// this frame
+	int		hits;
+	int		lastconversions;	// previous frame
+	uint32_t		lastframe;
+	int		totalconversions;
+	int		totalhits;
+	int		frames;
+} sv_physents;
+
+/*
+====================
+SV_FreePhysEntCache
+====================
+*/
+void SV_FreePhysEntCache( void )
+{
+	if( sv_physents.ents ) Mem_Free( sv_physents.ents );
+	if( sv_physents.frame ) Mem_Free( sv_physents.frame );
+	if( sv_physents.stamp ) Mem_Free( sv_physents.stamp );
+	if( sv_physents.links ) Mem_Free( sv_physents.links );
+	Q_memset( &sv_physents, 0, sizeof( sv_physents ));
+}
+
+/*
+====================
+SV_TouchPhysEnt
+
+edict moved, changed model or went away
+====================
+*/
+void SV_TouchPhysEnt( const edict_t *ent )
+{
+	int	e = NUM_FOR_EDICT( ent );
+
+	if( sv_physents.links && e < sv_physents.maxedicts )
+		sv_physents.links[e]++;
+}
+
+/*
+====================
+SV_CachedPhysEnt
+
+players are converted every time because their origin
+depends on who is moving, other edicts once per frame
+====================
+*/
+static qboolean SV_CachedPhysEnt( physent_t *pe, edict_t *ed )
+{
+	physent_t	*cached;
+	int	e;
+
+	if( host.framecount != sv_physents.lastframe )
+	{
+		if( sv_physents.lastframe ) sv_physents.frames++;
+		sv_physents.lastconversions = sv_physents.conversions;
+		sv_physents.conversions = 0;
+		sv_physents.lastframe = host.framecount;
+	}
+
+	e = NUM_FOR_EDICT( ed );
+
+	if( !sv_physentcache->integer || ( e > 0 && e <= sv_maxclients->integer ))
+	{
+		sv_physents.conversions++;
+		sv_physents.totalconversions++;
+		return SV_CopyEdictToPhysEnt( pe, ed );
+	}
+
+	if( sv_physents.maxedicts != GI->max_edicts )
+	{
+		SV_FreePhysEntCache();
+		sv_physents.maxedicts = GI->max_edicts;
+		sv_physents.ents = Z_Malloc( sizeof( physent_t ) * sv_physents.maxedicts );
+		sv_physents.frame = Z_Malloc( sizeof( uint32_t ) * sv_physents.maxedicts );
+		sv_physents.stamp = Z_Malloc( sizeof( uint ) * sv_physents.maxedicts );
+		sv_physents.links = Z_Malloc( sizeof( uint ) * sv_physents.maxedicts );
+		sv_physents.lastframe = host.framecount;
+	}
+
+	cached = &sv_physents.ents[e];
+
+	if( sv_physents.frame[e] == host.framecount && sv_physents.stamp[e] == sv_physents.links[e]
+	&& cached->solid == ed->v.solid && cached->info == e )
+	{
+		sv_physents.hits++;
+		sv_physents.totalhits++;
+		*pe = *cached;
+		return true;
+	}
+
+	sv_physents.conversions++;
+	sv_physents.totalconversions++;
+
+	if( !SV_CopyEdictToPhysEnt( cached, ed ))
+	{
+		sv_physents.frame[e] = 0;
+		return false;
+	}
+
+	sv_physents.frame[e] = host.framecount;
+	sv_physents.stamp[e] = sv_physents.links[e];
+	*pe = *cached;
+
+	return true;
+}
+
+/*
+====================
+SV_PhysEntStats_f
+====================
+*/
+void SV_PhysEntStats_f( void )
+{
+	int	lookups;
+
+	if( Cmd_Argc() > 1 && !Q_stricmp( Cmd_Argv( 1 ), "reset" ))
+	{
+		sv_physents.totalconversions = sv_physents.totalhits = sv_physents.frames = 0;
+		return;
+	}
+
+	lookups = sv_physents.totalconversions + sv_physents.totalhits;
+
+	Msg( "physent cache: %s\n", sv_physentcache->integer ? "enabled" : "disabled" );
+	Msg( "%i conversions last frame, %.1f per frame\n", sv_physents.lastconversions,
+		sv_physents.frames ? (float)sv_physents.totalconversions / sv_physents.frames : 0.0f );
+	Msg( "%i lookups, %i hits (%.1f%%)\n", lookups, sv_physents.totalhits,
+		lookups ? sv_physents.totalhits * 100.0f / lookups : 0.0f );
+}
+
 /*
 ====================
 SV_AddLinksToPmove
@@ -195,7 +340,7 @@ void SV_AddLinksToPmove( areanode_t *node, const vec3_t pmove_mins, const vec3_t
 		if( svgame.pmove->numvisent < MAX_PHYSENTS )
 		{
 			pe = &svgame.pmove->visents[svgame.pmove->numvisent];
-			if( SV_CopyEdictToPhysEnt( pe, check ))
+			if( SV_CachedPhysEnt( pe, check ))
 				svgame.pmove->numvisent++;
 		}
 
@@ -236,7 +381,7 @@ void SV_AddLinksToPmove( areanode_t *node, const vec3_t pmove_mins, const vec3_t
 		{
 			pe = &svgame.pmove->physents[svgame.pmove->numphysent];
 
-			if( SV_CopyEdictToPhysEnt( pe, check ))
+			if( SV_CachedPhysEnt( pe, check ))
 				svgame.pmove->numphysent++;
 		}
 	}
@@ -281,7 +426,7 @@ void SV_AddLaddersToPmove( areanode_t *node, const vec3_t pmove_mins, const vec3
 			return;
 
 		pe = &svgame.pmove->moveents[svgame.pmove->nummoveent];
-		if( SV_CopyEdictToPhysEnt( pe, check ))
+		if( SV_CachedPhysEnt( pe, check ))
 			svgame.pmove->nummoveent++;
 	}
 	
@@ -1134,6 +1279,333 @@ void SV_RestoreMoveInterpolant( sv_client_t *cl )
 	}
 }
 
+/*
+===============================================================================
+
+PLAYER HISTORY
+
+positions of all players for the last ticks, so the game
+can trace against the world as a client saw it
+===============================================================================
+*/
+#define PLAYER_HISTORY		64	// ticks, must be power of two
+#define PLAYER_HISTORY_MASK		(PLAYER_HISTORY - 1)
+
+typedef struct
+{
+	double		time;
+	qboolean		alive;
+	qboolean		teleported;	// don't lerp from previous record
+	vec3_t		origin;
+	vec3_t		angles;
+	vec3_t		mins;
+	vec3_t		maxs;
+	float		frame;
+	float		animtime;
+	int		sequence;
+	int		gaitsequence;
+	byte		controller[4];
+	byte		blending[2];
+} playerrecord_t;
+
+static struct
+{
+	playerrecord_t	records[MAX_CLIENTS][PLAYER_HISTORY];
+	int		numrecords[MAX_CLIENTS];
+	int		head;		// newest record
+	double		lasttime;
+
+	playerrecord_t	saved[MAX_CLIENTS];	// real state of rewound players
+	playerrecord_t	applied[MAX_CLIENTS];	// state they were rewound to
+	qboolean		rewound[MAX_CLIENTS];
+	qboolean		active;
+} sv_history;
+
+/*
+================
+SV_StorePlayerRecord
+================
+*/
+static void SV_StorePlayerRecord( playerrecord_t *rec, const edict_t *ent )
+{
+	VectorCopy( ent->v.origin, rec->origin );
+	VectorCopy( ent->v.angles, rec->angles );
+	VectorCopy( ent->v.mins, rec->mins );
+	VectorCopy( ent->v.maxs, rec->maxs );
+	rec->frame = ent->v.frame;
+	rec->animtime = ent->v.animtime;
+	rec->sequence = ent->v.sequence;
+	rec->gaitsequence = ent->v.gaitsequence;
+	Q_memcpy( rec->controller, ent->v.controller, 4 );
+	Q_memcpy( rec->blending, ent->v.blending, 2 );
+}
+
+/*
+================
+SV_ApplyPlayerRecord
+
+returns false if nothing was changed
+================
+*/
+static qboolean SV_ApplyPlayerRecord( edict_t *ent, const playerrecord_t *rec )
+{
+	if( VectorCompare( ent->v.origin, rec->origin ) && VectorCompare( ent->v.angles, rec->angles )
+	&& VectorCompare( ent->v.mins, rec->mins ) && VectorCompare( ent->v.maxs, rec->maxs )
+	&& ent->v.frame == rec->frame && ent->v.sequence == rec->sequence && ent->v.gaitsequence == rec->gaitsequence
+	&& !Q_memcmp( ent->v.controller, rec->controller, 4 ) && !Q_memcmp( ent->v.blending, rec->blending, 2 ))
+		return false;
+
+	VectorCopy( rec->origin, ent->v.origin );
+	VectorCopy( rec->angles, ent->v.angles );
+	VectorCopy( rec->mins, ent->v.mins );
+	VectorCopy( rec->maxs, ent->v.maxs );
+	ent->v.frame = rec->frame;
+	ent->v.animtime = rec->animtime;
+	ent->v.sequence = rec->sequence;
+	ent->v.gaitsequence = rec->gaitsequence;
+	Q_memcpy( ent->v.controller, rec->controller, 4 );
+	Q_memcpy( ent->v.blending, rec->blending, 2 );
+	SV_LinkEdict( ent, false );
+
+	return true;
+}
+
+/*
+================
+SV_RestorePlayerRecord
+
+puts back saved fields which are still as they were
+rewound, so the game can kill or teleport a rewound player
+================
+*/
+static void SV_RestorePlayerRecord( edict_t *ent, const playerrecord_t *saved, const playerrecord_t *applied )
+{
+	qboolean	relink = false;
+
+	if( VectorCompare( ent->v.origin, applied->origin ))
+	{
+		VectorCopy( saved->origin, ent->v.origin );
+		relink = true;
+	}
+
+	if( VectorCompare( ent->v.mins, applied->mins ) && VectorCompare( ent->v.maxs, applied->maxs ))
+	{
+		VectorCopy( saved->mins, ent->v.mins );
+		VectorCopy( saved->maxs, ent->v.maxs );
+		relink = true;
+	}
+
+	if( VectorCompare( ent->v.angles, applied->angles ))
+		VectorCopy( saved->angles, ent->v.angles );
+
+	if( ent->v.frame == applied->frame )
+		ent->v.frame = saved->frame;
+
+	if( ent->v.animtime == applied->animtime )
+		ent->v.animtime = saved->animtime;
+
+	if( ent->v.sequence == applied->sequence )
+		ent->v.sequence = saved->sequence;
+
+	if( ent->v.gaitsequence == applied->gaitsequence )
+		ent->v.gaitsequence = saved->gaitsequence;
+
+	if( !Q_memcmp( ent->v.controller, applied->controller, 4 ))
+		Q_memcpy( ent->v.controller, saved->controller, 4 );
+
+	if( !Q_memcmp( ent->v.blending, applied->blending, 2 ))
+		Q_memcpy( ent->v.blending, saved->blending, 2 );
+
+	if( relink ) SV_LinkEdict( ent, false );
+}
+
+/*
+================
+SV_RecordPlayerHistory
+
+called at end of each server frame
+================
+*/
+void SV_RecordPlayerHistory( void )
+{
+	playerrecord_t	*rec;
+	sv_client_t	*cl;
+	edict_t		*ent;
+	int		i;
+
+	if( sv_history.active )
+	{
+		MsgDev( D_WARN, "SV_RecordPlayerHistory: players were not restored after rewind\n" );
+		SV_RestorePlayers();
+	}
+
+	// new map
+	if( sv.time < sv_history.lasttime )
+		Q_memset( sv_history.numrecords, 0, sizeof( sv_history.numrecords ));
+
+	sv_history.head = ( sv_history.head + 1 ) & PLAYER_HISTORY_MASK;
+	sv_history.lasttime = sv.time;
+
+	for( i = 0, cl = svs.clients; i < sv_maxclients->integer; i++, cl++ )
+	{
+		ent = cl->edict;
+
+		if( cl->state != cs_spawned || !SV_IsValidEdict( ent ))
+		{
+			sv_history.numrecords[i] = 0;
+			continue;
+		}
+
+		rec = &sv_history.records[i][sv_history.head];
+		SV_StorePlayerRecord( rec, ent );
+		rec->time = sv.time;
+		rec->alive = ( ent->v.health > 0.0f && ent->v.deadflag == DEAD_NO );
+		rec->teleported = ( ent->v.effects & EF_NOINTERP ) ? true : false;
+
+		if( sv_history.numrecords[i] > 0 )
+		{
+			playerrecord_t	*prev = &sv_history.records[i][(sv_history.head - 1) & PLAYER_HISTORY_MASK];
+
+			if( SV_UnlagCheckTeleport( prev->origin, rec->origin ))
+				rec->teleported = true;
+		}
+
+		sv_history.numrecords[i] = min( sv_history.numrecords[i] + 1, PLAYER_HISTORY );
+	}
+}
+
+/*
+================
+SV_LerpPlayerRecord
+
+finds where player was at time, returns false if
+there is no record that old or player was dead
+================
+*/
+static qboolean SV_LerpPlayerRecord( int clientnum, double time, playerrecord_t *out )
+{
+	playerrecord_t	*rec, *next = NULL;
+	float		frac;
+	int		i;
+
+	for( i = 0; i < sv_history.numrecords[clientnum]; i++, next = rec )
+	{
+		rec = &sv_history.records[clientnum][(sv_history.head - i) & PLAYER_HISTORY_MASK];
+
+		if( rec->time <= time )
+			break;
+	}
+
+	if( i == sv_history.numrecords[clientnum] || !rec->alive )
+		return false;
+
+	*out = *rec;
+
+	if( !next || next->teleported || next->time <= rec->time )
+		return true;
+
+	frac = ( time - rec->time ) / ( next->time - rec->time );
+
+	VectorLerp( rec->origin, frac, next->origin, out->origin );
+	InterpolateAngles( next->angles, rec->angles, out->angles, frac );
+
+	if( rec->sequence == next->sequence && next->frame >= rec->frame )
+		out->frame = rec->frame + ( next->frame - rec->frame ) * frac;
+
+	return true;
+}
+
+/*
+================
+SV_RewindPlayers
+
+moves all players except pClient back to time.
+time is server time, 0 - where pClient saw them,
+as for usercmd unlag. returns number of moved players
+================
+*/
+int SV_RewindPlayers( edict_t *pClient, double time )
+{
+	playerrecord_t	rec;
+	sv_client_t	*cl, *self;
+	float		latency, lerp_msec;
+	int		i, count = 0;
+
+	if( sv_history.active )
+		SV_RestorePlayers();
+
+	self = SV_ClientFromEdict( pClient, true );
+
+	if( time <= 0.0 )
+	{
+		if( !self ) return 0;
+
+		latency = min( self->latency, 1.5f );
+		if( sv_maxunlag->value > 0.0f )
+			latency = min( latency, sv_maxunlag->value );
+
+		lerp_msec = self->lastcmd.lerp_msec * 0.001f;
+		lerp_msec = bound( self->cl_updaterate, lerp_msec, 0.1f );
+
+		time = sv.time - latency - lerp_msec + sv_unlagpush->value;
+	}
+
+	if( time >= sv.time )
+		return 0;
+
+	sv_history.active = true;
+
+	for( i = 0, cl = svs.clients; i < sv_maxclients->integer; i++, cl++ )
+	{
+		sv_history.rewound[i] = false;
+
+		if( cl == self || cl->state != cs_spawned || !sv_history.numrecords[i] )
+			continue;
+
+		if( !SV_LerpPlayerRecord( i, time, &rec ))
+			continue;
+
+		SV_StorePlayerRecord( &sv_history.saved[i], cl->edict );
+
+		if( SV_ApplyPlayerRecord( cl->edict, &rec ))
+		{
+			SV_StorePlayerRecord( &sv_history.applied[i], cl->edict );
+			sv_history.rewound[i] = true;
+			count++;
+		}
+	}
+
+	return count;
+}
+
+/*
+================
+SV_RestorePlayers
+
+undo SV_RewindPlayers
+================
+*/
+void SV_RestorePlayers( void )
+{
+	sv_client_t	*cl;
+	int		i;
+
+	if( !sv_history.active )
+		return;
+
+	for( i = 0, cl = svs.clients; i < sv_maxclients->integer; i++, cl++ )
+	{
+		if( !sv_history.rewound[i] )
+			continue;
+
+		if( SV_IsValidEdict( cl->edict ))
+			SV_RestorePlayerRecord( cl->edict, &sv_history.saved[i], &sv_history.applied[i] );
+		sv_history.rewound[i] = false;
+	}
+
+	sv_history.active = false;
+}
+
 /*
 ===========
 SV_RunCmd
@@ -29,6 +29,9 @@ typedef struct moveclip_s
 	trace_t		trace;
 	int		type;		// move type
 	int		flags;		// trace flags
+	qboolean		threaded;		// running on a worker thread
+	qboolean		unsafe;		// hit something workers can't clip
+	byte		*visited;		// areanodes walked by threaded move
 } moveclip_t;
 
 /*
@@ -39,9 +42,10 @@ HULL BOXES
 ===============================================================================
 */
 
-static hull_t	box_hull;
-static dclipnode_t	box_clipnodes[6];
-static mplane_t	box_planes[6];
+// every worker thread has its own box
+static THREAD_LOCAL hull_t	box_hull;
+static THREAD_LOCAL dclipnode_t	box_clipnodes[6];
+static THREAD_LOCAL mplane_t	box_planes[6];
 
 /*
 ===================
@@ -117,6 +121,9 @@ BSP trees instead of being compared directly.
 */
 hull_t *SV_HullForBox( const vec3_t mins, const vec3_t maxs )
 {
+	if( !box_hull.clipnodes )
+		SV_InitBoxHull();
+
 	box_planes[0].dist = maxs[0];
 	box_planes[1].dist = mins[0];
 	box_planes[2].dist = maxs[1];
@@ -409,902 +416,2863 @@ areanode_t *SV_CreateAreaNode( int depth, vec3_t mins, vec3_t maxs )
 	return anode;
 }
 
+/*
+===============================================================================
+
+EDICTS BY PVS LEAF
+
+===============================================================================
+*/
+// link index is edict number * MAX_ENT_LEAFS + leaf slot
+static struct
+{
+	int	*leafhead;	// first link in each leaf or -1
+	int	numleafs;
+	int	*next;
+	int	*prev;
+	int	*leaf;
+	byte	*numlinks;	// per edict
+	int	maxedicts;
+} sv_leafents;
+
 /*
 ===============
-SV_ClearWorld
+SV_FreeLeafEdicts
+===============
+*/
+void SV_FreeLeafEdicts( void )
+{
+	if( sv_leafents.leafhead ) Mem_Free( sv_leafents.leafhead );
+	if( sv_leafents.next ) Mem_Free( sv_leafents.next );
+	if( sv_leafents.prev ) Mem_Free( sv_leafents.prev );
+	if( sv_leafents.leaf ) Mem_Free( sv_leafents.leaf );
+	if( sv_leafents.numlinks ) Mem_Free( sv_leafents.numlinks );
+
+	Q_memset( &sv_leafents, 0, sizeof( sv_leafents ));
+}
 
+/*
+===============
+SV_ClearLeafEdicts
 ===============
 */
-void SV_ClearWorld( void )
+static void SV_ClearLeafEdicts( void )
 {
-	int	i;
+	int	numlinks;
 
-	SV_InitBoxHull(); // for box testing
+	SV_FreeLeafEdicts();
 
-	// clear lightstyles
-	for( i = 0; i < MAX_LIGHTSTYLES; i++ )
+	sv_leafents.numleafs = sv.worldmodel->numleafs;
+	sv_leafents.maxedicts = GI->max_edicts;
+	numlinks = sv_leafents.maxedicts * MAX_ENT_LEAFS;
+
+	sv_leafents.leafhead = Z_Malloc( sizeof( int ) * sv_leafents.numleafs );
+	sv_leafents.next = Z_Malloc( sizeof( int ) * numlinks );
+	sv_leafents.prev = Z_Malloc( sizeof( int ) * numlinks );
+	sv_leafents.leaf = Z_Malloc( sizeof( int ) * numlinks );
+	sv_leafents.numlinks = Z_Malloc( sv_leafents.maxedicts );
+
+	Q_memset( sv_leafents.leafhead, -1, sizeof( int ) * sv_leafents.numleafs );
+}
+
+/*
+===============
+SV_UnlinkLeafEdict
+===============
+*/
+void SV_UnlinkLeafEdict( edict_t *ent )
+{
+	int	i, e, link;
+
+	e = NUM_FOR_EDICT( ent );
+	if( e >= sv_leafents.maxedicts )
+		return;
+
+	for( i = 0, link = e * MAX_ENT_LEAFS; i < sv_leafents.numlinks[e]; i++, link++ )
 	{
-		sv.lightstyles[i].value = 256.0f;
-		sv.lightstyles[i].time = 0.0f;
+		if( sv_leafents.prev[link] != -1 )
+			sv_leafents.next[sv_leafents.prev[link]] = sv_leafents.next[link];
+		else sv_leafents.leafhead[sv_leafents.leaf[link]] = sv_leafents.next[link];
+
+		if( sv_leafents.next[link] != -1 )
+			sv_leafents.prev[sv_leafents.next[link]] = sv_leafents.prev[link];
 	}
 
-	Q_memset( sv_areanodes, 0, sizeof( sv_areanodes ));
-	iTouchLinkSemaphore = 0;
-	sv_numareanodes = 0;
+	sv_leafents.numlinks[e] = 0;
+}
 
-	SV_CreateAreaNode( 0, sv.worldmodel->mins, sv.worldmodel->maxs );
+/*
+===============
+SV_LinkLeafEdict
+
+adds edict to the lists of leafs from ent->leafnums,
+entities which use headnode are not listed
+===============
+*/
+static void SV_LinkLeafEdict( edict_t *ent )
+{
+	int	i, e, link, leaf;
+
+	SV_UnlinkLeafEdict( ent );
+
+	e = NUM_FOR_EDICT( ent );
+	if( e >= sv_leafents.maxedicts || ent->headnode >= 0 )
+		return;
+
+	for( i = 0, link = e * MAX_ENT_LEAFS; i < ent->num_leafs; i++, link++ )
+	{
+		leaf = ent->leafnums[i];
+		if( leaf < 0 || leaf >= sv_leafents.numleafs )
+			break;
+
+		sv_leafents.leaf[link] = leaf;
+		sv_leafents.prev[link] = -1;
+		sv_leafents.next[link] = sv_leafents.leafhead[leaf];
+		if( sv_leafents.next[link] != -1 )
+			sv_leafents.prev[sv_leafents.next[link]] = link;
+		sv_leafents.leafhead[leaf] = link;
+	}
+
+	sv_leafents.numlinks[e] = i;
 }
 
 /*
 ===============
-SV_UnlinkEdict
+SV_LeafEdictsValid
+
+edict is listed in all the leafs it has
 ===============
 */
-void SV_UnlinkEdict( edict_t *ent )
+qboolean SV_LeafEdictsValid( const edict_t *ent )
 {
-	// not linked in anywhere
-	if( !ent->area.prev ) return;
+	int	e = NUM_FOR_EDICT( ent );
 
-	RemoveLink( &ent->area );
-	ent->area.prev = NULL;
-	ent->area.next = NULL;
+	if( e >= sv_leafents.maxedicts || ent->headnode >= 0 || !ent->num_leafs )
+		return false;
+
+	return ( sv_leafents.numlinks[e] == ent->num_leafs );
 }
 
 /*
-====================
-SV_TouchLinks
-====================
+===============
+SV_MarkLeafEdicts
+
+sets bit in marks for every edict listed
+in leafs which are visible in pset
+===============
 */
-void SV_TouchLinks( edict_t *ent, areanode_t *node )
+void SV_MarkLeafEdicts( const byte *pset, byte *marks )
 {
-	link_t	*l, *next;
-	edict_t	*touch;
-	hull_t	*hull;
-	vec3_t	test, offset;
+	int	i, j, leaf, link, e;
 
-	// touch linked edicts
-	for( l = node->trigger_edicts.next; l != &node->trigger_edicts; l = next )
+	for( i = 0; i < ( sv_leafents.numleafs + 7 ) >> 3; i++ )
 	{
-		next = l->next;
-		touch = (edict_t *)((byte *)l - ADDRESS_OF_AREA);
+		if( !pset[i] ) continue;
 
-		if( svgame.physFuncs.SV_TriggerTouch != NULL )
-		{
-			// user dll can override trigger checking (Xash3D extension)
-			if( !svgame.physFuncs.SV_TriggerTouch( ent, touch ))
-				continue;
-		}
-		else
+		for( j = 0; j < 8; j++ )
 		{
-			if( touch == ent || touch->v.solid != SOLID_TRIGGER ) // disabled ?
+			if(!( pset[i] & ( 1U << j )))
 				continue;
 
-			if( touch->v.groupinfo && ent->v.groupinfo )
+			leaf = ( i << 3 ) + j;
+			if( leaf >= sv_leafents.numleafs )
+				break;
+
+			for( link = sv_leafents.leafhead[leaf]; link != -1; link = sv_leafents.next[link] )
 			{
-				if(( !svs.groupop && !(touch->v.groupinfo & ent->v.groupinfo)) ||
-				(svs.groupop == 1 && (touch->v.groupinfo & ent->v.groupinfo)))
-					continue;
+				e = link / MAX_ENT_LEAFS;
+				marks[e >> 3] |= 1U << ( e & 7 );
 			}
+		}
+	}
+}
 
-			if( !BoundsIntersect( ent->v.absmin, ent->v.absmax, touch->v.absmin, touch->v.absmax ))
-				continue;
+/*
+===============================================================================
 
-			// check brush triggers accuracy
-			if( Mod_GetType( touch->v.modelindex ) == mod_brush )
-			{
-				model_t *mod = Mod_Handle( touch->v.modelindex );
+EDICTS BY ABSBOX
 
-				// force to select bsp-hull
-				hull = SV_HullForBsp( touch, ent->v.mins, ent->v.maxs, offset );
+uniform grid over the world, edicts are placed by absmin/absmax from the
+last SV_LinkEdict, edicts spanning too many cells or not linked since
+SV_InitEdict are kept in a separate list and always returned
 
-				// support for rotational triggers
-				if(( mod->flags & MODEL_HAS_ORIGIN ) && !VectorIsNull( touch->v.angles ))
-				{
-					matrix4x4	matrix;
-					Matrix4x4_CreateFromEntity( matrix, touch->v.angles, offset, 1.0f );
-					Matrix4x4_VectorITransform( matrix, ent->v.origin, test );
-				}
-				else
-				{
-					// offset the test point appropriately for this hull.
-					VectorSubtract( ent->v.origin, offset, test );
-				}
+===============================================================================
+*/
+#define GRID_CELL_SIZE	256.0f
+#define GRID_MAX_SIZE	64		// cells by axis
+#define GRID_EDICT_CELLS	8		// more goes to the wide list
 
-				// test hull for intersection with this model
-				if( PM_HullPointContents( hull, hull->firstclipnode, test ) != CONTENTS_SOLID )
-					continue;
-			}
-		}
+// link index is edict number * GRID_EDICT_CELLS + cell slot
+static struct
+{
+	int	*cellhead;	// first link in each cell or -1
+	int	*next;
+	int	*prev;
+	int	*cell;
+	byte	*numlinks;	// per edict
+	int	*widenext;	// edicts which are always returned
+	int	*wideprev;
+	byte	*wide;
+	int	widehead;
+	int	maxedicts;
+	int	size[2];
+	vec2_t	origin;
+
+	// last query
+	byte	*marks;
+	vec3_t	mins, maxs;
+	int	generation;	// changed when any edict is regridded
+	int	markgeneration;
+} sv_grid;
 
-		// never touch the triggers when "playersonly" is active
-		if( !( sv.hostflags & SVF_PLAYERSONLY ))
-		{
-			svgame.globals->time = sv.time;
-			svgame.dllFuncs.pfnTouch( touch, ent );
-		}
-	}
-	
-	// recurse down both sides
-	if( node->axis == -1 ) return;
-	
-	if( ent->v.absmax[node->axis] > node->dist )
-		SV_TouchLinks( ent, node->children[0] );
-	if( ent->v.absmin[node->axis] < node->dist )
-		SV_TouchLinks( ent, node->children[1] );
+/*
+===============
+SV_FreeEdictGrid
+===============
+*/
+void SV_FreeEdictGrid( void )
+{
+	if( sv_grid.cellhead ) Mem_Free( sv_grid.cellhead );
+	if( sv_grid.next ) Mem_Free( sv_grid.next );
+	if( sv_grid.prev ) Mem_Free( sv_grid.prev );
+	if( sv_grid.cell ) Mem_Free( sv_grid.cell );
+	if( sv_grid.numlinks ) Mem_Free( sv_grid.numlinks );
+	if( sv_grid.widenext ) Mem_Free( sv_grid.widenext );
+	if( sv_grid.wideprev ) Mem_Free( sv_grid.wideprev );
+	if( sv_grid.wide ) Mem_Free( sv_grid.wide );
+	if( sv_grid.marks ) Mem_Free( sv_grid.marks );
+
+	Q_memset( &sv_grid, 0, sizeof( sv_grid ));
 }
 
 /*
 ===============
-SV_FindTouchedLeafs
-
+SV_UngridEdict
 ===============
 */
-void SV_FindTouchedLeafs( edict_t *ent, mnode_t *node, int *headnode )
+static void SV_UngridEdict( int e )
 {
-	mplane_t	*splitplane;
-	int	sides, leafnum;
-	mleaf_t	*leaf;
+	int	i, link;
 
-	if( !node ) // if no collision model
-		return;
+	for( i = 0, link = e * GRID_EDICT_CELLS; i < sv_grid.numlinks[e]; i++, link++ )
+	{
+		if( sv_grid.prev[link] != -1 )
+			sv_grid.next[sv_grid.prev[link]] = sv_grid.next[link];
+		else sv_grid.cellhead[sv_grid.cell[link]] = sv_grid.next[link];
 
-	if( node->contents == CONTENTS_SOLID )
-		return;
-	
-	// add an efrag if the node is a leaf
-	if(  node->contents < 0 )
+		if( sv_grid.next[link] != -1 )
+			sv_grid.prev[sv_grid.next[link]] = sv_grid.prev[link];
+	}
+
+	sv_grid.numlinks[e] = 0;
+
+	if( sv_grid.wide[e] )
 	{
-		if( ent->num_leafs > ( MAX_ENT_LEAFS - 1 ))
-		{
-			// continue counting leafs,
-			// so we know how many it's overrun
-			ent->num_leafs = (MAX_ENT_LEAFS + 1);
-		}
-		else
-		{
-			leaf = (mleaf_t *)node;
-			leafnum = leaf - sv.worldmodel->leafs - 1;
-			ent->leafnums[ent->num_leafs] = leafnum;
-			ent->num_leafs++;			
-		}
-		return;
+		if( sv_grid.wideprev[e] != -1 )
+			sv_grid.widenext[sv_grid.wideprev[e]] = sv_grid.widenext[e];
+		else sv_grid.widehead = sv_grid.widenext[e];
+
+		if( sv_grid.widenext[e] != -1 )
+			sv_grid.wideprev[sv_grid.widenext[e]] = sv_grid.wideprev[e];
+
+		sv_grid.wide[e] = false;
 	}
-	
-	// NODE_MIXED
-	splitplane = node->plane;
-	sides = BOX_ON_PLANE_SIDE( ent->v.absmin, ent->v.absmax, splitplane );
 
-	if( sides == 3 && *headnode == -1 )
-		*headnode = node - sv.worldmodel->nodes;
-	
-	// recurse down the contacted sides
-	if( sides & 1 ) SV_FindTouchedLeafs( ent, node->children[0], headnode );
-	if( sides & 2 ) SV_FindTouchedLeafs( ent, node->children[1], headnode );
+	sv_grid.generation++;
 }
 
 /*
-=============
-SV_HeadnodeVisible
-=============
+===============
+SV_WidenEdict
+===============
 */
-qboolean SV_HeadnodeVisible( mnode_t *node, byte *visbits, int *lastleaf )
+static void SV_WidenEdict( int e )
 {
-	int	leafnum;
-
-	if( !node || node->contents == CONTENTS_SOLID )
-		return false;
+	sv_grid.wide[e] = true;
+	sv_grid.wideprev[e] = -1;
+	sv_grid.widenext[e] = sv_grid.widehead;
+	if( sv_grid.widehead != -1 )
+		sv_grid.wideprev[sv_grid.widehead] = e;
+	sv_grid.widehead = e;
+}
 
-	if( node->contents < 0 )
-	{
-		leafnum = ((mleaf_t *)node - sv.worldmodel->leafs) - 1;
+/*
+===============
+SV_GridBounds
 
-		if(!( visbits[leafnum >> 3] & (1U << ( leafnum & 7 ))))
-			return false;
+cell range covered by the box, false if it
+covers more than GRID_EDICT_CELLS cells
+===============
+*/
+static qboolean SV_GridBounds( const vec3_t mins, const vec3_t maxs, int *cmins, int *cmaxs, int maxcells )
+{
+	int	i;
 
-		if( lastleaf )
-			*lastleaf = leafnum;
-		return true;
+	for( i = 0; i < 2; i++ )
+	{
+		cmins[i] = (int)floor(( mins[i] - sv_grid.origin[i] ) / GRID_CELL_SIZE );
+		cmaxs[i] = (int)floor(( maxs[i] - sv_grid.origin[i] ) / GRID_CELL_SIZE );
+		cmins[i] = bound( 0, cmins[i], sv_grid.size[i] - 1 );
+		cmaxs[i] = bound( 0, cmaxs[i], sv_grid.size[i] - 1 );
 	}
 
-	if( SV_HeadnodeVisible( node->children[0], visbits, lastleaf ))
-		return true;
-
-	return SV_HeadnodeVisible( node->children[1], visbits, lastleaf );
+	return ( cmaxs[0] - cmins[0] + 1 ) * ( cmaxs[1] - cmins[1] + 1 ) <= maxcells;
 }
 
 /*
 ===============
-SV_LinkEdict
+SV_GridEdict
 ===============
 */
-void SV_LinkEdict( edict_t *ent, qboolean touch_triggers )
+static void SV_GridEdict( edict_t *ent )
 {
-	areanode_t	*node;
-	int		headnode;
+	int	cmins[2], cmaxs[2];
+	int	x, y, e, link, cell;
 
-	if( ent->area.prev ) SV_UnlinkEdict( ent );	// unlink from old position
-	if( ent == svgame.edicts ) return;		// don't add the world
-	if( !SV_IsValidEdict( ent )) return;		// never add freed ents
+	e = NUM_FOR_EDICT( ent );
+	if( e >= sv_grid.maxedicts )
+		return;
 
-	// set the abs box
-	svgame.dllFuncs.pfnSetAbsBox( ent );
+	SV_UngridEdict( e );
 
-	if( ent->v.movetype == MOVETYPE_FOLLOW && SV_IsValidEdict( ent->v.aiment ))
+	if( !SV_GridBounds( ent->v.absmin, ent->v.absmax, cmins, cmaxs, GRID_EDICT_CELLS ))
 	{
-		ent->headnode = ent->v.aiment->headnode;
-		ent->num_leafs = ent->v.aiment->num_leafs;
-		Q_memcpy( ent->leafnums, ent->v.aiment->leafnums, sizeof( ent->leafnums ));
+		SV_WidenEdict( e );
+		return;
 	}
-	else
-	{
-		// link to PVS leafs
-		ent->num_leafs = 0;
-		ent->headnode = -1;
-		headnode = -1;
 
-		if( ent->v.modelindex )
-			SV_FindTouchedLeafs( ent, sv.worldmodel->nodes, &headnode );
+	link = e * GRID_EDICT_CELLS;
 
-		if( ent->num_leafs > MAX_ENT_LEAFS )
+	for( y = cmins[1]; y <= cmaxs[1]; y++ )
+	{
+		for( x = cmins[0]; x <= cmaxs[0]; x++, link++ )
 		{
-			Q_memset( ent->leafnums, -1, sizeof( ent->leafnums ));
-			ent->num_leafs = 0;	// so we use headnode instead
-			ent->headnode = headnode;
+			cell = y * sv_grid.size[0] + x;
+
+			sv_grid.cell[link] = cell;
+			sv_grid.prev[link] = -1;
+			sv_grid.next[link] = sv_grid.cellhead[cell];
+			if( sv_grid.next[link] != -1 )
+				sv_grid.prev[sv_grid.next[link]] = link;
+			sv_grid.cellhead[cell] = link;
+			sv_grid.numlinks[e]++;
 		}
 	}
+}
 
-	// ignore non-solid bodies
-	if( ent->v.solid == SOLID_NOT && ent->v.skin >= CONTENTS_EMPTY )
-		return;
-
-	// find the first node that the ent's box crosses
-	node = sv_areanodes;
+/*
+===============
+SV_LooseEdict
 
-	while( 1 )
+edict was reinitialized, it's absbox is not known until next link
+===============
+*/
+void SV_LooseEdict( edict_t *ent )
+{
+	int	e = NUM_FOR_EDICT( ent );
+
+	if( e >= sv_grid.maxedicts )
+		return;
+
+	SV_UngridEdict( e );
+	SV_WidenEdict( e );
+}
+
+/*
+===============
+SV_ClearEdictGrid
+===============
+*/
+static void SV_ClearEdictGrid( void )
+{
+	int	i, numcells, numlinks;
+
+	SV_FreeEdictGrid();
+
+	for( i = 0; i < 2; i++ )
 	{
-		if( node->axis == -1 ) break;
-		if( ent->v.absmin[node->axis] > node->dist )
-			node = node->children[0];
-		else if( ent->v.absmax[node->axis] < node->dist )
-			node = node->children[1];
-		else break; // crosses the node
+		sv_grid.origin[i] = sv.worldmodel->mins[i];
+		sv_grid.size[i] = (int)ceil(( sv.worldmodel->maxs[i] - sv.worldmodel->mins[i] ) / GRID_CELL_SIZE );
+		sv_grid.size[i] = bound( 1, sv_grid.size[i], GRID_MAX_SIZE );
 	}
-	
-	// link it in	
-	if( ent->v.solid == SOLID_TRIGGER )
-		InsertLinkBefore( &ent->area, &node->trigger_edicts );
-	else if( ent->v.solid == SOLID_NOT && ent->v.skin < CONTENTS_EMPTY )
-		InsertLinkBefore( &ent->area, &node->water_edicts );
-	else InsertLinkBefore( &ent->area, &node->solid_edicts );
 
-	if( touch_triggers && !iTouchLinkSemaphore )
+	numcells = sv_grid.size[0] * sv_grid.size[1];
+	sv_grid.maxedicts = GI->max_edicts;
+	numlinks = sv_grid.maxedicts * GRID_EDICT_CELLS;
+
+	sv_grid.cellhead = Z_Malloc( sizeof( int ) * numcells );
+	sv_grid.next = Z_Malloc( sizeof( int ) * numlinks );
+	sv_grid.prev = Z_Malloc( sizeof( int ) * numlinks );
+	sv_grid.cell = Z_Malloc( sizeof( int ) * numlinks );
+	sv_grid.numlinks = Z_Malloc( sv_grid.maxedicts );
+	sv_grid.widenext = Z_Malloc( sizeof( int ) * sv_grid.maxedicts );
+	sv_grid.wideprev = Z_Malloc( sizeof( int ) * sv_grid.maxedicts );
+	sv_grid.wide = Z_Malloc( sv_grid.maxedicts );
+	sv_grid.marks = Z_Malloc(( sv_grid.maxedicts + 7 ) >> 3 );
+
+	Q_memset( sv_grid.cellhead, -1, sizeof( int ) * numcells );
+	sv_grid.widehead = -1;
+
+	// edicts which are already in use until they get linked again
+	for( i = 1; i < svgame.numEntities && i < sv_grid.maxedicts; i++ )
 	{
-		iTouchLinkSemaphore = true;
-		SV_TouchLinks( ent, sv_areanodes );
-		iTouchLinkSemaphore = false;
+		if( !svgame.edicts[i].free )
+			SV_WidenEdict( i );
 	}
+
+	sv_grid.generation++;
 }
 
 /*
-===============================================================================
-
-POINT TESTING IN HULLS
+===============
+SV_EdictsInBox
 
-===============================================================================
+returns bits of edicts whose absbox from last link may touch
+the box, or NULL if grid is not available. result is reused
+while no edicts are regridded and the box is same
+===============
 */
-void SV_WaterLinks( const vec3_t origin, int *pCont, areanode_t *node )
+const byte *SV_EdictsInBox( const vec3_t mins, const vec3_t maxs )
 {
-	link_t	*l, *next;
-	edict_t	*touch;
-	hull_t	*hull;
-	vec3_t	test, offset;
-	model_t	*mod;
-
-	Q_memset( offset, 0, 3 * sizeof( float ) );
-
-	// get water edicts
-	for( l = node->water_edicts.next; l != &node->water_edicts; l = next )
-	{
-		next = l->next;
-		touch = (edict_t *)((byte *)l - ADDRESS_OF_AREA);
-
-		if( touch->v.solid != SOLID_NOT ) // disabled ?
-			continue;
+	int	cmins[2], cmaxs[2];
+	int	x, y, e, link;
 
-		if( touch->v.groupinfo )
-		{
-			if(( !svs.groupop && !(touch->v.groupinfo & svs.groupmask)) ||
-			(svs.groupop == 1 && (touch->v.groupinfo & svs.groupmask)))
-				continue;
-		}
+	if( !sv_grid.maxedicts || sv_grid.maxedicts != GI->max_edicts )
+		return NULL;
 
-		// only brushes can have special contents
-		if( Mod_GetType( touch->v.modelindex ) != mod_brush )
-			continue;
+	if( sv_grid.markgeneration == sv_grid.generation && VectorCompare( mins, sv_grid.mins ) && VectorCompare( maxs, sv_grid.maxs ))
+		return sv_grid.marks;
 
-		if( !BoundsIntersect( origin, origin, touch->v.absmin, touch->v.absmax ))
-			continue;
+	Q_memset( sv_grid.marks, 0, ( sv_grid.maxedicts + 7 ) >> 3 );
 
-		mod = Mod_Handle( touch->v.modelindex );
+	SV_GridBounds( mins, maxs, cmins, cmaxs, 0 );
 
-		// check water brushes accuracy
-		if( Mod_GetType( touch->v.modelindex ) == mod_brush )
-			hull = SV_HullForBsp( touch, vec3_origin, vec3_origin, offset );
-		else
+	for( y = cmins[1]; y <= cmaxs[1]; y++ )
+	{
+		for( x = cmins[0]; x <= cmaxs[0]; x++ )
 		{
-			Host_MapDesignError( "Water must have BSP model!\n" );
-			hull = SV_HullForBox( touch->v.mins, touch->v.maxs );
+			for( link = sv_grid.cellhead[y * sv_grid.size[0] + x]; link != -1; link = sv_grid.next[link] )
+			{
+				e = link / GRID_EDICT_CELLS;
+				sv_grid.marks[e >> 3] |= 1U << ( e & 7 );
+			}
 		}
+	}
 
-		// support for rotational water
-		if(( mod->flags & MODEL_HAS_ORIGIN ) && !VectorIsNull( touch->v.angles ))
-		{
-			matrix4x4	matrix;
-			Matrix4x4_CreateFromEntity( matrix, touch->v.angles, offset, 1.0f );
-			Matrix4x4_VectorITransform( matrix, origin, test );
-		}
-		else
-		{
-			// offset the test point appropriately for this hull.
-			VectorSubtract( origin, offset, test );
-		}
+	for( e = sv_grid.widehead; e != -1; e = sv_grid.widenext[e] )
+		sv_grid.marks[e >> 3] |= 1U << ( e & 7 );
 
-		// test hull for intersection with this model
-		if( PM_HullPointContents( hull, hull->firstclipnode, test ) == CONTENTS_EMPTY )
-			continue;
+	VectorCopy( mins, sv_grid.mins );
+	VectorCopy( maxs, sv_grid.maxs );
+	sv_grid.markgeneration = sv_grid.generation;
 
-		// compare contents ranking
-		if( RankForContents( touch->v.skin ) > RankForContents( *pCont ))
-			*pCont = touch->v.skin; // new content has more priority
-	}
-	
-	// recurse down both sides
-	if( node->axis == -1 ) return;
-	
-	if( origin[node->axis] > node->dist )
-		SV_WaterLinks( origin, pCont, node->children[0] );
-	if( origin[node->axis] < node->dist )
-		SV_WaterLinks( origin, pCont, node->children[1] );
+	return sv_grid.marks;
 }
 
 /*
-=============
-SV_TruePointContents
+===============================================================================
 
-=============
+SOLID EDICT BOUNDS
+
+===============================================================================
 */
-int SV_TruePointContents( const vec3_t p )
+#define CLIP_BATCH		64	// bounds tested at once
+
+// absbox of solid edicts in areanode list order
+typedef struct
 {
-	int	cont;
+	edict_t		**edicts;
+	float		*absmin[3];
+	float		*absmax[3];
+	int		count;
+	int		max;
+} areabounds_t;
+
+static struct
+{
+	areabounds_t	nodes[AREA_NODES];
+	int		*node;		// areanode + 1 for each edict, 0 is not linked
+	int		*slot;
+	int		maxedicts;
+	uint		stamps[AREA_NODES];	// last change of node solid list
+	uint		stamp;
+} sv_areabounds;
 
-	// sanity check
-	if( !p ) return CONTENTS_NONE;
+/*
+===============
+SV_FreeAreaBounds
+===============
+*/
+void SV_FreeAreaBounds( void )
+{
+	areabounds_t	*b;
+	int		i;
 
-	// get base contents from world
-	cont = PM_HullPointContents( &sv.worldmodel->hulls[0], 0, p );
+	for( i = 0, b = sv_areabounds.nodes; i < AREA_NODES; i++, b++ )
+	{
+		if( b->edicts ) Mem_Free( b->edicts );
+		if( b->absmin[0] ) Mem_Free( b->absmin[0] );
+	}
 
-	// check all water entities
-	SV_WaterLinks( p, &cont, sv_areanodes );
+	if( sv_areabounds.node ) Mem_Free( sv_areabounds.node );
+	if( sv_areabounds.slot ) Mem_Free( sv_areabounds.slot );
 
-	return cont;
+	Q_memset( &sv_areabounds, 0, sizeof( sv_areabounds ));
 }
 
 /*
-=============
-SV_PointContents
-
-=============
+===============
+SV_ClearAreaBounds
+===============
 */
-int SV_PointContents( const vec3_t p )
+static void SV_ClearAreaBounds( void )
 {
-	int cont = SV_TruePointContents( p );
+	int	i;
 
-	if( cont <= CONTENTS_CURRENT_0 && cont >= CONTENTS_CURRENT_DOWN )
-		cont = CONTENTS_WATER;
-	return cont;
-}
+	if( sv_areabounds.maxedicts != GI->max_edicts )
+	{
+		SV_FreeAreaBounds();
 
-//===========================================================================
+		sv_areabounds.maxedicts = GI->max_edicts;
+		sv_areabounds.node = Z_Malloc( sizeof( int ) * sv_areabounds.maxedicts );
+		sv_areabounds.slot = Z_Malloc( sizeof( int ) * sv_areabounds.maxedicts );
+		return;
+	}
 
-/*
-============
-SV_TestEntityPosition
+	for( i = 0; i < AREA_NODES; i++ )
+		sv_areabounds.nodes[i].count = 0;
 
-returns true if the entity is in solid currently
-============
+	Q_memset( sv_areabounds.node, 0, sizeof( int ) * sv_areabounds.maxedicts );
+}
+
+/*
+===============
+SV_GrowAreaBounds
+===============
 */
-qboolean SV_TestEntityPosition( edict_t *ent, edict_t *blocker )
+static void SV_GrowAreaBounds( areabounds_t *b )
 {
-	trace_t	trace;
+	float	*block;
+	int	i, max;
 
-	if( ent->v.flags & (FL_CLIENT|FL_FAKECLIENT))
+	max = max( b->max * 2, 32 );
+	block = Z_Malloc( sizeof( float ) * 6 * max );
+
+	for( i = 0; i < 3; i++ )
 	{
-		// to avoid falling through tracktrain update client mins\maxs here
-		if( ent->v.flags & FL_DUCKING ) 
-			SV_SetMinMaxSize( ent, svgame.pmove->player_mins[1], svgame.pmove->player_maxs[1] );
-		else SV_SetMinMaxSize( ent, svgame.pmove->player_mins[0], svgame.pmove->player_maxs[0] );
+		if( b->count )
+		{
+			Q_memcpy( block + i * max, b->absmin[i], sizeof( float ) * b->count );
+			Q_memcpy( block + ( i + 3 ) * max, b->absmax[i], sizeof( float ) * b->count );
+		}
 	}
 
-	trace = SV_Move( ent->v.origin, ent->v.mins, ent->v.maxs, ent->v.origin, MOVE_NORMAL|FMOVE_SIMPLEBOX, ent );
+	if( b->absmin[0] ) Mem_Free( b->absmin[0] );
 
-	if( SV_IsValidEdict( blocker ) && SV_IsValidEdict( trace.ent ))
+	for( i = 0; i < 3; i++ )
 	{
-		if( trace.ent->v.movetype == MOVETYPE_PUSH || trace.ent == blocker )
-			return trace.startsolid;
-		return false;
+		b->absmin[i] = block + i * max;
+		b->absmax[i] = block + ( i + 3 ) * max;
 	}
-	return trace.startsolid;
+
+	b->edicts = Z_Realloc( b->edicts, sizeof( edict_t* ) * max );
+	b->max = max;
 }
 
 /*
-===============================================================================
-
-LINE TESTING IN HULLS
+===============
+SV_LinkAreaBounds
 
-===============================================================================
+called when edict goes to the end of node solid list
+===============
 */
-
-/* "Not a number" possible here.
- * Enable this macro to debug it */
-#ifdef DEBUGNAN
-static void _assertNAN(const char *f, int l, const char *x)
+static void SV_LinkAreaBounds( edict_t *ent, areanode_t *node )
 {
-	MsgDev( D_WARN, "NAN detected at %s:%i (%s)\n", f, l, x );
+	areabounds_t	*b;
+	int		i, e;
+
+	e = NUM_FOR_EDICT( ent );
+	if( !sv_areabounds.node || e >= sv_areabounds.maxedicts )
+		return;
+
+	b = &sv_areabounds.nodes[node - sv_areanodes];
+	if( b->count == b->max ) SV_GrowAreaBounds( b );
+
+	for( i = 0; i < 3; i++ )
+	{
+		b->absmin[i][b->count] = ent->v.absmin[i];
+		b->absmax[i][b->count] = ent->v.absmax[i];
+	}
+
+	b->edicts[b->count] = ent;
+	sv_areabounds.node[e] = ( node - sv_areanodes ) + 1;
+	sv_areabounds.slot[e] = b->count++;
+	sv_areabounds.stamps[node - sv_areanodes] = ++sv_areabounds.stamp;
 }
-#define ASSERTNAN(x) if( !finitef(x) ) _assertNAN( __FILE__, __LINE__, #x );
-#else
-#define ASSERTNAN(x)
-#endif
+
 /*
-==================
-SV_RecursiveHullCheck
+===============
+SV_UnlinkAreaBounds
 
-==================
+keeps the list order so clipping order is not changed
+===============
 */
-qboolean SV_RecursiveHullCheck( hull_t *hull, int num, float p1f, float p2f, vec3_t p1, vec3_t p2, trace_t *trace )
+static void SV_UnlinkAreaBounds( edict_t *ent )
 {
-	dclipnode_t	*node;
-	mplane_t		*plane;
-	float		t1, t2;
-	float		frac, midf;
-	int		side;
-	vec3_t		mid;
+	areabounds_t	*b;
+	int		i, e, slot, tail;
+
+	e = NUM_FOR_EDICT( ent );
+	if( !sv_areabounds.node || e >= sv_areabounds.maxedicts || !sv_areabounds.node[e] )
+		return;
+
+	b = &sv_areabounds.nodes[sv_areabounds.node[e] - 1];
+	slot = sv_areabounds.slot[e];
+	tail = b->count - slot - 1;
+	sv_areabounds.node[e] = 0;
+	sv_areabounds.stamps[b - sv_areabounds.nodes] = ++sv_areabounds.stamp;
 
-	// check for empty
-	if( num < 0 )
+	if( tail > 0 )
 	{
-		if( num != CONTENTS_SOLID )
+		for( i = 0; i < 3; i++ )
 		{
-			trace->allsolid = false;
-			if( num == CONTENTS_EMPTY )
-				trace->inopen = true;
-			else trace->inwater = true;
+			memmove( &b->absmin[i][slot], &b->absmin[i][slot+1], sizeof( float ) * tail );
+			memmove( &b->absmax[i][slot], &b->absmax[i][slot+1], sizeof( float ) * tail );
 		}
-		else trace->startsolid = true;
-
-		return true; // empty
-	}
 
-	if( num < hull->firstclipnode || num > hull->lastclipnode )
-		Host_Error( "SV_RecursiveHullCheck: bad node number\n" );
+		memmove( &b->edicts[slot], &b->edicts[slot+1], sizeof( edict_t* ) * tail );
 
-	if( !hull->clipnodes )
-		return false;
-	// find the point distances
-	node = hull->clipnodes + num;
-	plane = hull->planes + node->planenum;
-
-	if( plane->type < 3 )
-	{
-		t1 = p1[plane->type] - plane->dist;
-		t2 = p2[plane->type] - plane->dist;
-	}
-	else
-	{
-		t1 = DotProduct( plane->normal, p1 ) - plane->dist;
-		t2 = DotProduct( plane->normal, p2 ) - plane->dist;
+		for( i = slot; i < b->count - 1; i++ )
+			sv_areabounds.slot[NUM_FOR_EDICT( b->edicts[i] )] = i;
 	}
 
-	ASSERTNAN( t1 )
-	ASSERTNAN( t2 )
-	
-	if( t1 >= 0 && t2 >= 0 )
-		return SV_RecursiveHullCheck( hull, node->children[0], p1f, p2f, p1, p2, trace );
-	if( t1 < 0 && t2 < 0 )
-		return SV_RecursiveHullCheck( hull, node->children[1], p1f, p2f, p1, p2, trace );
+	b->count--;
+}
 
-	ASSERTNAN( t1 )
-	ASSERTNAN( t2 )
+/*
+===============
+SV_AreaBoundsTest
 
-	// put the crosspoint DIST_EPSILON pixels on the near side
-	if( t1 < 0 ) frac = ( t1 + DIST_EPSILON ) / ( t1 - t2 );
-	else frac = ( t1 - DIST_EPSILON ) / ( t1 - t2 );
+marks which of the next CLIP_BATCH edicts may touch the box,
+simple loop over dense arrays so compiler can vectorize it
+===============
+*/
+static int SV_AreaBoundsTest( const areabounds_t *b, int first, const vec3_t mins, const vec3_t maxs, byte *hits )
+{
+	const float	*min0 = b->absmin[0] + first, *max0 = b->absmax[0] + first;
+	const float	*min1 = b->absmin[1] + first, *max1 = b->absmax[1] + first;
+	const float	*min2 = b->absmin[2] + first, *max2 = b->absmax[2] + first;
+	int		i, count;
 
-	ASSERTNAN( frac )
+	count = min( b->count - first, CLIP_BATCH );
 
-	if( frac < 0.0f ) frac = 0.0f;
-	if( frac > 1.0f ) frac = 1.0f;
-		
-	midf = p1f + ( p2f - p1f ) * frac;
-	VectorLerp( p1, frac, p2, mid );
+	for( i = 0; i < count; i++ )
+	{
+		hits[i] = ( min0[i] <= maxs[0] ) & ( max0[i] >= mins[0] )
+			& ( min1[i] <= maxs[1] ) & ( max1[i] >= mins[1] )
+			& ( min2[i] <= maxs[2] ) & ( max2[i] >= mins[2] );
+	}
 
-	side = (t1 < 0);
+	return count;
+}
 
-	ASSERTNAN( frac )
+/*
+===============================================================================
 
-	// move up to the node
-	if( !SV_RecursiveHullCheck( hull, node->children[side], p1f, midf, p1, mid, trace ))
-		return false;
+ADAPTIVE AREANODES
 
-	if( PM_HullPointContents( hull, node->children[side^1], mid ) != CONTENTS_SOLID )
-	{
-		// go past the node
-		return SV_RecursiveHullCheck (hull, node->children[side^1], midf, p2f, mid, p2, trace);
-	}	
+===============================================================================
+*/
+#define AREA_MAX_DEPTH	7	// 255 nodes at most
+#define AREA_LEAF_EDICTS	8	// don't split nodes with less edicts
+#define AREA_REBUILD_EDICTS	32	// node crowd which is worth a rebuild
+#define AREA_CHECK_TIME	1.0	// seconds between crowd checks
 
-	if( trace->allsolid )
-		return false; // never got out of the solid area
-		
-	//==================
-	// the other side of the node is solid, this is the impact point
-	//==================
-	if( !side )
-	{
-		VectorCopy( plane->normal, trace->plane.normal );
-		trace->plane.dist = plane->dist;
-	}
-	else
-	{
-		VectorNegate( plane->normal, trace->plane.normal );
-		trace->plane.dist = -plane->dist;
-	}
+enum
+{
+	AREA_SOLID = 0,
+	AREA_TRIGGERS,
+	AREA_WATER
+};
 
-	while( PM_HullPointContents( hull, hull->firstclipnode, mid ) == CONTENTS_SOLID )
-	{
-		ASSERTNAN( frac )
-		// shouldn't really happen, but does occasionally
-		frac -= 0.1f;
+typedef struct
+{
+	edict_t		*ent;
+	int		list;	// AREA_ list the edict was linked into
+	vec3_t		center;
+} arealink_t;
 
-		if( ( frac < 0.0f ) || IS_NAN( frac ) )
-		{
-			trace->fraction = midf;
-			VectorCopy( mid, trace->endpos );
-			MsgDev( D_WARN, "trace backed up past 0.0\n" );
-			return false;
-		}
+static struct
+{
+	arealink_t	*links;	// in old list order
+	arealink_t	*work;	// sorted by build
+	float		*sort;
+	int		maxlinks;
+	int		crowd;	// most edicts in one node after last rebuild
+	int		built[AREA_NODES];	// edicts under each node after last rebuild
+	int		depth;
+	double		nextcheck;
+
+	int		rebuilds;
+	int		spreads;	// rebuilds because a crowd has spread out
+	int		traces;
+	int		nodes;	// visited by traces
+	int		tested;	// edicts looked at by traces
+} sv_areatree;
 
-		midf = p1f + (p2f - p1f) * frac;
-		VectorLerp( p1, frac, p2, mid );
-	}
+/*
+===============
+SV_FreeAreaTree
+===============
+*/
+void SV_FreeAreaTree( void )
+{
+	if( sv_areatree.links ) Mem_Free( sv_areatree.links );
+	if( sv_areatree.work ) Mem_Free( sv_areatree.work );
+	if( sv_areatree.sort ) Mem_Free( sv_areatree.sort );
+	Q_memset( &sv_areatree, 0, sizeof( sv_areatree ));
+}
 
-	trace->fraction = midf;
-	VectorCopy( mid, trace->endpos );
+/*
+===============
+SV_CompareFloats
+===============
+*/
+static int SV_CompareFloats( const void *a, const void *b )
+{
+	float	fa = *(const float *)a;
+	float	fb = *(const float *)b;
 
-	return false;
+	return ( fa > fb ) - ( fa < fb );
 }
 
 /*
-==================
-SV_ClipMoveToEntity
+===============
+SV_CreateAdaptiveNode
 
-Handles selection or creation of a clipping hull, and offseting (and
-eventually rotation) of the end points
-==================
+same as SV_CreateAreaNode but splits at the median of edict
+centers, edicts which cross the plane stay in the node
+===============
 */
-void SV_ClipMoveToEntity( edict_t *ent, const vec3_t start, vec3_t mins, vec3_t maxs, const vec3_t end, trace_t *trace )
+static areanode_t *SV_CreateAdaptiveNode( int depth, vec3_t mins, vec3_t maxs, arealink_t *links, int count )
 {
-	hull_t	*hull = NULL;
-	model_t	*model;
-	vec3_t	start_l, end_l;
-	vec3_t	offset, temp;
-	int	last_hitgroup;
-	trace_t	trace_hitbox;
-	int	i, j, hullcount;
-	qboolean	rotated, transform_bbox;
-	matrix4x4	matrix;
+	areanode_t	*anode;
+	arealink_t	swap;
+	vec3_t		size;
+	vec3_t		mins1, maxs1;
+	vec3_t		mins2, maxs2;
+	int		i, lo, mid, hi;
+	float		low, high;
 
-	Q_memset( trace, 0, sizeof( trace_t ));
-	VectorCopy( end, trace->endpos );
-	trace->fraction = 1.0f;
-	trace->allsolid = 1;
+	anode = &sv_areanodes[sv_numareanodes++];
+	sv_areatree.depth = max( sv_areatree.depth, depth );
 
-	model = Mod_Handle( ent->v.modelindex );
+	ClearLink( &anode->trigger_edicts );
+	ClearLink( &anode->solid_edicts );
+	ClearLink( &anode->water_edicts );
 
-	if( model && model->type == mod_studio )
+	if( depth == AREA_MAX_DEPTH || count <= AREA_LEAF_EDICTS )
 	{
-		hull = SV_HullForStudioModel( ent, mins, maxs, offset, &hullcount );
+		anode->axis = -1;
+		anode->children[0] = anode->children[1] = NULL;
+		return anode;
 	}
-	else
+
+	VectorSubtract( maxs, mins, size );
+	if( size[0] > size[1] )
+		anode->axis = 0;
+	else anode->axis = 1;
+
+	for( i = 0; i < count; i++ )
+		sv_areatree.sort[i] = links[i].center[anode->axis];
+	qsort( sv_areatree.sort, count, sizeof( float ), SV_CompareFloats );
+
+	// keep children from getting too thin
+	low = mins[anode->axis] + size[anode->axis] * 0.125f;
+	high = maxs[anode->axis] - size[anode->axis] * 0.125f;
+	anode->dist = bound( low, sv_areatree.sort[count >> 1], high );
+
+	// front edicts first, then back ones, then ones that cross the plane
+	for( lo = mid = 0, hi = count - 1; mid <= hi; )
 	{
-		hull = SV_HullForEntity( ent, mins, maxs, offset );
-		hullcount = 1;
+		if( links[mid].ent->v.absmin[anode->axis] > anode->dist )
+		{
+			swap = links[lo], links[lo] = links[mid], links[mid] = swap;
+			lo++, mid++;
+		}
+		else if( links[mid].ent->v.absmax[anode->axis] < anode->dist )
+		{
+			mid++;
+		}
+		else
+		{
+			swap = links[hi], links[hi] = links[mid], links[mid] = swap;
+			hi--;
+		}
 	}
 
-	// prevent crash on incorrect hull
-	if( !hull )
-		return;
+	VectorCopy( mins, mins1 );
+	VectorCopy( mins, mins2 );
+	VectorCopy( maxs, maxs1 );
+	VectorCopy( maxs, maxs2 );
 
-	// rotate start and end into the models frame of reference
-	if( ent->v.solid == SOLID_BSP && !VectorIsNull( ent->v.angles ))
-		rotated = true;
-	else rotated = false;
+	maxs1[anode->axis] = mins2[anode->axis] = anode->dist;
+	anode->children[0] = SV_CreateAdaptiveNode( depth+1, mins2, maxs2, links, lo );
+	anode->children[1] = SV_CreateAdaptiveNode( depth+1, mins1, maxs1, links + lo, mid - lo );
 
-	if( host.features & ENGINE_TRANSFORM_TRACE_AABB )
+	return anode;
+}
+
+/*
+===============
+SV_AreaNodeCrowd
+
+most edicts linked into a single node
+===============
+*/
+static int SV_AreaNodeCrowd( void )
+{
+	areanode_t	*node;
+	link_t		*l;
+	int		i, count, crowd = 0;
+
+	for( i = 0, node = sv_areanodes; i < sv_numareanodes; i++, node++ )
 	{
-		// keep untransformed bbox less than 45 degress or train on subtransit.bsp will stop working
-		if(( check_angles( ent->v.angles[0] ) || check_angles( ent->v.angles[2] )) && !VectorIsNull( mins ))
-			transform_bbox = true;
-		else transform_bbox = false;
+		count = 0;
+		for( l = node->solid_edicts.next; l != &node->solid_edicts; l = l->next )
+			count++;
+		for( l = node->trigger_edicts.next; l != &node->trigger_edicts; l = l->next )
+			count++;
+		crowd = max( crowd, count );
 	}
-	else transform_bbox = false;
 
-	if( rotated )
-	{
-		vec3_t	out_mins, out_maxs;
+	return crowd;
+}
 
-		if( transform_bbox )
-			Matrix4x4_CreateFromEntity( matrix, ent->v.angles, ent->v.origin, 1.0f );
-		else Matrix4x4_CreateFromEntity( matrix, ent->v.angles, offset, 1.0f );
+/*
+===============
+SV_CountAreaSubtree
 
-		Matrix4x4_VectorITransform( matrix, start, start_l );
-		Matrix4x4_VectorITransform( matrix, end, end_l );
+edicts linked into node and all nodes below it
+===============
+*/
+static int SV_CountAreaSubtree( areanode_t *node, int *counts )
+{
+	link_t	*l;
+	int	count = 0;
 
-		if( transform_bbox )
-		{
-			World_TransformAABB( matrix, mins, maxs, out_mins, out_maxs );
-			VectorSubtract( hull[0].clip_mins, out_mins, offset ); // calc new local offset
+	for( l = node->solid_edicts.next; l != &node->solid_edicts; l = l->next )
+		count++;
+	for( l = node->trigger_edicts.next; l != &node->trigger_edicts; l = l->next )
+		count++;
 
-			for( j = 0; j < 3; j++ )
-			{
-				if( start_l[j] >= 0.0f )
-					start_l[j] -= offset[j];
-				else start_l[j] += offset[j];
-				if( end_l[j] >= 0.0f )
-					end_l[j] -= offset[j];
-				else end_l[j] += offset[j];
-			}
-		}
-	}
-	else
+	if( node->axis != -1 )
 	{
-		VectorSubtract( start, offset, start_l );
-		VectorSubtract( end, offset, end_l );
+		count += SV_CountAreaSubtree( node->children[0], counts );
+		count += SV_CountAreaSubtree( node->children[1], counts );
 	}
 
-	if( hullcount == 1 )
+	counts[node - sv_areanodes] = count;
+
+	return count;
+}
+
+/*
+===============
+SV_AreaCrowdSpread
+
+true if a subtree which was split around a crowd
+has lost more than half of its edicts since
+===============
+*/
+static qboolean SV_AreaCrowdSpread( void )
+{
+	int	counts[AREA_NODES];
+	int	i;
+
+	if( !sv_numareanodes )
+		return false;
+
+	SV_CountAreaSubtree( sv_areanodes, counts );
+
+	for( i = 0; i < sv_numareanodes; i++ )
 	{
-		SV_RecursiveHullCheck( hull, hull->firstclipnode, 0.0f, 1.0f, start_l, end_l, trace );
+		if( sv_areanodes[i].axis == -1 || sv_areatree.built[i] <= AREA_LEAF_EDICTS )
+			continue;
+
+		if( counts[i] * 2 < sv_areatree.built[i] )
+			return true;
 	}
-	else
-	{
-		last_hitgroup = 0;
 
-		for( i = 0; i < hullcount; i++ )
+	return false;
+}
+
+/*
+===============
+SV_CollectAreaLinks
+===============
+*/
+static int SV_CollectAreaLinks( link_t *list, int type, int count )
+{
+	arealink_t	*link;
+	link_t		*l;
+
+	for( l = list->next; l != list; l = l->next )
+	{
+		if( count == sv_areatree.maxlinks )
 		{
-			Q_memset( &trace_hitbox, 0, sizeof( trace_t ));
-			VectorCopy( end, trace_hitbox.endpos );
-			trace_hitbox.fraction = 1.0;
-			trace_hitbox.allsolid = 1;
+			sv_areatree.maxlinks = max( sv_areatree.maxlinks * 2, 256 );
+			sv_areatree.links = Z_Realloc( sv_areatree.links, sizeof( arealink_t ) * sv_areatree.maxlinks );
+			sv_areatree.work = Z_Realloc( sv_areatree.work, sizeof( arealink_t ) * sv_areatree.maxlinks );
+			sv_areatree.sort = Z_Realloc( sv_areatree.sort, sizeof( float ) * sv_areatree.maxlinks );
+		}
 
-			SV_RecursiveHullCheck( &hull[i], hull[i].firstclipnode, 0.0f, 1.0f, start_l, end_l, &trace_hitbox );
+		link = &sv_areatree.links[count++];
+		link->ent = (edict_t *)((byte *)l - ADDRESS_OF_AREA);
+		link->list = type;
+		VectorAverage( link->ent->v.absmin, link->ent->v.absmax, link->center );
+	}
 
-			if( i == 0 || trace_hitbox.allsolid || trace_hitbox.startsolid || trace_hitbox.fraction < trace->fraction )
-			{
-				if( trace->startsolid )
-				{
-					*trace = trace_hitbox;
-					trace->startsolid = true;
-				}
-				else *trace = trace_hitbox;
+	return count;
+}
 
-				last_hitgroup = i;
-			}
-		}
+/*
+===============
+SV_RebuildAreaNodes
 
-		trace->hitgroup = Mod_HitgroupForStudioHull( last_hitgroup );
+moves all linked edicts into a new tree fitted to them,
+every edict stays in the same kind of list
+===============
+*/
+static void SV_RebuildAreaNodes( void )
+{
+	arealink_t	*link;
+	areanode_t	*node;
+	int		i, count;
+
+	for( i = count = 0, node = sv_areanodes; i < sv_numareanodes; i++, node++ )
+	{
+		count = SV_CollectAreaLinks( &node->solid_edicts, AREA_SOLID, count );
+		count = SV_CollectAreaLinks( &node->trigger_edicts, AREA_TRIGGERS, count );
+		count = SV_CollectAreaLinks( &node->water_edicts, AREA_WATER, count );
 	}
 
-	if( trace->fraction != 1.0f )
+	if( count ) Q_memcpy( sv_areatree.work, sv_areatree.links, sizeof( arealink_t ) * count );
+
+	Q_memset( sv_areanodes, 0, sizeof( sv_areanodes ));
+	sv_numareanodes = 0;
+	sv_areatree.depth = 0;
+
+	SV_CreateAdaptiveNode( 0, sv.worldmodel->mins, sv.worldmodel->maxs, sv_areatree.work, count );
+	SV_ClearAreaBounds();
+
+	// relink in the old order, so clipping order changes as little as possible
+	for( i = 0, link = sv_areatree.links; i < count; i++, link++ )
 	{
-		// compute endpos (generic case)
-		VectorLerp( start, trace->fraction, end, trace->endpos );
+		node = sv_areanodes;
 
-		if( rotated )
+		while( node->axis != -1 )
 		{
-			// transform plane
-			VectorCopy( trace->plane.normal, temp );
-			Matrix4x4_TransformPositivePlane( matrix, temp, trace->plane.dist, trace->plane.normal, &trace->plane.dist );
+			if( link->ent->v.absmin[node->axis] > node->dist )
+				node = node->children[0];
+			else if( link->ent->v.absmax[node->axis] < node->dist )
+				node = node->children[1];
+			else break;
+		}
+
+		if( link->list == AREA_TRIGGERS )
+		{
+			InsertLinkBefore( &link->ent->area, &node->trigger_edicts );
+		}
+		else if( link->list == AREA_WATER )
+		{
+			InsertLinkBefore( &link->ent->area, &node->water_edicts );
 		}
 		else
 		{
-			trace->plane.dist = DotProduct( trace->endpos, trace->plane.normal );
+			InsertLinkBefore( &link->ent->area, &node->solid_edicts );
+			SV_LinkAreaBounds( link->ent, node );
 		}
 	}
 
-	if( trace->fraction < 1.0f || trace->startsolid )
-		trace->ent = ent;
+	sv_areatree.crowd = SV_AreaNodeCrowd();
+	SV_CountAreaSubtree( sv_areanodes, sv_areatree.built );
+	sv_areatree.rebuilds++;
+	SV_FlushTraceCache();
 }
 
 /*
-==================
-SV_CustomClipMoveToEntity
+===============
+SV_CheckAreaNodes
 
-A part of physics engine implementation
-or custom physics implementation
-==================
+rebuild the tree between frames when some node got crowded,
+or when the crowd it was built around has spread out
+===============
 */
-void SV_CustomClipMoveToEntity( edict_t *ent, const vec3_t start, vec3_t mins, vec3_t maxs, const vec3_t end, trace_t *trace )
+void SV_CheckAreaNodes( void )
 {
-	Q_memset( trace, 0, sizeof( trace_t ));
-	VectorCopy( end, trace->endpos );
-	trace->allsolid = true;
-	trace->fraction = 1.0f;
+	int	crowd;
 
-	if( svgame.physFuncs.ClipMoveToEntity != NULL )
+	if( !sv_adaptive_areanodes->integer || !sv.worldmodel )
+		return;
+
+	if( sv.time < sv_areatree.nextcheck )
+		return;
+
+	sv_areatree.nextcheck = sv.time + AREA_CHECK_TIME;
+	crowd = SV_AreaNodeCrowd();
+
+	// don't rebuild over and over for edicts which can't be split
+	if( crowd > AREA_REBUILD_EDICTS && crowd > sv_areatree.crowd * 2 )
 	{
-		// do custom sweep test
-		svgame.physFuncs.ClipMoveToEntity( ent, start, mins, maxs, end, trace );
+		SV_RebuildAreaNodes();
 	}
-	else
+	else if( SV_AreaCrowdSpread( ))
 	{
-		// function is missed, so we didn't hit anything
-		trace->allsolid = false;
+		SV_RebuildAreaNodes();
+		sv_areatree.spreads++;
 	}
 }
 
 /*
-====================
-SV_ClipToLinks
+===============
+SV_AreaSpreadTest
 
-Mins and maxs enclose the entire area swept by the move
-====================
+links a crowd of boxes at the world center over boxes spread
+through the world, then spreads the crowd out too, the tree
+should be rebuilt after each step
+===============
 */
-static void SV_ClipToLinks( areanode_t *node, moveclip_t *clip )
+static void SV_AreaSpreadTest( int count )
 {
-	link_t	*l, *next;
-	edict_t	*touch;
-	trace_t	trace;
+	int	i, rebuilds, spreads;
+	edict_t	**ents;
+	vec3_t	center;
 
-	// touch linked edicts
-	for( l = node->solid_edicts.next; l != &node->solid_edicts; l = next )
+	if( sv.state != ss_active || !sv_adaptive_areanodes->integer )
 	{
-		next = l->next;
+		Msg( "sv_areanode_stats: needs running server and sv_adaptive_areanodes 1\n" );
+		return;
+	}
 
-		touch = (edict_t *)((byte *)l - ADDRESS_OF_AREA);
+	count = min( count, ( svgame.globals->maxEntities - svgame.numEntities ) / 2 );
 
-		if( touch->v.groupinfo != 0 && SV_IsValidEdict( clip->passedict ) && clip->passedict->v.groupinfo != 0 )
-		{
-			if(( svs.groupop == 0 && ( touch->v.groupinfo & clip->passedict->v.groupinfo ) == 0) ||
-			( svs.groupop == 1 && (touch->v.groupinfo & clip->passedict->v.groupinfo ) != 0 ))
-				continue;
-		}
+	if( count <= AREA_REBUILD_EDICTS )
+	{
+		Msg( "sv_areanode_stats: not enough free edicts\n" );
+		return;
+	}
 
-		if( touch == clip->passedict || touch->v.solid == SOLID_NOT )
-			continue;
+	ents = Z_Malloc( sizeof( edict_t* ) * count * 2 );
+	VectorAverage( sv.worldmodel->mins, sv.worldmodel->maxs, center );
+
+	// first half is spread, second is the crowd
+	for( i = 0; i < count * 2; i++ )
+	{
+		ents[i] = SV_AllocEdict();
+		ents[i]->v.solid = SOLID_BBOX;
+		VectorSet( ents[i]->v.mins, -16.0f, -16.0f, -16.0f );
+		VectorSet( ents[i]->v.maxs, 16.0f, 16.0f, 16.0f );
+		VectorSet( ents[i]->v.size, 32.0f, 32.0f, 32.0f );
+	}
 
-		if( touch->v.solid == SOLID_TRIGGER )
+	for( i = 0; i < count * 2; i++ )
+	{
+		if( i < count )
 		{
-			Host_MapDesignError( "trigger in clipping list\n" );
-			touch->v.solid = SOLID_NOT;
+			ents[i]->v.origin[0] = Com_RandomFloat( sv.worldmodel->mins[0], sv.worldmodel->maxs[0] );
+			ents[i]->v.origin[1] = Com_RandomFloat( sv.worldmodel->mins[1], sv.worldmodel->maxs[1] );
 		}
-
-		// custom user filter
-		if( svgame.dllFuncs2.pfnShouldCollide )
+		else
 		{
-			if( !svgame.dllFuncs2.pfnShouldCollide( touch, clip->passedict ))
-				continue;	// originally this was 'return' but is completely wrong!
+			ents[i]->v.origin[0] = center[0] + Com_RandomFloat( -64.0f, 64.0f );
+			ents[i]->v.origin[1] = center[1] + Com_RandomFloat( -64.0f, 64.0f );
 		}
 
-		// monsterclip filter (solid custom is a static or dynamic bodies)
-		if( touch->v.solid == SOLID_BSP || touch->v.solid == SOLID_CUSTOM )
-		{
-			if( touch->v.flags & FL_MONSTERCLIP )
-			{
-				// func_monsterclip works only with monsters that have same flag!
-				if( !SV_IsValidEdict( clip->passedict ) || !( clip->passedict->v.flags & FL_MONSTERCLIP ))
-					continue;
-			}
-		}
-		else
-		{
-			// ignore all monsters but pushables
-			if( clip->type == MOVE_NOMONSTERS && touch->v.movetype != MOVETYPE_PUSHSTEP )
-				continue;
-		}
+		ents[i]->v.origin[2] = center[2];
+		SV_LinkEdict( ents[i], false );
+	}
+
+	rebuilds = sv_areatree.rebuilds;
+	sv_areatree.nextcheck = 0.0;
+	SV_CheckAreaNodes();
+
+	Msg( "%i crowded: %i rebuilds, crowd %i, depth %i\n", count, sv_areatree.rebuilds - rebuilds,
+		sv_areatree.crowd, sv_areatree.depth );
+
+	for( i = count; i < count * 2; i++ )
+	{
+		ents[i]->v.origin[0] = Com_RandomFloat( sv.worldmodel->mins[0], sv.worldmodel->maxs[0] );
+		ents[i]->v.origin[1] = Com_RandomFloat( sv.worldmodel->mins[1], sv.worldmodel->maxs[1] );
+		SV_LinkEdict( ents[i], false );
+	}
+
+	rebuilds = sv_areatree.rebuilds;
+	spreads = sv_areatree.spreads;
+	sv_areatree.nextcheck = 0.0;
+	SV_CheckAreaNodes();
+
+	Msg( "%i spread out: %i rebuilds, %i for spread crowd, crowd %i, depth %i\n", count, sv_areatree.rebuilds - rebuilds,
+		sv_areatree.spreads - spreads, sv_areatree.crowd, sv_areatree.depth );
+
+	for( i = 0; i < count * 2; i++ )
+		SV_FreeEdict( ents[i] );
+	Mem_Free( ents );
+
+	sv_areatree.nextcheck = 0.0;
+	SV_CheckAreaNodes();
+}
+
+/*
+===============
+SV_AreaNodeStats_f
+===============
+*/
+void SV_AreaNodeStats_f( void )
+{
+	if( Cmd_Argc() > 1 && !Q_stricmp( Cmd_Argv( 1 ), "reset" ))
+	{
+		sv_areatree.traces = sv_areatree.nodes = sv_areatree.tested = 0;
+		return;
+	}
+
+	if( Cmd_Argc() > 1 && !Q_stricmp( Cmd_Argv( 1 ), "spread" ))
+	{
+		SV_AreaSpreadTest(( Cmd_Argc() > 2 ) ? Q_atoi( Cmd_Argv( 2 )) : 128 );
+		return;
+	}
+
+	Msg( "areanodes: %i nodes, depth %i, %i rebuilds, %i for spread crowds\n", sv_numareanodes,
+		sv_areatree.depth, sv_areatree.rebuilds, sv_areatree.spreads );
+	Msg( "crowd: %i edicts now, %i after rebuild\n", SV_AreaNodeCrowd(), sv_areatree.crowd );
+
+	if( sv_areatree.traces )
+	{
+		Msg( "%i traces, %.1f nodes and %.1f edicts tested per trace\n", sv_areatree.traces,
+			(float)sv_areatree.nodes / sv_areatree.traces, (float)sv_areatree.tested / sv_areatree.traces );
+	}
+}
+
+/*
+===============
+SV_ClearWorld
+
+===============
+*/
+void SV_ClearWorld( void )
+{
+	int	i;
+
+	SV_InitBoxHull(); // for box testing
+
+	// clear lightstyles
+	for( i = 0; i < MAX_LIGHTSTYLES; i++ )
+	{
+		sv.lightstyles[i].value = 256.0f;
+		sv.lightstyles[i].time = 0.0f;
+	}
+
+	Q_memset( sv_areanodes, 0, sizeof( sv_areanodes ));
+	iTouchLinkSemaphore = 0;
+	sv_numareanodes = 0;
+
+	SV_CreateAreaNode( 0, sv.worldmodel->mins, sv.worldmodel->maxs );
+	sv_areatree.depth = AREA_DEPTH;
+	sv_areatree.crowd = 0;
+	Q_memset( sv_areatree.built, 0, sizeof( sv_areatree.built ));
+	sv_areatree.nextcheck = 0.0;
+	SV_ClearLeafEdicts();
+	SV_ClearEdictGrid();
+	SV_ClearAreaBounds();
+	SV_FlushTraceCache();
+}
+
+/*
+===============
+SV_UnlinkEdict
+===============
+*/
+void SV_UnlinkEdict( edict_t *ent )
+{
+	// not linked in anywhere
+	if( !ent->area.prev ) return;
+
+	SV_TouchPhysEnt( ent );
+	if( ent->v.solid != SOLID_TRIGGER )
+		SV_FlushTraceCache();
+
+	SV_UnlinkAreaBounds( ent );
+	RemoveLink( &ent->area );
+	ent->area.prev = NULL;
+	ent->area.next = NULL;
+}
+
+/*
+====================
+SV_TouchLinks
+====================
+*/
+void SV_TouchLinks( edict_t *ent, areanode_t *node )
+{
+	link_t	*l, *next;
+	edict_t	*touch;
+	hull_t	*hull;
+	vec3_t	test, offset;
+
+	// touch linked edicts
+	for( l = node->trigger_edicts.next; l != &node->trigger_edicts; l = next )
+	{
+		next = l->next;
+		touch = (edict_t *)((byte *)l - ADDRESS_OF_AREA);
+
+		if( svgame.physFuncs.SV_TriggerTouch != NULL )
+		{
+			// user dll can override trigger checking (Xash3D extension)
+			if( !svgame.physFuncs.SV_TriggerTouch( ent, touch ))
+				continue;
+		}
+		else
+		{
+			if( touch == ent || touch->v.solid != SOLID_TRIGGER ) // disabled ?
+				continue;
+
+			if( touch->v.groupinfo && ent->v.groupinfo )
+			{
+				if(( !svs.groupop && !(touch->v.groupinfo & ent->v.groupinfo)) ||
+				(svs.groupop == 1 && (touch->v.groupinfo & ent->v.groupinfo)))
+					continue;
+			}
+
+			if( !BoundsIntersect( ent->v.absmin, ent->v.absmax, touch->v.absmin, touch->v.absmax ))
+				continue;
+
+			// check brush triggers accuracy
+			if( Mod_GetType( touch->v.modelindex ) == mod_brush )
+			{
+				model_t *mod = Mod_Handle( touch->v.modelindex );
+
+				// force to select bsp-hull
+				hull = SV_HullForBsp( touch, ent->v.mins, ent->v.maxs, offset );
+
+				// support for rotational triggers
+				if(( mod->flags & MODEL_HAS_ORIGIN ) && !VectorIsNull( touch->v.angles ))
+				{
+					matrix4x4	matrix;
+					Matrix4x4_CreateFromEntity( matrix, touch->v.angles, offset, 1.0f );
+					Matrix4x4_VectorITransform( matrix, ent->v.origin, test );
+				}
+				else
+				{
+					// offset the test point appropriately for this hull.
+					VectorSubtract( ent->v.origin, offset, test );
+				}
+
+				// test hull for intersection with this model
+				if( PM_HullPointContents( hull, hull->firstclipnode, test ) != CONTENTS_SOLID )
+					continue;
+			}
+		}
+
+		// never touch the triggers when "playersonly" is active
+		if( !( sv.hostflags & SVF_PLAYERSONLY ))
+		{
+			svgame.globals->time = sv.time;
+			svgame.dllFuncs.pfnTouch( touch, ent );
+		}
+	}
+	
+	// recurse down both sides
+	if( node->axis == -1 ) return;
+	
+	if( ent->v.absmax[node->axis] > node->dist )
+		SV_TouchLinks( ent, node->children[0] );
+	if( ent->v.absmin[node->axis] < node->dist )
+		SV_TouchLinks( ent, node->children[1] );
+}
+
+/*
+===============
+SV_FindTouchedLeafs
+
+===============
+*/
+void SV_FindTouchedLeafs( edict_t *ent, mnode_t *node, int *headnode )
+{
+	mplane_t	*splitplane;
+	int	sides, leafnum;
+	mleaf_t	*leaf;
+
+	if( !node ) // if no collision model
+		return;
+
+	if( node->contents == CONTENTS_SOLID )
+		return;
+	
+	// add an efrag if the node is a leaf
+	if(  node->contents < 0 )
+	{
+		if( ent->num_leafs > ( MAX_ENT_LEAFS - 1 ))
+		{
+			// continue counting leafs,
+			// so we know how many it's overrun
+			ent->num_leafs = (MAX_ENT_LEAFS + 1);
+		}
+		else
+		{
+			leaf = (mleaf_t *)node;
+			leafnum = leaf - sv.worldmodel->leafs - 1;
+			ent->leafnums[ent->num_leafs] = leafnum;
+			ent->num_leafs++;			
+		}
+		return;
+	}
+	
+	// NODE_MIXED
+	splitplane = node->plane;
+	sides = BOX_ON_PLANE_SIDE( ent->v.absmin, ent->v.absmax, splitplane );
+
+	if( sides == 3 && *headnode == -1 )
+		*headnode = node - sv.worldmodel->nodes;
+	
+	// recurse down the contacted sides
+	if( sides & 1 ) SV_FindTouchedLeafs( ent, node->children[0], headnode );
+	if( sides & 2 ) SV_FindTouchedLeafs( ent, node->children[1], headnode );
+}
+
+/*
+=============
+SV_HeadnodeVisible
+=============
+*/
+qboolean SV_HeadnodeVisible( mnode_t *node, byte *visbits, int *lastleaf )
+{
+	int	leafnum;
+
+	if( !node || node->contents == CONTENTS_SOLID )
+		return false;
+
+	if( node->contents < 0 )
+	{
+		leafnum = ((mleaf_t *)node - sv.worldmodel->leafs) - 1;
+
+		if(!( visbits[leafnum >> 3] & (1U << ( leafnum & 7 ))))
+			return false;
+
+		if( lastleaf )
+			*lastleaf = leafnum;
+		return true;
+	}
+
+	if( SV_HeadnodeVisible( node->children[0], visbits, lastleaf ))
+		return true;
+
+	return SV_HeadnodeVisible( node->children[1], visbits, lastleaf );
+}
+
+/*
+===============
+SV_LinkEdict
+===============
+*/
+void SV_LinkEdict( edict_t *ent, qboolean touch_triggers )
+{
+	areanode_t	*node;
+	int		headnode;
+
+	if( ent->area.prev ) SV_UnlinkEdict( ent );	// unlink from old position
+	if( ent == svgame.edicts ) return;		// don't add the world
+	if( !SV_IsValidEdict( ent )) return;		// never add freed ents
+
+	SV_TouchPhysEnt( ent );
+
+	// set the abs box
+	svgame.dllFuncs.pfnSetAbsBox( ent );
+
+	if( ent->v.movetype == MOVETYPE_FOLLOW && SV_IsValidEdict( ent->v.aiment ))
+	{
+		ent->headnode = ent->v.aiment->headnode;
+		ent->num_leafs = ent->v.aiment->num_leafs;
+		Q_memcpy( ent->leafnums, ent->v.aiment->leafnums, sizeof( ent->leafnums ));
+	}
+	else
+	{
+		// link to PVS leafs
+		ent->num_leafs = 0;
+		ent->headnode = -1;
+		headnode = -1;
+
+		if( ent->v.modelindex )
+			SV_FindTouchedLeafs( ent, sv.worldmodel->nodes, &headnode );
+
+		if( ent->num_leafs > MAX_ENT_LEAFS )
+		{
+			Q_memset( ent->leafnums, -1, sizeof( ent->leafnums ));
+			ent->num_leafs = 0;	// so we use headnode instead
+			ent->headnode = headnode;
+		}
+	}
+
+	SV_LinkLeafEdict( ent );
+	SV_GridEdict( ent );
+
+	// ignore non-solid bodies
+	if( ent->v.solid == SOLID_NOT && ent->v.skin >= CONTENTS_EMPTY )
+		return;
+
+	// find the first node that the ent's box crosses
+	node = sv_areanodes;
+
+	while( 1 )
+	{
+		if( node->axis == -1 ) break;
+		if( ent->v.absmin[node->axis] > node->dist )
+			node = node->children[0];
+		else if( ent->v.absmax[node->axis] < node->dist )
+			node = node->children[1];
+		else break; // crosses the node
+	}
+	
+	// link it in	
+	if( ent->v.solid == SOLID_TRIGGER )
+		InsertLinkBefore( &ent->area, &node->trigger_edicts );
+	else if( ent->v.solid == SOLID_NOT && ent->v.skin < CONTENTS_EMPTY )
+		InsertLinkBefore( &ent->area, &node->water_edicts );
+	else
+	{
+		InsertLinkBefore( &ent->area, &node->solid_edicts );
+		SV_LinkAreaBounds( ent, node );
+	}
+
+	if( ent->v.solid != SOLID_TRIGGER )
+		SV_FlushTraceCache();
+
+	if( touch_triggers && !iTouchLinkSemaphore )
+	{
+		iTouchLinkSemaphore = true;
+		SV_TouchLinks( ent, sv_areanodes );
+		iTouchLinkSemaphore = false;
+	}
+}
+
+/*
+===============================================================================
+
+POINT TESTING IN HULLS
+
+===============================================================================
+*/
+void SV_WaterLinks( const vec3_t origin, int *pCont, areanode_t *node )
+{
+	link_t	*l, *next;
+	edict_t	*touch;
+	hull_t	*hull;
+	vec3_t	test, offset;
+	model_t	*mod;
+
+	Q_memset( offset, 0, 3 * sizeof( float ) );
+
+	// get water edicts
+	for( l = node->water_edicts.next; l != &node->water_edicts; l = next )
+	{
+		next = l->next;
+		touch = (edict_t *)((byte *)l - ADDRESS_OF_AREA);
+
+		if( touch->v.solid != SOLID_NOT ) // disabled ?
+			continue;
+
+		if( touch->v.groupinfo )
+		{
+			if(( !svs.groupop && !(touch->v.groupinfo & svs.groupmask)) ||
+			(svs.groupop == 1 && (touch->v.groupinfo & svs.groupmask)))
+				continue;
+		}
+
+		// only brushes can have special contents
+		if( Mod_GetType( touch->v.modelindex ) != mod_brush )
+			continue;
+
+		if( !BoundsIntersect( origin, origin, touch->v.absmin, touch->v.absmax ))
+			continue;
+
+		mod = Mod_Handle( touch->v.modelindex );
+
+		// check water brushes accuracy
+		if( Mod_GetType( touch->v.modelindex ) == mod_brush )
+			hull = SV_HullForBsp( touch, vec3_origin, vec3_origin, offset );
+		else
+		{
+			Host_MapDesignError( "Water must have BSP model!\n" );
+			hull = SV_HullForBox( touch->v.mins, touch->v.maxs );
+		}
+
+		// support for rotational water
+		if(( mod->flags & MODEL_HAS_ORIGIN ) && !VectorIsNull( touch->v.angles ))
+		{
+			matrix4x4	matrix;
+			Matrix4x4_CreateFromEntity( matrix, touch->v.angles, offset, 1.0f );
+			Matrix4x4_VectorITransform( matrix, origin, test );
+		}
+		else
+		{
+			// offset the test point appropriately for this hull.
+			VectorSubtract( origin, offset, test );
+		}
+
+		// test hull for intersection with this model
+		if( PM_HullPointContents( hull, hull->firstclipnode, test ) == CONTENTS_EMPTY )
+			continue;
+
+		// compare contents ranking
+		if( RankForContents( touch->v.skin ) > RankForContents( *pCont ))
+			*pCont = touch->v.skin; // new content has more priority
+	}
+	
+	// recurse down both sides
+	if( node->axis == -1 ) return;
+	
+	if( origin[node->axis] > node->dist )
+		SV_WaterLinks( origin, pCont, node->children[0] );
+	if( origin[node->axis] < node->dist )
+		SV_WaterLinks( origin, pCont, node->children[1] );
+}
+
+/*
+=============
+SV_TruePointContents
+
+=============
+*/
+int SV_TruePointContents( const vec3_t p )
+{
+	int	cont;
+
+	// sanity check
+	if( !p ) return CONTENTS_NONE;
+
+	// get base contents from world
+	cont = PM_HullPointContents( &sv.worldmodel->hulls[0], 0, p );
+
+	// check all water entities
+	SV_WaterLinks( p, &cont, sv_areanodes );
+
+	return cont;
+}
+
+/*
+=============
+SV_PointContents
+
+=============
+*/
+int SV_PointContents( const vec3_t p )
+{
+	int cont = SV_TruePointContents( p );
+
+	if( cont <= CONTENTS_CURRENT_0 && cont >= CONTENTS_CURRENT_DOWN )
+		cont = CONTENTS_WATER;
+	return cont;
+}
+
+//===========================================================================
+
+/*
+============
+SV_TestEntityPosition
+
+returns true if the entity is in solid currently
+============
+*/
+qboolean SV_TestEntityPosition( edict_t *ent, edict_t *blocker )
+{
+	trace_t	trace;
+
+	if( ent->v.flags & (FL_CLIENT|FL_FAKECLIENT))
+	{
+		// to avoid falling through tracktrain update client mins\maxs here
+		if( ent->v.flags & FL_DUCKING ) 
+			SV_SetMinMaxSize( ent, svgame.pmove->player_mins[1], svgame.pmove->player_maxs[1] );
+		else SV_SetMinMaxSize( ent, svgame.pmove->player_mins[0], svgame.pmove->player_maxs[0] );
+	}
+
+	trace = SV_Move( ent->v.origin, ent->v.mins, ent->v.maxs, ent->v.origin, MOVE_NORMAL|FMOVE_SIMPLEBOX, ent );
+
+	if( SV_IsValidEdict( blocker ) && SV_IsValidEdict( trace.ent ))
+	{
+		if( trace.ent->v.movetype == MOVETYPE_PUSH || trace.ent == blocker )
+			return trace.startsolid;
+		return false;
+	}
+	return trace.startsolid;
+}
+
+/*
+===============================================================================
+
+LINE TESTING IN HULLS
+
+===============================================================================
+*/
+
+/*
+==================
+SV_RecursiveHullCheck
+==================
+*/
+qboolean SV_RecursiveHullCheck( hull_t *hull, int num, float p1f, float p2f, vec3_t p1, vec3_t p2, trace_t *trace )
+{
+	hulltrace_t	tr;
+	qboolean		result;
+
+	if( num >= 0 )
+	{
+		if( num < hull->firstclipnode || num > hull->lastclipnode )
+		{
+			// prefetched and batched moves call it from jobs
+			Sys_JobError( "SV_RecursiveHullCheck: bad node number\n" );
+			trace->allsolid = trace->startsolid = false;
+			return true;
+		}
+
+		if( !hull->clipnodes )
+			return false;
+	}
+
+	tr.allsolid = trace->allsolid;
+	tr.startsolid = trace->startsolid;
+	tr.inopen = trace->inopen;
+	tr.inwater = trace->inwater;
+	tr.fraction = trace->fraction;
+	VectorCopy( trace->endpos, tr.endpos );
+	VectorCopy( trace->plane.normal, tr.normal );
+	tr.dist = trace->plane.dist;
+
+	result = World_HullTrace( hull, num, p1f, p2f, p1, p2, &tr );
+
+	trace->allsolid = tr.allsolid;
+	trace->startsolid = tr.startsolid;
+	trace->inopen = tr.inopen;
+	trace->inwater = tr.inwater;
+	trace->fraction = tr.fraction;
+	VectorCopy( tr.endpos, trace->endpos );
+	VectorCopy( tr.normal, trace->plane.normal );
+	trace->plane.dist = tr.dist;
+
+	return result;
+}
+
+/*
+==================
+SV_ClipMoveToEntity
+
+Handles selection or creation of a clipping hull, and offseting (and
+eventually rotation) of the end points
+==================
+*/
+void SV_ClipMoveToEntity( edict_t *ent, const vec3_t start, vec3_t mins, vec3_t maxs, const vec3_t end, trace_t *trace )
+{
+	hull_t	*hull = NULL;
+	model_t	*model;
+	vec3_t	start_l, end_l;
+	vec3_t	offset, temp;
+	int	last_hitgroup;
+	trace_t	trace_hitbox;
+	int	i, j, hullcount;
+	qboolean	rotated, transform_bbox;
+	matrix4x4	matrix;
+
+	Q_memset( trace, 0, sizeof( trace_t ));
+	VectorCopy( end, trace->endpos );
+	trace->fraction = 1.0f;
+	trace->allsolid = 1;
+
+	model = Mod_Handle( ent->v.modelindex );
+
+	if( model && model->type == mod_studio )
+	{
+		hull = SV_HullForStudioModel( ent, mins, maxs, offset, &hullcount );
+	}
+	else
+	{
+		hull = SV_HullForEntity( ent, mins, maxs, offset );
+		hullcount = 1;
+	}
+
+	// prevent crash on incorrect hull
+	if( !hull )
+		return;
+
+	// rotate start and end into the models frame of reference
+	if( ent->v.solid == SOLID_BSP && !VectorIsNull( ent->v.angles ))
+		rotated = true;
+	else rotated = false;
+
+	if( host.features & ENGINE_TRANSFORM_TRACE_AABB )
+	{
+		// keep untransformed bbox less than 45 degress or train on subtransit.bsp will stop working
+		if(( check_angles( ent->v.angles[0] ) || check_angles( ent->v.angles[2] )) && !VectorIsNull( mins ))
+			transform_bbox = true;
+		else transform_bbox = false;
+	}
+	else transform_bbox = false;
+
+	if( rotated )
+	{
+		vec3_t	out_mins, out_maxs;
+
+		if( transform_bbox )
+			Matrix4x4_CreateFromEntity( matrix, ent->v.angles, ent->v.origin, 1.0f );
+		else Matrix4x4_CreateFromEntity( matrix, ent->v.angles, offset, 1.0f );
+
+		Matrix4x4_VectorITransform( matrix, start, start_l );
+		Matrix4x4_VectorITransform( matrix, end, end_l );
+
+		if( transform_bbox )
+		{
+			World_TransformAABB( matrix, mins, maxs, out_mins, out_maxs );
+			VectorSubtract( hull[0].clip_mins, out_mins, offset ); // calc new local offset
+
+			for( j = 0; j < 3; j++ )
+			{
+				if( start_l[j] >= 0.0f )
+					start_l[j] -= offset[j];
+				else start_l[j] += offset[j];
+				if( end_l[j] >= 0.0f )
+					end_l[j] -= offset[j];
+				else end_l[j] += offset[j];
+			}
+		}
+	}
+	else
+	{
+		VectorSubtract( start, offset, start_l );
+		VectorSubtract( end, offset, end_l );
+	}
+
+	if( hullcount == 1 )
+	{
+		SV_RecursiveHullCheck( hull, hull->firstclipnode, 0.0f, 1.0f, start_l, end_l, trace );
+	}
+	else
+	{
+		last_hitgroup = 0;
+
+		for( i = 0; i < hullcount; i++ )
+		{
+			Q_memset( &trace_hitbox, 0, sizeof( trace_t ));
+			VectorCopy( end, trace_hitbox.endpos );
+			trace_hitbox.fraction = 1.0;
+			trace_hitbox.allsolid = 1;
+
+			SV_RecursiveHullCheck( &hull[i], hull[i].firstclipnode, 0.0f, 1.0f, start_l, end_l, &trace_hitbox );
+
+			if( i == 0 || trace_hitbox.allsolid || trace_hitbox.startsolid || trace_hitbox.fraction < trace->fraction )
+			{
+				if( trace->startsolid )
+				{
+					*trace = trace_hitbox;
+					trace->startsolid = true;
+				}
+				else *trace = trace_hitbox;
+
+				last_hitgroup = i;
+			}
+		}
+
+		trace->hitgroup = Mod_HitgroupForStudioHull( last_hitgroup );
+	}
+
+	if( trace->fraction != 1.0f )
+	{
+		// compute endpos (generic case)
+		VectorLerp( start, trace->fraction, end, trace->endpos );
+
+		if( rotated )
+		{
+			// transform plane
+			VectorCopy( trace->plane.normal, temp );
+			Matrix4x4_TransformPositivePlane( matrix, temp, trace->plane.dist, trace->plane.normal, &trace->plane.dist );
+		}
+		else
+		{
+			trace->plane.dist = DotProduct( trace->endpos, trace->plane.normal );
+		}
+	}
+
+	if( trace->fraction < 1.0f || trace->startsolid )
+		trace->ent = ent;
+}
+
+/*
+==================
+SV_CustomClipMoveToEntity
+
+A part of physics engine implementation
+or custom physics implementation
+==================
+*/
+void SV_CustomClipMoveToEntity( edict_t *ent, const vec3_t start, vec3_t mins, vec3_t maxs, const vec3_t end, trace_t *trace )
+{
+	Q_memset( trace, 0, sizeof( trace_t ));
+	VectorCopy( end, trace->endpos );
+	trace->allsolid = true;
+	trace->fraction = 1.0f;
+
+	if( svgame.physFuncs.ClipMoveToEntity != NULL )
+	{
+		// do custom sweep test
+		svgame.physFuncs.ClipMoveToEntity( ent, start, mins, maxs, end, trace );
+	}
+	else
+	{
+		// function is missed, so we didn't hit anything
+		trace->allsolid = false;
+	}
+}
+
+/*
+====================
+SV_CanClipEdict
+
+filters out edicts which the move should pass through
+====================
+*/
+static qboolean SV_CanClipEdict( edict_t *touch, moveclip_t *clip )
+{
+	if( touch->v.groupinfo != 0 && SV_IsValidEdict( clip->passedict ) && clip->passedict->v.groupinfo != 0 )
+	{
+		if(( svs.groupop == 0 && ( touch->v.groupinfo & clip->passedict->v.groupinfo ) == 0) ||
+		( svs.groupop == 1 && (touch->v.groupinfo & clip->passedict->v.groupinfo ) != 0 ))
+			return false;
+	}
+
+	if( touch == clip->passedict || touch->v.solid == SOLID_NOT )
+		return false;
+
+	if( touch->v.solid == SOLID_TRIGGER )
+	{
+		if( clip->threaded )
+		{
+			clip->unsafe = true;
+			return false;
+		}
+
+		Host_MapDesignError( "trigger in clipping list\n" );
+		touch->v.solid = SOLID_NOT;
+	}
+
+	// custom user filter
+	if( svgame.dllFuncs2.pfnShouldCollide )
+	{
+		if( clip->threaded )
+		{
+			clip->unsafe = true;
+			return false;
+		}
+
+		if( !svgame.dllFuncs2.pfnShouldCollide( touch, clip->passedict ))
+			return false;	// originally this was 'return' but is completely wrong!
+	}
+
+	// monsterclip filter (solid custom is a static or dynamic bodies)
+	if( touch->v.solid == SOLID_BSP || touch->v.solid == SOLID_CUSTOM )
+	{
+		if( touch->v.flags & FL_MONSTERCLIP )
+		{
+			// func_monsterclip works only with monsters that have same flag!
+			if( !SV_IsValidEdict( clip->passedict ) || !( clip->passedict->v.flags & FL_MONSTERCLIP ))
+				return false;
+		}
+	}
+	else
+	{
+		// ignore all monsters but pushables
+		if( clip->type == MOVE_NOMONSTERS && touch->v.movetype != MOVETYPE_PUSHSTEP )
+			return false;
+	}
+
+	if( Mod_GetType( touch->v.modelindex ) == mod_brush && clip->flags & FMOVE_IGNORE_GLASS )
+	{
+		// we ignore brushes with rendermode != kRenderNormal and without FL_WORLDBRUSH set
+		if( touch->v.rendermode != kRenderNormal && !( touch->v.flags & FL_WORLDBRUSH ))
+			return false;
+	}
+
+	if( !BoundsIntersect( clip->boxmins, clip->boxmaxs, touch->v.absmin, touch->v.absmax ))
+		return false;
+
+	// Xash3D extension
+	if( SV_IsValidEdict( clip->passedict ) && clip->passedict->v.solid == SOLID_TRIGGER )
+	{
+		// never collide items and player (because call "give" always stuck item in player
+		// and total trace returns fail (old half-life bug)
+		// items touch should be done in SV_TouchLinks not here
+		if( touch->v.flags & ( FL_CLIENT|FL_FAKECLIENT ))
+			return false;
+	}
+
+	// g-cont. make sure what size is really zero - check all the components
+	if( SV_IsValidEdict( clip->passedict ) && !VectorIsNull( clip->passedict->v.size ) && VectorIsNull( touch->v.size ))
+		return false;	// points never interact
+
+	if( SV_IsValidEdict( clip->passedict ))
+	{
+	 	if( touch->v.owner == clip->passedict )
+			return false;	// don't clip against own missiles
+		if( clip->passedict->v.owner == touch )
+			return false;	// don't clip against owner
+	}
+
+	return true;
+}
+
+/*
+====================
+SV_CanClipThreaded
+
+custom clipping, studio hitboxes and map errors
+must stay on the main thread
+====================
+*/
+static qboolean SV_CanClipThreaded( edict_t *touch, moveclip_t *clip )
+{
+	model_t	*mod = Mod_Handle( touch->v.modelindex );
+
+	if( touch->v.solid == SOLID_CUSTOM )
+		return false;
+
+	if( touch->v.solid == SOLID_BSP )
+	{
+		if( !mod || mod->type != mod_brush )
+			return false;
+		if( touch->v.movetype != MOVETYPE_PUSH && touch->v.movetype != MOVETYPE_PUSHSTEP )
+			return false;
+		return true;
+	}
+
+	if( mod && mod->type == mod_studio )
+	{
+		if( mod->flags & STUDIO_TRACE_HITBOX )
+			return false;
+
+		// point traces go for hitboxes
+		if( VectorCompare( clip->mins, clip->maxs ) || (( touch->v.flags & FL_MONSTER ) && VectorCompare( clip->mins2, clip->maxs2 )))
+			return false;
+	}
+
+	return true;
+}
+
+/*
+====================
+SV_ClipToEdict
+
+do an exact clip and merge it into the move
+====================
+*/
+static void SV_ClipToEdict( edict_t *touch, moveclip_t *clip )
+{
+	trace_t	trace;
+
+	if( clip->threaded && !SV_CanClipThreaded( touch, clip ))
+	{
+		clip->unsafe = true;
+		return;
+	}
+
+	if( touch->v.solid == SOLID_CUSTOM )
+		SV_CustomClipMoveToEntity( touch, clip->start, clip->mins, clip->maxs, clip->end, &trace );
+	else if( touch->v.flags & FL_MONSTER )
+		SV_ClipMoveToEntity( touch, clip->start, clip->mins2, clip->maxs2, clip->end, &trace );
+	else SV_ClipMoveToEntity( touch, clip->start, clip->mins, clip->maxs, clip->end, &trace );
+
+	clip->trace = World_CombineTraces( &clip->trace, &trace, touch );
+}
+
+/*
+====================
+SV_ClipToNodeList
+
+clip against edicts linked to the node
+====================
+*/
+static void SV_ClipToNodeList( areanode_t *node, moveclip_t *clip )
+{
+	link_t	*l, *next;
+	edict_t	*touch;
+
+	for( l = node->solid_edicts.next; l != &node->solid_edicts; l = next )
+	{
+		next = l->next;
+
+		touch = (edict_t *)((byte *)l - ADDRESS_OF_AREA);
+		if( !clip->threaded ) sv_areatree.tested++;
+
+		if( !SV_CanClipEdict( touch, clip ))
+			continue;
+
+		// might intersect, so do an exact clip
+		if( clip->trace.allsolid || clip->unsafe ) return;
+
+		SV_ClipToEdict( touch, clip );
+	}
+}
+
+/*
+====================
+SV_ClipToNodeBounds
+
+clip against edicts which pass the node bounds test,
+returns false if edicts of the node were relinked while
+clipping and the hits are out of date
+====================
+*/
+static qboolean SV_ClipToNodeBounds( areanode_t *node, moveclip_t *clip )
+{
+	int		num = node - sv_areanodes;
+	areabounds_t	*b = &sv_areabounds.nodes[num];
+	uint		stamp = sv_areabounds.stamps[num];
+	byte		hits[CLIP_BATCH];
+	int		i, first, count;
+	edict_t		*touch;
+
+	if( !clip->threaded ) sv_areatree.tested += b->count;
+
+	// reject by bounds first, only survivors touch the edicts
+	for( first = 0; first < b->count; first += count )
+	{
+		count = SV_AreaBoundsTest( b, first, clip->boxmins, clip->boxmaxs, hits );
+
+		for( i = 0; i < count; i++ )
+		{
+			if( !hits[i] )
+				continue;
+
+			touch = b->edicts[first + i];
+
+			if( !SV_CanClipEdict( touch, clip ))
+				continue;
+
+			// might intersect, so do an exact clip
+			if( clip->trace.allsolid || clip->unsafe ) return true;
+
+			SV_ClipToEdict( touch, clip );
+
+			// custom clipping may relink edicts, unlinking shifts the arrays
+			if( sv_areabounds.stamps[num] != stamp )
+				return false;
+		}
+	}
+
+	return true;
+}
+
+/*
+====================
+SV_ClipToLinks
+
+Mins and maxs enclose the entire area swept by the move
+====================
+*/
+static void SV_ClipToLinks( areanode_t *node, moveclip_t *clip )
+{
+	int	i;
+
+	if( clip->visited )
+	{
+		i = node - sv_areanodes;
+		clip->visited[i >> 3] |= BIT( i & 7 );
+	}
+	else sv_areatree.nodes++;
+
+	if( sv_clipbounds->integer && sv_areabounds.node )
+	{
+		// edicts clipped before the change are clipped again, it's harmless
+		if( !SV_ClipToNodeBounds( node, clip ))
+			SV_ClipToNodeList( node, clip );
+	}
+	else SV_ClipToNodeList( node, clip );
+
+	// recurse down both sides
+	if( node->axis == -1 ) return;
+
+	if( clip->boxmaxs[node->axis] > node->dist )
+		SV_ClipToLinks( node->children[0], clip );
+	if( clip->boxmins[node->axis] < node->dist )
+		SV_ClipToLinks( node->children[1], clip );
+}
+
+/*
+====================
+SV_ClipToWorldBrush
+
+Mins and maxs enclose the entire area swept by the move
+====================
+*/
+void SV_ClipToWorldBrush( areanode_t *node, moveclip_t *clip )
+{
+	link_t	*l, *next;
+	edict_t	*touch;
+	trace_t	trace;
+
+	for( l = node->solid_edicts.next; l != &node->solid_edicts; l = next )
+	{
+		next = l->next;
+
+		touch = (edict_t *)((byte *)l - ADDRESS_OF_AREA);
+
+		if( touch->v.solid != SOLID_BSP || touch == clip->passedict || !( touch->v.flags & FL_WORLDBRUSH ))
+			continue;
+
+		if( !BoundsIntersect( clip->boxmins, clip->boxmaxs, touch->v.absmin, touch->v.absmax ))
+			continue;
+
+		if( clip->trace.allsolid ) return;
+
+		SV_ClipMoveToEntity( touch, clip->start, clip->mins, clip->maxs, clip->end, &trace );
+
+		clip->trace = World_CombineTraces( &clip->trace, &trace, touch );
+	}
+
+	// recurse down both sides
+	if( node->axis == -1 ) return;
+
+	if( clip->boxmaxs[node->axis] > node->dist )
+		SV_ClipToWorldBrush( node->children[0], clip );
+
+	if( clip->boxmins[node->axis] < node->dist )
+		SV_ClipToWorldBrush( node->children[1], clip );
+}
+
+/*
+===============================================================================
+
+PREFETCHED TRACES
+
+===============================================================================
+*/
+#define PREFETCH_JOB_MOVES	8			// traces per worker job
+#define PREFETCH_NODE_BYTES	(( AREA_NODES + 7 ) >> 3 )
+
+enum
+{
+	PREFETCH_NONE = 0,
+	PREFETCH_READY,
+	PREFETCH_UNSAFE,
+	PREFETCH_USED
+};
+
+// what SV_CanClipEdict and SV_ClipToEdict read from an edict,
+// game code may change it without relinking
+typedef struct
+{
+	int		solid;
+	int		movetype;
+	int		flags;
+	int		groupinfo;
+	int		modelindex;
+	int		rendermode;
+	edict_t		*owner;
+	vec3_t		origin;
+	vec3_t		angles;
+} prefetchent_t;
+
+static struct
+{
+	tracereq_t	*reqs;
+	trace_t		*traces;
+	byte		*state;
+	byte		*visited;		// PREFETCH_NODE_BYTES per move
+	int		*slot;		// move + 1 for each edict
+	prefetchent_t	*ents;		// edicts when moves were traced
+	int		numents;
+	int		count;
+	int		maxmoves;
+	int		maxedicts;
+	uint		stamp;		// areanode stamp when moves were traced
+	qboolean		active;
+
+	int		prefetched;
+	int		used;
+	int		stale;
+	int		unsafe;
+	int		mismatches;
+} sv_prefetch;
+
+/*
+==================
+SV_FreePrefetch
+==================
+*/
+void SV_FreePrefetch( void )
+{
+	if( sv_prefetch.reqs ) Mem_Free( sv_prefetch.reqs );
+	if( sv_prefetch.traces ) Mem_Free( sv_prefetch.traces );
+	if( sv_prefetch.state ) Mem_Free( sv_prefetch.state );
+	if( sv_prefetch.visited ) Mem_Free( sv_prefetch.visited );
+	if( sv_prefetch.slot ) Mem_Free( sv_prefetch.slot );
+	if( sv_prefetch.ents ) Mem_Free( sv_prefetch.ents );
+	Q_memset( &sv_prefetch, 0, sizeof( sv_prefetch ));
+}
+
+/*
+==================
+SV_MoveThreaded
+
+SV_Move without globals, returns false if the move
+touched something that only main thread can clip
+==================
+*/
+static qboolean SV_MoveThreaded( const tracereq_t *req, trace_t *trace, byte *visited )
+{
+	moveclip_t	clip;
+	vec3_t		mins, maxs;
+	vec3_t		trace_endpos;
+	float		trace_fraction;
+
+	VectorCopy( req->mins, mins );
+	VectorCopy( req->maxs, maxs );
+
+	Q_memset( &clip, 0, sizeof( moveclip_t ));
+	clip.threaded = true;
+	clip.visited = visited;
+
+	SV_ClipMoveToEntity( svgame.edicts, req->start, mins, maxs, req->end, &clip.trace );
+
+	if( clip.trace.fraction != 0.0f )
+	{
+		VectorCopy( clip.trace.endpos, trace_endpos );
+		trace_fraction = clip.trace.fraction;
+		clip.trace.fraction = 1.0f;
+		clip.start = req->start;
+		clip.end = trace_endpos;
+		clip.type = (req->type & 0xFF);
+		clip.flags = (req->type & 0xFF00);
+		clip.passedict = (req->pentIgnore) ? req->pentIgnore : svgame.edicts;
+		clip.mins = mins;
+		clip.maxs = maxs;
+
+		if( clip.type == MOVE_MISSILE )
+		{
+			VectorSet( clip.mins2, -15.0f, -15.0f, -15.0f );
+			VectorSet( clip.maxs2,  15.0f,  15.0f,  15.0f );
+		}
+		else
+		{
+			VectorCopy( mins, clip.mins2 );
+			VectorCopy( maxs, clip.maxs2 );
+		}
+
+		World_MoveBounds( req->start, clip.mins2, clip.maxs2, trace_endpos, clip.boxmins, clip.boxmaxs );
+		SV_ClipToLinks( sv_areanodes, &clip );
+
+		clip.trace.fraction *= trace_fraction;
+	}
+
+	*trace = clip.trace;
+
+	return !clip.unsafe;
+}
+
+/*
+==================
+SV_PrefetchJob
+==================
+*/
+static void SV_PrefetchJob( void *data, int index )
+{
+	int	i, first, last;
+
+	first = index * PREFETCH_JOB_MOVES;
+	last = min( first + PREFETCH_JOB_MOVES, sv_prefetch.count );
+
+	for( i = first; i < last; i++ )
+	{
+		if( SV_MoveThreaded( &sv_prefetch.reqs[i], &sv_prefetch.traces[i], &sv_prefetch.visited[i * PREFETCH_NODE_BYTES] ))
+			sv_prefetch.state[i] = PREFETCH_READY;
+		else sv_prefetch.state[i] = PREFETCH_UNSAFE;
+	}
+}
+
+/*
+==================
+SV_PrefetchRequests
+
+buffer for at least count moves, pass it to SV_PrefetchMoves
+==================
+*/
+tracereq_t *SV_PrefetchRequests( int count )
+{
+	SV_EndPrefetch();
+
+	if( count > sv_prefetch.maxmoves )
+	{
+		if( sv_prefetch.reqs ) Mem_Free( sv_prefetch.reqs );
+		if( sv_prefetch.traces ) Mem_Free( sv_prefetch.traces );
+		if( sv_prefetch.state ) Mem_Free( sv_prefetch.state );
+		if( sv_prefetch.visited ) Mem_Free( sv_prefetch.visited );
+
+		sv_prefetch.maxmoves = count;
+		sv_prefetch.reqs = Z_Malloc( sizeof( tracereq_t ) * count );
+		sv_prefetch.traces = Z_Malloc( sizeof( trace_t ) * count );
+		sv_prefetch.state = Z_Malloc( count );
+		sv_prefetch.visited = Z_Malloc( PREFETCH_NODE_BYTES * count );
+	}
+
+	return sv_prefetch.reqs;
+}
+
+/*
+==================
+SV_SaveEdictClip
+==================
+*/
+static void SV_SaveEdictClip( prefetchent_t *pe, const edict_t *ent )
+{
+	pe->solid = ent->v.solid;
+	pe->movetype = ent->v.movetype;
+	pe->flags = ent->v.flags;
+	pe->groupinfo = ent->v.groupinfo;
+	pe->modelindex = ent->v.modelindex;
+	pe->rendermode = ent->v.rendermode;
+	pe->owner = ent->v.owner;
+	VectorCopy( ent->v.origin, pe->origin );
+	VectorCopy( ent->v.angles, pe->angles );
+}
+
+/*
+==================
+SV_EdictClipChanged
+
+true if edict may clip differently than when moves were traced
+==================
+*/
+static qboolean SV_EdictClipChanged( const edict_t *ent )
+{
+	const prefetchent_t	*pe;
+	int		num;
+
+	if( !ent ) return false;
+
+	num = NUM_FOR_EDICT( ent );
+	if( num < 0 || num >= sv_prefetch.numents )
+		return true;
+
+	pe = &sv_prefetch.ents[num];
+
+	return ( pe->solid != ent->v.solid || pe->movetype != ent->v.movetype || pe->flags != ent->v.flags
+	|| pe->groupinfo != ent->v.groupinfo || pe->modelindex != ent->v.modelindex || pe->rendermode != ent->v.rendermode
+	|| pe->owner != ent->v.owner || !VectorCompare( pe->origin, ent->v.origin ) || !VectorCompare( pe->angles, ent->v.angles ));
+}
+
+/*
+==================
+SV_PrefetchMoves
+
+traces count moves from SV_PrefetchRequests on worker threads
+before the physics frame, SV_Move picks a result up if it was
+asked for the same move, no solid edict was linked into the
+areanodes the move has walked and no edict there has changed
+==================
+*/
+void SV_PrefetchMoves( int count )
+{
+	int	i, e;
+
+	if( count <= 0 || count > sv_prefetch.maxmoves || !sv_areabounds.node )
+		return;
+
+	if( sv_prefetch.maxedicts != GI->max_edicts )
+	{
+		if( sv_prefetch.slot ) Mem_Free( sv_prefetch.slot );
+		if( sv_prefetch.ents ) Mem_Free( sv_prefetch.ents );
+		sv_prefetch.maxedicts = GI->max_edicts;
+		sv_prefetch.slot = Z_Malloc( sizeof( int ) * sv_prefetch.maxedicts );
+		sv_prefetch.ents = Z_Malloc( sizeof( prefetchent_t ) * sv_prefetch.maxedicts );
+	}
+
+	sv_prefetch.count = count;
+	Q_memset( sv_prefetch.state, PREFETCH_NONE, count );
+	Q_memset( sv_prefetch.visited, 0, PREFETCH_NODE_BYTES * count );
+
+	for( i = 0; i < count; i++ )
+	{
+		e = NUM_FOR_EDICT( sv_prefetch.reqs[i].pentIgnore );
+		if( e > 0 && e < sv_prefetch.maxedicts )
+			sv_prefetch.slot[e] = i + 1;
+	}
+
+	sv_prefetch.numents = min( svgame.numEntities, sv_prefetch.maxedicts );
+	for( i = 0; i < sv_prefetch.numents; i++ )
+		SV_SaveEdictClip( &sv_prefetch.ents[i], EDICT_NUM( i ));
+
+	sv_prefetch.stamp = sv_areabounds.stamp;
+	Sys_RunJobs( SV_PrefetchJob, NULL, ( count + PREFETCH_JOB_MOVES - 1 ) / PREFETCH_JOB_MOVES );
+	sv_prefetch.prefetched += count;
+	sv_prefetch.active = true;
+}
+
+/*
+==================
+SV_EndPrefetch
+
+drop moves which were not used
+==================
+*/
+void SV_EndPrefetch( void )
+{
+	int	i, e;
+
+	if( !sv_prefetch.active )
+		return;
+
+	for( i = 0; i < sv_prefetch.count; i++ )
+	{
+		e = NUM_FOR_EDICT( sv_prefetch.reqs[i].pentIgnore );
+		if( e > 0 && e < sv_prefetch.maxedicts )
+			sv_prefetch.slot[e] = 0;
+	}
+
+	sv_prefetch.count = 0;
+	sv_prefetch.active = false;
+}
+
+/*
+==================
+SV_PrefetchedMove
+
+returns the worker result for this move if it's still valid
+==================
+*/
+static trace_t *SV_PrefetchedMove( const vec3_t start, const vec3_t mins, const vec3_t maxs, const vec3_t end, int type, edict_t *e )
+{
+	const tracereq_t	*req;
+	const byte	*visited;
+	link_t		*l;
+	int		i, num;
+
+	if( !e ) return NULL;
+
+	num = NUM_FOR_EDICT( e );
+	if( num <= 0 || num >= sv_prefetch.maxedicts || !sv_prefetch.slot[num] )
+		return NULL;
+
+	i = sv_prefetch.slot[num] - 1;
+	req = &sv_prefetch.reqs[i];
+
+	if( sv_prefetch.state[i] != PREFETCH_READY )
+	{
+		if( sv_prefetch.state[i] == PREFETCH_UNSAFE )
+			sv_prefetch.unsafe++;
+		sv_prefetch.state[i] = PREFETCH_USED;
+		return NULL;
+	}
+
+	// only the first push of the frame was guessed
+	sv_prefetch.state[i] = PREFETCH_USED;
+
+	if( req->type != type || !VectorCompare( req->start, start ) || !VectorCompare( req->end, end )
+	|| !VectorCompare( req->mins, mins ) || !VectorCompare( req->maxs, maxs ))
+	{
+		sv_prefetch.stale++;
+		return NULL;
+	}
+
+	visited = &sv_prefetch.visited[i * PREFETCH_NODE_BYTES];
+
+	// mover itself and its owner take part in every clip
+	if( SV_EdictClipChanged( e ) || SV_EdictClipChanged( e->v.owner ))
+	{
+		sv_prefetch.stale++;
+		return NULL;
+	}
+
+	for( num = 0; num < sv_numareanodes; num++ )
+	{
+		if(!( visited[num >> 3] & BIT( num & 7 )))
+			continue;
+
+		if( sv_areabounds.stamps[num] > sv_prefetch.stamp )
+		{
+			sv_prefetch.stale++;
+			return NULL;
+		}
+
+		// solid, owner, flags etc may be changed without relink
+		for( l = sv_areanodes[num].solid_edicts.next; l != &sv_areanodes[num].solid_edicts; l = l->next )
+		{
+			if( SV_EdictClipChanged( (edict_t *)((byte *)l - ADDRESS_OF_AREA )))
+			{
+				sv_prefetch.stale++;
+				return NULL;
+			}
+		}
+	}
+
+	sv_prefetch.used++;
+
+	return &sv_prefetch.traces[i];
+}
+
+/*
+==================
+SV_VerifyPrefetch
+
+compare worker result with the one made on main thread
+==================
+*/
+static void SV_VerifyPrefetch( const trace_t *prefetched, const trace_t *trace )
+{
+	if( prefetched->fraction != trace->fraction || prefetched->ent != trace->ent
+	|| prefetched->allsolid != trace->allsolid || prefetched->startsolid != trace->startsolid
+	|| !VectorCompare( prefetched->endpos, trace->endpos ) || !VectorCompare( prefetched->plane.normal, trace->plane.normal ))
+	{
+		sv_prefetch.mismatches++;
+		MsgDev( D_WARN, "prefetched trace for %s differs\n", SV_ClassName( trace->ent ? trace->ent : svgame.edicts ));
+	}
+}
+
+/*
+==================
+SV_PrefetchStats_f
+==================
+*/
+void SV_PrefetchStats_f( void )
+{
+	if( Cmd_Argc() > 1 && !Q_stricmp( Cmd_Argv( 1 ), "reset" ))
+	{
+		sv_prefetch.prefetched = sv_prefetch.used = sv_prefetch.stale = 0;
+		sv_prefetch.unsafe = sv_prefetch.mismatches = 0;
+		return;
+	}
+
+	Msg( "threaded physics: %s, %i threads\n", sv_threaded_physics->integer ? ( sv_threaded_physics->integer == 2 ? "verify" : "enabled" ) : "disabled",
+		sv_threaded_physics->integer ? Sys_NumJobThreads() : 1 );
+	Msg( "%i moves traced ahead, %i used (%.1f%%)\n", sv_prefetch.prefetched, sv_prefetch.used,
+		sv_prefetch.prefetched ? sv_prefetch.used * 100.0f / sv_prefetch.prefetched : 0.0f );
+	Msg( "%i stale, %i left to main thread\n", sv_prefetch.stale, sv_prefetch.unsafe );
+	if( sv_prefetch.mismatches ) Msg( "^1%i mismatches^7\n", sv_prefetch.mismatches );
+}
+
+/*
+===============================================================================
+
+TRACE CACHE
+
+===============================================================================
+*/
+#define TRACECACHE_SIZE	2048		// must be power of two
+
+typedef struct
+{
+	vec3_t		start, end;
+	vec3_t		mins, maxs;
+	edict_t		*passedict;
+	int		type;
+	int		noents;
+} tracekey_t;
+
+typedef struct
+{
+	tracekey_t	key;
+	trace_t		trace;
+	int		generation;	// 0 is never valid
+} tracecache_t;
+
+// missed lookup, kept by caller until the trace is done
+typedef struct
+{
+	tracekey_t	key;
+	int		generation;	// 0 if nothing to store
+} tracemiss_t;
+
+static struct
+{
+	tracecache_t	*entries;
+	int		generation;
+	int		lookups;
+	int		hits;
+	int		flushes;
+} sv_traces;
+
+/*
+==================
+SV_FlushTraceCache
+
+forget all traces, called at the frame start and
+when solid edict is linked or unlinked
+==================
+*/
+void SV_FlushTraceCache( void )
+{
+	if( !sv_traces.entries )
+		return;
+
+	sv_traces.generation++;
+	sv_traces.flushes++;
+}
+
+/*
+==================
+SV_FreeTraceCache
+==================
+*/
+void SV_FreeTraceCache( void )
+{
+	if( sv_traces.entries )
+		Mem_Free( sv_traces.entries );
+	Q_memset( &sv_traces, 0, sizeof( sv_traces ));
+}
+
+/*
+==================
+SV_TraceCacheSlot
+==================
+*/
+static tracecache_t *SV_TraceCacheSlot( const tracekey_t *key )
+{
+	const byte	*data = (const byte *)key;
+	uint		i, hash = 2166136261u;
+
+	for( i = 0; i < sizeof( *key ); i++ )
+		hash = ( hash ^ data[i] ) * 16777619u;
+
+	return &sv_traces.entries[hash & ( TRACECACHE_SIZE - 1 )];
+}
+
+/*
+==================
+SV_CachedTrace
+
+returns true on a hit, otherwise fills miss for SV_StoreCachedTrace.
+the slot is left untouched because a nested trace may use it while
+this one is running
+==================
+*/
+static qboolean SV_CachedTrace( const vec3_t start, const vec3_t mins, const vec3_t maxs, const vec3_t end, int type, edict_t *e, int noents, trace_t *trace, tracemiss_t *miss )
+{
+	tracecache_t	*slot;
+	tracekey_t	*key = &miss->key;
+
+	if( !sv_traces.entries )
+	{
+		sv_traces.entries = Z_Malloc( TRACECACHE_SIZE * sizeof( tracecache_t ));
+		sv_traces.generation = 1;
+	}
+
+	Q_memset( key, 0, sizeof( *key ));
+	VectorCopy( start, key->start );
+	VectorCopy( end, key->end );
+	VectorCopy( mins, key->mins );
+	VectorCopy( maxs, key->maxs );
+	key->passedict = e;
+	key->type = type;
+	key->noents = noents;
+
+	slot = SV_TraceCacheSlot( key );
+	sv_traces.lookups++;
+
+	if( slot->generation == sv_traces.generation && !Q_memcmp( &slot->key, key, sizeof( *key )))
+	{
+		sv_traces.hits++;
+		*trace = slot->trace;
+		miss->generation = 0;
+		return true;
+	}
+
+	miss->generation = sv_traces.generation;
+
+	return false;
+}
+
+/*
+==================
+SV_StoreCachedTrace
+
+drops the trace if the cache was flushed since lookup,
+a solid edict may have moved during it
+==================
+*/
+static void SV_StoreCachedTrace( const tracemiss_t *miss, const trace_t *trace )
+{
+	tracecache_t	*slot;
+
+	if( !miss->generation || miss->generation != sv_traces.generation )
+		return;
+
+	slot = SV_TraceCacheSlot( &miss->key );
+	slot->key = miss->key;
+	slot->trace = *trace;
+	slot->generation = miss->generation;
+}
+
+/*
+==================
+SV_TraceCacheStats_f
+==================
+*/
+void SV_TraceCacheStats_f( void )
+{
+	if( Cmd_Argc() > 1 && !Q_stricmp( Cmd_Argv( 1 ), "reset" ))
+	{
+		sv_traces.lookups = sv_traces.hits = sv_traces.flushes = 0;
+		return;
+	}
+
+	Msg( "trace cache: %s\n", sv_tracecache->integer ? "enabled" : "disabled" );
+	Msg( "%i lookups, %i hits (%.1f%%), %i flushes\n", sv_traces.lookups, sv_traces.hits,
+		sv_traces.lookups ? sv_traces.hits * 100.0f / sv_traces.lookups : 0.0f, sv_traces.flushes );
+}
 
-		if( Mod_GetType( touch->v.modelindex ) == mod_brush && clip->flags & FMOVE_IGNORE_GLASS )
-		{
-			// we ignore brushes with rendermode != kRenderNormal and without FL_WORLDBRUSH set
-			if( touch->v.rendermode != kRenderNormal && !( touch->v.flags & FL_WORLDBRUSH ))
-				continue;
-		}
+/*
+===============================================================================
 
-		if( !BoundsIntersect( clip->boxmins, clip->boxmaxs, touch->v.absmin, touch->v.absmax ))
-			continue;
+TRACE BENCHMARK
 
-		// Xash3D extension
-		if( SV_IsValidEdict( clip->passedict ) && clip->passedict->v.solid == SOLID_TRIGGER )
-		{
-			// never collide items and player (because call "give" always stuck item in player
-			// and total trace returns fail (old half-life bug)
-			// items touch should be done in SV_TouchLinks not here
-			if( touch->v.flags & ( FL_CLIENT|FL_FAKECLIENT ))
-				continue;
-		}
+===============================================================================
+*/
+static struct
+{
+	tracereq_t	*queries;
+	int		maxqueries;
+	int		numqueries;
+} sv_tracebench;
 
-		// g-cont. make sure what size is really zero - check all the components
-		if( SV_IsValidEdict( clip->passedict ) && !VectorIsNull( clip->passedict->v.size ) && VectorIsNull( touch->v.size ))
-			continue;	// points never interact
+/*
+==================
+SV_RecordTrace
 
-		// might intersect, so do an exact clip
-		if( clip->trace.allsolid ) return;
+keep the query for sv_tracebench replay
+==================
+*/
+static void SV_RecordTrace( const vec3_t start, const vec3_t mins, const vec3_t maxs, const vec3_t end, int type )
+{
+	tracereq_t	*q;
 
-		if( SV_IsValidEdict( clip->passedict ))
-		{
-		 	if( touch->v.owner == clip->passedict )
-				continue;	// don't clip against own missiles
-			if( clip->passedict->v.owner == touch )
-				continue;	// don't clip against owner
-		}
+	if( sv_tracebench.numqueries >= sv_tracebench.maxqueries )
+		return;
 
-		if( touch->v.solid == SOLID_CUSTOM )
-			SV_CustomClipMoveToEntity( touch, clip->start, clip->mins, clip->maxs, clip->end, &trace );
-		else if( touch->v.flags & FL_MONSTER )
-			SV_ClipMoveToEntity( touch, clip->start, clip->mins2, clip->maxs2, clip->end, &trace );
-		else SV_ClipMoveToEntity( touch, clip->start, clip->mins, clip->maxs, clip->end, &trace );
+	q = &sv_tracebench.queries[sv_tracebench.numqueries++];
+	VectorCopy( start, q->start );
+	VectorCopy( mins, q->mins );
+	VectorCopy( maxs, q->maxs );
+	VectorCopy( end, q->end );
+	q->type = type;
+	q->pentIgnore = NULL;
 
-		clip->trace = World_CombineTraces( &clip->trace, &trace, touch );
-	}
-	
-	// recurse down both sides
-	if( node->axis == -1 ) return;
+	if( sv_tracebench.numqueries == sv_tracebench.maxqueries )
+		Msg( "sv_tracebench: recorded %i traces\n", sv_tracebench.numqueries );
+}
 
-	if( clip->boxmaxs[node->axis] > node->dist )
-		SV_ClipToLinks( node->children[0], clip );
-	if( clip->boxmins[node->axis] < node->dist )
-		SV_ClipToLinks( node->children[1], clip );
+/*
+==================
+SV_FreeTraceBench
+==================
+*/
+void SV_FreeTraceBench( void )
+{
+	if( sv_tracebench.queries )
+		Mem_Free( sv_tracebench.queries );
+	Q_memset( &sv_tracebench, 0, sizeof( sv_tracebench ));
 }
 
 /*
-====================
-SV_ClipToWorldBrush
+==================
+SV_TraceBench_f
 
-Mins and maxs enclose the entire area swept by the move
-====================
+record <count>: capture next SV_Move calls
+run [passes]: replay them against world and against all entities
+==================
 */
-void SV_ClipToWorldBrush( areanode_t *node, moveclip_t *clip )
+void SV_TraceBench_f( void )
 {
-	link_t	*l, *next;
-	edict_t	*touch;
-	trace_t	trace;
+	double		start, worldtime, movetime, batchtime;
+	float		checksum = 0.0f;
+	int		mismatches = 0;
+	trace_t		tr, *results;
+	tracereq_t	*q;
+	int		i, j, passes;
+
+	if( Cmd_Argc() < 2 )
+	{
+		Msg( "Usage: sv_tracebench record <count> | run [passes]\n" );
+		return;
+	}
 
-	for( l = node->solid_edicts.next; l != &node->solid_edicts; l = next )
+	if( !Q_stricmp( Cmd_Argv( 1 ), "record" ))
 	{
-		next = l->next;
+		SV_FreeTraceBench();
+		sv_tracebench.maxqueries = ( Cmd_Argc() > 2 ) ? Q_atoi( Cmd_Argv( 2 )) : 10000;
+		sv_tracebench.maxqueries = bound( 1, sv_tracebench.maxqueries, 1000000 );
+		sv_tracebench.queries = Z_Malloc( sv_tracebench.maxqueries * sizeof( tracereq_t ));
+		Msg( "sv_tracebench: recording %i traces\n", sv_tracebench.maxqueries );
+		return;
+	}
 
-		touch = (edict_t *)((byte *)l - ADDRESS_OF_AREA);
+	if( Q_stricmp( Cmd_Argv( 1 ), "run" ))
+	{
+		Msg( "sv_tracebench: unknown action %s\n", Cmd_Argv( 1 ));
+		return;
+	}
 
-		if( touch->v.solid != SOLID_BSP || touch == clip->passedict || !( touch->v.flags & FL_WORLDBRUSH ))
-			continue;
+	if( sv.state != ss_active )
+	{
+		Msg( "sv_tracebench: server is not running\n" );
+		return;
+	}
 
-		if( !BoundsIntersect( clip->boxmins, clip->boxmaxs, touch->v.absmin, touch->v.absmax ))
-			continue;
+	if( !sv_tracebench.numqueries )
+	{
+		Msg( "sv_tracebench: nothing recorded\n" );
+		return;
+	}
 
-		if( clip->trace.allsolid ) return;
+	// stop recording while replaying
+	sv_tracebench.maxqueries = sv_tracebench.numqueries;
+	passes = ( Cmd_Argc() > 2 ) ? Q_atoi( Cmd_Argv( 2 )) : 10;
+	passes = max( passes, 1 );
 
-		SV_ClipMoveToEntity( touch, clip->start, clip->mins, clip->maxs, clip->end, &trace );
+	start = Sys_DoubleTime();
+	for( i = 0; i < passes; i++ )
+	{
+		for( j = 0, q = sv_tracebench.queries; j < sv_tracebench.numqueries; j++, q++ )
+		{
+			tr = SV_MoveNoEnts( q->start, q->mins, q->maxs, q->end, q->type, NULL );
+			if( !i ) checksum += tr.fraction;
+		}
+	}
+	worldtime = Sys_DoubleTime() - start;
 
-		clip->trace = World_CombineTraces( &clip->trace, &trace, touch );
+	start = Sys_DoubleTime();
+	for( i = 0; i < passes; i++ )
+	{
+		for( j = 0, q = sv_tracebench.queries; j < sv_tracebench.numqueries; j++, q++ )
+			SV_Move( q->start, q->mins, q->maxs, q->end, q->type, NULL );
 	}
+	movetime = Sys_DoubleTime() - start;
 
-	// recurse down both sides
-	if( node->axis == -1 ) return;
+	results = Z_Malloc( sv_tracebench.numqueries * sizeof( trace_t ));
 
-	if( clip->boxmaxs[node->axis] > node->dist )
-		SV_ClipToWorldBrush( node->children[0], clip );
+	start = Sys_DoubleTime();
+	for( i = 0; i < passes; i++ )
+		SV_MoveBatch( sv_tracebench.queries, results, sv_tracebench.numqueries, TRACEBATCH_THREADS );
+	batchtime = Sys_DoubleTime() - start;
 
-	if( clip->boxmins[node->axis] < node->dist )
-		SV_ClipToWorldBrush( node->children[1], clip );
+	// batch must give the same answers
+	for( j = 0, q = sv_tracebench.queries; j < sv_tracebench.numqueries; j++, q++ )
+	{
+		tr = SV_Move( q->start, q->mins, q->maxs, q->end, q->type, NULL );
+		if( tr.fraction != results[j].fraction || tr.ent != results[j].ent || tr.allsolid != results[j].allsolid )
+			mismatches++;
+	}
+
+	Mem_Free( results );
+
+	i = sv_tracebench.numqueries * passes;
+	Msg( "%i traces, %i passes, world fraction sum %g\n", sv_tracebench.numqueries, passes, checksum );
+	Msg( "world %.3f msec (%.0f traces/sec)\n", worldtime * 1000.0, i / max( worldtime, 0.000001 ));
+	Msg( "move %.3f msec (%.0f traces/sec)\n", movetime * 1000.0, i / max( movetime, 0.000001 ));
+	Msg( "batch %.3f msec (%.0f traces/sec)\n", batchtime * 1000.0, i / max( batchtime, 0.000001 ));
+	if( mismatches ) Msg( "^1%i batch mismatches^7\n", mismatches );
 }
 
 /*
@@ -1314,10 +3282,35 @@ SV_Move
 */
 trace_t SV_Move( const vec3_t start, vec3_t mins, vec3_t maxs, const vec3_t end, int type, edict_t *e )
 {
+	tracemiss_t	miss;
+	trace_t		*prefetched = NULL;
 	moveclip_t	clip;
 	vec3_t		trace_endpos;
 	float		trace_fraction;
 
+	if( sv_tracebench.queries )
+		SV_RecordTrace( start, mins, maxs, end, type );
+
+	if( sv_prefetch.active && ( prefetched = SV_PrefetchedMove( start, mins, maxs, end, type, e )) != NULL )
+	{
+		if( sv_threaded_physics->integer != 2 )
+		{
+			SV_CopyTraceToGlobal( prefetched );
+			return *prefetched;
+		}
+	}
+
+	miss.generation = 0;
+
+	if( sv_tracecache->integer )
+	{
+		if( SV_CachedTrace( start, mins, maxs, end, type, e, false, &clip.trace, &miss ))
+		{
+			SV_CopyTraceToGlobal( &clip.trace );
+			return clip.trace;
+		}
+	}
+
 	Q_memset( &clip, 0, sizeof( moveclip_t ));
 	SV_ClipMoveToEntity( EDICT_NUM( 0 ), start, mins, maxs, end, &clip.trace );
 
@@ -1346,6 +3339,7 @@ trace_t SV_Move( const vec3_t start, vec3_t mins, vec3_t maxs, const vec3_t end,
 		}
 
 		World_MoveBounds( start, clip.mins2, clip.maxs2, trace_endpos, clip.boxmins, clip.boxmaxs );
+		sv_areatree.traces++;
 		SV_ClipToLinks( sv_areanodes, &clip );
 
 		clip.trace.fraction *= trace_fraction;
@@ -1354,6 +3348,11 @@ trace_t SV_Move( const vec3_t start, vec3_t mins, vec3_t maxs, const vec3_t end,
 
 	SV_CopyTraceToGlobal( &clip.trace );
 
+	if( prefetched )
+		SV_VerifyPrefetch( prefetched, &clip.trace );
+
+	SV_StoreCachedTrace( &miss, &clip.trace );
+
 	return clip.trace;
 }
 
@@ -1364,10 +3363,22 @@ SV_MoveNoEnts
 */
 trace_t SV_MoveNoEnts( const vec3_t start, vec3_t mins, vec3_t maxs, const vec3_t end, int type, edict_t *e )
 {
+	tracemiss_t	miss;
 	moveclip_t	clip;
 	vec3_t		trace_endpos;
 	float		trace_fraction;
 
+	miss.generation = 0;
+
+	if( sv_tracecache->integer )
+	{
+		if( SV_CachedTrace( start, mins, maxs, end, type, e, true, &clip.trace, &miss ))
+		{
+			SV_CopyTraceToGlobal( &clip.trace );
+			return clip.trace;
+		}
+	}
+
 	Q_memset( &clip, 0, sizeof( moveclip_t ));
 	SV_ClipMoveToEntity( EDICT_NUM( 0 ), start, mins, maxs, end, &clip.trace );
 
@@ -1396,6 +3407,8 @@ trace_t SV_MoveNoEnts( const vec3_t start, vec3_t mins, vec3_t maxs, const vec3_
 
 	SV_CopyTraceToGlobal( &clip.trace );
 
+	SV_StoreCachedTrace( &miss, &clip.trace );
+
 	return clip.trace;
 }
 
@@ -1477,6 +3490,270 @@ const char *SV_TraceTexture( edict_t *ent, const vec3_t start, const vec3_t end
 	return surf->texinfo->texture->name;
 }
 
+/*
+===============================================================================
+
+BATCHED TRACES
+
+===============================================================================
+*/
+#define BATCH_JOB_MOVES	16		// world traces per worker job
+
+typedef struct
+{
+	moveclip_t	clip;
+	vec3_t		start, end;
+	vec3_t		mins, maxs;
+	vec3_t		endpos;		// where the world stopped the move
+	float		fraction;
+	qboolean		done;		// nothing to clip against entities
+} batchmove_t;
+
+static struct
+{
+	batchmove_t	*moves;
+	int		nummoves;
+	int		maxmoves;
+	edict_t		**touch;		// candidates of current group
+	int		numtouch;
+	int		maxtouch;
+	qboolean		active;
+} sv_batch;
+
+/*
+==================
+SV_FreeTraceBatch
+==================
+*/
+void SV_FreeTraceBatch( void )
+{
+	if( sv_batch.moves ) Mem_Free( sv_batch.moves );
+	if( sv_batch.touch ) Mem_Free( sv_batch.touch );
+	Q_memset( &sv_batch, 0, sizeof( sv_batch ));
+}
+
+/*
+==================
+SV_BatchClipToWorld
+
+same as the world part of SV_Move, touches only read-only data
+so it can run on worker threads
+==================
+*/
+static void SV_BatchClipToWorld( batchmove_t *move )
+{
+	moveclip_t	*clip = &move->clip;
+
+	SV_ClipMoveToEntity( svgame.edicts, move->start, move->mins, move->maxs, move->end, &clip->trace );
+
+	if( clip->trace.fraction == 0.0f )
+	{
+		move->done = true;
+		return;
+	}
+
+	VectorCopy( clip->trace.endpos, move->endpos );
+	move->fraction = clip->trace.fraction;
+	clip->trace.fraction = 1.0f;
+	clip->end = move->endpos;
+
+	if( clip->type == MOVE_MISSILE )
+	{
+		VectorSet( clip->mins2, -15.0f, -15.0f, -15.0f );
+		VectorSet( clip->maxs2,  15.0f,  15.0f,  15.0f );
+	}
+	else
+	{
+		VectorCopy( move->mins, clip->mins2 );
+		VectorCopy( move->maxs, clip->maxs2 );
+	}
+
+	World_MoveBounds( move->start, clip->mins2, clip->maxs2, move->endpos, clip->boxmins, clip->boxmaxs );
+}
+
+/*
+==================
+SV_BatchWorldJob
+==================
+*/
+static void SV_BatchWorldJob( void *data, int index )
+{
+	batchmove_t	*moves = (batchmove_t *)data;
+	int		i, first, last;
+
+	first = index * BATCH_JOB_MOVES;
+	last = min( first + BATCH_JOB_MOVES, sv_batch.nummoves );
+
+	for( i = first; i < last; i++ )
+		SV_BatchClipToWorld( &moves[i] );
+}
+
+/*
+==================
+SV_BatchTouchLinks
+
+collect solid edicts that may touch the group box
+==================
+*/
+static void SV_BatchTouchLinks( areanode_t *node, const vec3_t mins, const vec3_t maxs )
+{
+	link_t	*l, *next;
+	edict_t	*touch;
+
+	for( l = node->solid_edicts.next; l != &node->solid_edicts; l = next )
+	{
+		next = l->next;
+
+		touch = (edict_t *)((byte *)l - ADDRESS_OF_AREA);
+
+		if( touch->v.solid == SOLID_NOT || !BoundsIntersect( mins, maxs, touch->v.absmin, touch->v.absmax ))
+			continue;
+
+		if( sv_batch.numtouch == sv_batch.maxtouch )
+		{
+			sv_batch.maxtouch = max( sv_batch.maxtouch * 2, 64 );
+			sv_batch.touch = Z_Realloc( sv_batch.touch, sv_batch.maxtouch * sizeof( edict_t* ));
+		}
+
+		sv_batch.touch[sv_batch.numtouch++] = touch;
+	}
+
+	// recurse down both sides
+	if( node->axis == -1 ) return;
+
+	if( maxs[node->axis] > node->dist )
+		SV_BatchTouchLinks( node->children[0], mins, maxs );
+	if( mins[node->axis] < node->dist )
+		SV_BatchTouchLinks( node->children[1], mins, maxs );
+}
+
+/*
+==================
+SV_MoveBatch
+
+traces a set of moves at once. runs of moves with overlapping
+bounds share one areanode walk, world clipping may be spread over
+worker threads. result of every move is the same as from SV_Move
+but trace globals are not updated
+==================
+*/
+void SV_MoveBatch( const tracereq_t *requests, trace_t *results, int count, int flags )
+{
+	vec3_t		mins, maxs;
+	batchmove_t	*move;
+	int		i, j, k, t;
+
+	if( !requests || !results || count <= 0 )
+		return;
+
+	if( sv_batch.active )
+	{
+		// called from entity callback in the middle of a batch
+		for( i = 0; i < count; i++ )
+		{
+			results[i] = SV_Move( requests[i].start, (float *)requests[i].mins, (float *)requests[i].maxs,
+				requests[i].end, requests[i].type, requests[i].pentIgnore );
+		}
+		return;
+	}
+
+	if( count > sv_batch.maxmoves )
+	{
+		if( sv_batch.moves ) Mem_Free( sv_batch.moves );
+		sv_batch.moves = Z_Malloc( count * sizeof( batchmove_t ));
+		sv_batch.maxmoves = count;
+	}
+
+	sv_batch.nummoves = count;
+	sv_batch.active = true;
+
+	for( i = 0, move = sv_batch.moves; i < count; i++, move++ )
+	{
+		Q_memset( move, 0, sizeof( *move ));
+		VectorCopy( requests[i].start, move->start );
+		VectorCopy( requests[i].end, move->end );
+		VectorCopy( requests[i].mins, move->mins );
+		VectorCopy( requests[i].maxs, move->maxs );
+		move->clip.start = move->start;
+		move->clip.mins = move->mins;
+		move->clip.maxs = move->maxs;
+		move->clip.type = (requests[i].type & 0xFF);
+		move->clip.flags = (requests[i].type & 0xFF00);
+		move->clip.passedict = requests[i].pentIgnore ? requests[i].pentIgnore : svgame.edicts;
+	}
+
+	// world first, it doesn't depend on entities
+	if(( flags & TRACEBATCH_THREADS ) && count > BATCH_JOB_MOVES )
+	{
+		Sys_RunJobs( SV_BatchWorldJob, sv_batch.moves, ( count + BATCH_JOB_MOVES - 1 ) / BATCH_JOB_MOVES );
+	}
+	else
+	{
+		for( i = 0; i < count; i++ )
+			SV_BatchClipToWorld( &sv_batch.moves[i] );
+	}
+
+	for( i = 0; i < count; i = j )
+	{
+		move = &sv_batch.moves[i];
+
+		if( move->done )
+		{
+			j = i + 1;
+			continue;
+		}
+
+		// grow the group while next moves overlap it
+		VectorCopy( move->clip.boxmins, mins );
+		VectorCopy( move->clip.boxmaxs, maxs );
+
+		for( j = i + 1; j < count; j++ )
+		{
+			move = &sv_batch.moves[j];
+			if( move->done ) continue;
+
+			if( !BoundsIntersect( mins, maxs, move->clip.boxmins, move->clip.boxmaxs ))
+				break;
+
+			for( k = 0; k < 3; k++ )
+			{
+				mins[k] = min( mins[k], move->clip.boxmins[k] );
+				maxs[k] = max( maxs[k], move->clip.boxmaxs[k] );
+			}
+		}
+
+		sv_batch.numtouch = 0;
+		SV_BatchTouchLinks( sv_areanodes, mins, maxs );
+
+		// candidates keep the areanode order, so each move clips them as SV_ClipToLinks would
+		for( k = i; k < j; k++ )
+		{
+			move = &sv_batch.moves[k];
+			if( move->done ) continue;
+
+			for( t = 0; t < sv_batch.numtouch; t++ )
+			{
+				if( !SV_CanClipEdict( sv_batch.touch[t], &move->clip ))
+					continue;
+
+				if( move->clip.trace.allsolid )
+					break;
+
+				SV_ClipToEdict( sv_batch.touch[t], &move->clip );
+			}
+		}
+	}
+
+	for( i = 0, move = sv_batch.moves; i < count; i++, move++ )
+	{
+		if( !move->done )
+			move->clip.trace.fraction *= move->fraction;
+		results[i] = move->clip.trace;
+	}
+
+	sv_batch.active = false;
+}
+
 /*
 ==================
 SV_MoveToss